@@ -7,8 +7,14 @@
 #include <stdint.h>
 #include <vector>
 #include <algorithm>
+#include <cstdarg>
 #include <cstdio>
 #include <cstring>
+#include <atomic>
+#include <thread>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 #if !defined(_MSC_VER) && __cplusplus < 201103L
 #define static_assert(x,y)
@@ -16,6 +22,17 @@
 
 #define _SMOLV_ARRAY_SIZE(a) (sizeof(a)/sizeof((a)[0]))
 
+#if defined(_MSC_VER)
+#define _SMOLV_FORCE_INLINE __forceinline
+#define _SMOLV_NO_INLINE __declspec(noinline)
+#elif defined(__GNUC__) || defined(__clang__)
+#define _SMOLV_FORCE_INLINE __attribute__((always_inline)) inline
+#define _SMOLV_NO_INLINE __attribute__((noinline))
+#else
+#define _SMOLV_FORCE_INLINE inline
+#define _SMOLV_NO_INLINE
+#endif
+
 // --------------------------------------------------------------------------------------------
 // Metadata about known SPIR-V operations
 
@@ -38,6 +55,7 @@ enum SpvOp
 	SpvOpEntryPoint = 15,
 	SpvOpExecutionMode = 16,
 	SpvOpCapability = 17,
+	SpvOpDictionaryRef = 18, // not in SPIR-V, added for SMOL-V! (only used with a dictionary)
 	SpvOpTypeVoid = 19,
 	SpvOpTypeBool = 20,
 	SpvOpTypeInt = 21,
@@ -59,12 +77,14 @@ enum SpvOp
 	SpvOpTypeQueue = 37,
 	SpvOpTypePipe = 38,
 	SpvOpTypeForwardPointer = 39,
+	SpvOpExtInstWithSet = 40, // not in SPIR-V, added for SMOL-V! (since version 3: ExtInst with a different set than previous one)
 	SpvOpConstantTrue = 41,
 	SpvOpConstantFalse = 42,
 	SpvOpConstant = 43,
 	SpvOpConstantComposite = 44,
 	SpvOpConstantSampler = 45,
 	SpvOpConstantNull = 46,
+	SpvOpConstantRaw = 47, // not in SPIR-V, added for SMOL-V! (since version 3: Constant with literal words as is)
 	SpvOpSpecConstantTrue = 48,
 	SpvOpSpecConstantFalse = 49,
 	SpvOpSpecConstant = 50,
@@ -1118,6 +1138,557 @@ static const OpData kSpirvOpData[] =
 };
 static_assert(_SMOLV_ARRAY_SIZE(kSpirvOpData) == kKnownOpsCount, "kSpirvOpData table mismatch with known SpvOps");
 
+// Ops past kKnownOpsCount (SPIR-V 1.4 core ops, and extension ops: ray tracing, ray queries, mesh
+// shading, cooperative matrices etc.) have large, sparse op values. They are encoded using this table
+// since SMOL-V version 3; earlier versions encode them as unknown ops. Sorted by op value.
+struct OpDataSparse
+{
+	uint16_t op;
+	OpData data;
+	const char* name;
+};
+static const OpDataSparse kSpirvOpDataSparse[] =
+{
+	{400, {1, 1, 1, 0}, "CopyLogical"},
+	{401, {1, 1, 2, 0}, "PtrEqual"},
+	{402, {1, 1, 2, 0}, "PtrNotEqual"},
+	{403, {1, 1, 2, 0}, "PtrDiff"},
+	{4160, {1, 1, 2, 0}, "ColorAttachmentReadEXT"},
+	{4161, {1, 1, 1, 0}, "DepthAttachmentReadEXT"},
+	{4162, {1, 1, 1, 0}, "StencilAttachmentReadEXT"},
+	{4416, {0, 0, 0, 0}, "TerminateInvocation"},
+	{4421, {1, 1, 1, 0}, "SubgroupBallotKHR"},
+	{4422, {1, 1, 1, 0}, "SubgroupFirstInvocationKHR"},
+	{4428, {1, 1, 1, 0}, "SubgroupAllKHR"},
+	{4429, {1, 1, 1, 0}, "SubgroupAnyKHR"},
+	{4430, {1, 1, 1, 0}, "SubgroupAllEqualKHR"},
+	{4431, {1, 1, 1, 1}, "GroupNonUniformRotateKHR"},
+	{4432, {1, 1, 2, 0}, "SubgroupReadInvocationKHR"},
+	{4433, {1, 1, 0, 1}, "ExtInstWithForwardRefsKHR"},
+	{4445, {0, 0, 0, 1}, "TraceRayKHR"},
+	{4446, {0, 0, 0, 1}, "ExecuteCallableKHR"},
+	{4447, {1, 1, 1, 0}, "ConvertUToAccelerationStructureKHR"},
+	{4448, {0, 0, 0, 0}, "IgnoreIntersectionKHR"},
+	{4449, {0, 0, 0, 0}, "TerminateRayKHR"},
+	{4450, {1, 1, 2, 1}, "SDot"},
+	{4451, {1, 1, 2, 1}, "UDot"},
+	{4452, {1, 1, 2, 1}, "SUDot"},
+	{4453, {1, 1, 3, 1}, "SDotAccSat"},
+	{4454, {1, 1, 3, 1}, "UDotAccSat"},
+	{4455, {1, 1, 3, 1}, "SUDotAccSat"},
+	{4456, {1, 0, 0, 1}, "TypeCooperativeMatrixKHR"},
+	{4457, {1, 1, 1, 1}, "CooperativeMatrixLoadKHR"},
+	{4458, {0, 0, 2, 1}, "CooperativeMatrixStoreKHR"},
+	{4459, {1, 1, 3, 1}, "CooperativeMatrixMulAddKHR"},
+	{4460, {1, 1, 0, 1}, "CooperativeMatrixLengthKHR"},
+	{4461, {1, 1, 9, 0}, "ConstantCompositeReplicateEXT"},
+	{4462, {1, 1, 9, 0}, "SpecConstantCompositeReplicateEXT"},
+	{4463, {1, 1, 9, 0}, "CompositeConstructReplicateEXT"},
+	{4472, {1, 0, 0, 1}, "TypeRayQueryKHR"},
+	{4473, {0, 0, 0, 1}, "RayQueryInitializeKHR"},
+	{4474, {0, 0, 0, 1}, "RayQueryTerminateKHR"},
+	{4475, {0, 0, 0, 1}, "RayQueryGenerateIntersectionKHR"},
+	{4476, {0, 0, 0, 1}, "RayQueryConfirmIntersectionKHR"},
+	{4477, {1, 1, 0, 1}, "RayQueryProceedKHR"},
+	{4479, {1, 1, 0, 1}, "RayQueryGetIntersectionTypeKHR"},
+	{4480, {1, 1, 3, 0}, "ImageSampleWeightedQCOM"},
+	{4481, {1, 1, 3, 0}, "ImageBoxFilterQCOM"},
+	{4482, {1, 1, 5, 0}, "ImageBlockMatchSSDQCOM"},
+	{4483, {1, 1, 5, 0}, "ImageBlockMatchSADQCOM"},
+	{4500, {1, 1, 5, 0}, "ImageBlockMatchWindowSSDQCOM"},
+	{4501, {1, 1, 5, 0}, "ImageBlockMatchWindowSADQCOM"},
+	{4502, {1, 1, 5, 0}, "ImageBlockMatchGatherSSDQCOM"},
+	{4503, {1, 1, 5, 0}, "ImageBlockMatchGatherSADQCOM"},
+	{5000, {1, 1, 0, 0}, "GroupIAddNonUniformAMD"},
+	{5001, {1, 1, 0, 0}, "GroupFAddNonUniformAMD"},
+	{5002, {1, 1, 0, 0}, "GroupFMinNonUniformAMD"},
+	{5003, {1, 1, 0, 0}, "GroupUMinNonUniformAMD"},
+	{5004, {1, 1, 0, 0}, "GroupSMinNonUniformAMD"},
+	{5005, {1, 1, 0, 0}, "GroupFMaxNonUniformAMD"},
+	{5006, {1, 1, 0, 0}, "GroupUMaxNonUniformAMD"},
+	{5007, {1, 1, 0, 0}, "GroupSMaxNonUniformAMD"},
+	{5011, {1, 1, 2, 0}, "FragmentMaskFetchAMD"},
+	{5012, {1, 1, 3, 0}, "FragmentFetchAMD"},
+	{5056, {1, 1, 0, 1}, "ReadClockKHR"},
+	{5110, {1, 1, 1, 0}, "GroupNonUniformQuadAllKHR"},
+	{5111, {1, 1, 1, 0}, "GroupNonUniformQuadAnyKHR"},
+	{5249, {0, 0, 0, 1}, "HitObjectRecordHitMotionNV"},
+	{5250, {0, 0, 0, 1}, "HitObjectRecordHitWithIndexMotionNV"},
+	{5251, {0, 0, 0, 1}, "HitObjectRecordMissMotionNV"},
+	{5252, {1, 1, 0, 1}, "HitObjectGetWorldToObjectNV"},
+	{5253, {1, 1, 0, 1}, "HitObjectGetObjectToWorldNV"},
+	{5254, {1, 1, 0, 1}, "HitObjectGetObjectRayDirectionNV"},
+	{5255, {1, 1, 0, 1}, "HitObjectGetObjectRayOriginNV"},
+	{5256, {0, 0, 0, 1}, "HitObjectTraceRayMotionNV"},
+	{5257, {1, 1, 0, 1}, "HitObjectGetShaderRecordBufferHandleNV"},
+	{5258, {1, 1, 0, 1}, "HitObjectGetShaderBindingTableRecordIndexNV"},
+	{5259, {0, 0, 0, 1}, "HitObjectRecordEmptyNV"},
+	{5260, {0, 0, 0, 1}, "HitObjectTraceRayNV"},
+	{5261, {0, 0, 0, 1}, "HitObjectRecordHitNV"},
+	{5262, {0, 0, 0, 1}, "HitObjectRecordHitWithIndexNV"},
+	{5263, {0, 0, 0, 1}, "HitObjectRecordMissNV"},
+	{5264, {0, 0, 0, 1}, "HitObjectExecuteShaderNV"},
+	{5265, {1, 1, 0, 1}, "HitObjectGetCurrentTimeNV"},
+	{5266, {0, 0, 0, 1}, "HitObjectGetAttributesNV"},
+	{5267, {1, 1, 0, 1}, "HitObjectGetHitKindNV"},
+	{5268, {1, 1, 0, 1}, "HitObjectGetPrimitiveIndexNV"},
+	{5269, {1, 1, 0, 1}, "HitObjectGetGeometryIndexNV"},
+	{5270, {1, 1, 0, 1}, "HitObjectGetInstanceIdNV"},
+	{5271, {1, 1, 0, 1}, "HitObjectGetInstanceCustomIndexNV"},
+	{5272, {1, 1, 0, 1}, "HitObjectGetWorldRayDirectionNV"},
+	{5273, {1, 1, 0, 1}, "HitObjectGetWorldRayOriginNV"},
+	{5274, {1, 1, 0, 1}, "HitObjectGetRayTMaxNV"},
+	{5275, {1, 1, 0, 1}, "HitObjectGetRayTMinNV"},
+	{5276, {1, 1, 0, 1}, "HitObjectIsEmptyNV"},
+	{5277, {1, 1, 0, 1}, "HitObjectIsHitNV"},
+	{5278, {1, 1, 0, 1}, "HitObjectIsMissNV"},
+	{5279, {0, 0, 0, 1}, "ReorderThreadWithHitObjectNV"},
+	{5280, {0, 0, 0, 1}, "ReorderThreadWithHintNV"},
+	{5281, {1, 0, 0, 1}, "TypeHitObjectNV"},
+	{5283, {1, 1, 4, 1}, "ImageSampleFootprintNV"},
+	{5294, {0, 0, 0, 1}, "EmitMeshTasksEXT"},
+	{5295, {0, 0, 0, 1}, "SetMeshOutputsEXT"},
+	{5296, {1, 1, 1, 0}, "GroupNonUniformPartitionNV"},
+	{5299, {0, 0, 2, 0}, "WritePackedPrimitiveIndices4x8NV"},
+	{5300, {1, 1, 0, 1}, "FetchMicroTriangleVertexPositionNV"},
+	{5301, {1, 1, 0, 1}, "FetchMicroTriangleVertexBarycentricNV"},
+	{5334, {1, 1, 2, 0}, "ReportIntersectionKHR"},
+	{5335, {0, 0, 0, 0}, "IgnoreIntersectionNV"},
+	{5336, {0, 0, 0, 0}, "TerminateRayNV"},
+	{5337, {0, 0, 0, 1}, "TraceNV"},
+	{5338, {0, 0, 0, 1}, "TraceMotionNV"},
+	{5339, {0, 0, 0, 1}, "TraceRayMotionNV"},
+	{5340, {1, 1, 0, 1}, "RayQueryGetIntersectionTriangleVertexPositionsKHR"},
+	{5341, {1, 0, 0, 1}, "TypeAccelerationStructureKHR"},
+	{5344, {0, 0, 0, 1}, "ExecuteCallableNV"},
+	{5358, {1, 0, 0, 1}, "TypeCooperativeMatrixNV"},
+	{5359, {1, 1, 1, 1}, "CooperativeMatrixLoadNV"},
+	{5360, {0, 0, 2, 1}, "CooperativeMatrixStoreNV"},
+	{5361, {1, 1, 3, 0}, "CooperativeMatrixMulAddNV"},
+	{5362, {1, 1, 0, 1}, "CooperativeMatrixLengthNV"},
+	{5364, {0, 0, 0, 0}, "BeginInvocationInterlockEXT"},
+	{5365, {0, 0, 0, 0}, "EndInvocationInterlockEXT"},
+	{5380, {0, 0, 0, 0}, "DemoteToHelperInvocation"},
+	{5381, {1, 1, 0, 0}, "IsHelperInvocationEXT"},
+	{5391, {1, 1, 1, 0}, "ConvertUToImageNV"},
+	{5392, {1, 1, 1, 0}, "ConvertUToSamplerNV"},
+	{5393, {1, 1, 1, 0}, "ConvertImageToUNV"},
+	{5394, {1, 1, 1, 0}, "ConvertSamplerToUNV"},
+	{5395, {1, 1, 1, 0}, "ConvertUToSampledImageNV"},
+	{5396, {1, 1, 1, 0}, "ConvertSampledImageToUNV"},
+	{5397, {0, 0, 0, 1}, "SamplerImageAddressingModeNV"},
+	{5614, {1, 1, 0, 0}, "AtomicFMinEXT"},
+	{5615, {1, 1, 0, 0}, "AtomicFMaxEXT"},
+	{5630, {0, 0, 1, 0}, "AssumeTrueKHR"},
+	{5631, {1, 1, 2, 0}, "ExpectKHR"},
+	{5632, {0, 0, 0, 0}, "DecorateString"},
+	{5633, {0, 0, 0, 0}, "MemberDecorateString"},
+	{6016, {1, 1, 0, 1}, "RayQueryGetRayTMinKHR"},
+	{6017, {1, 1, 0, 1}, "RayQueryGetRayFlagsKHR"},
+	{6018, {1, 1, 0, 1}, "RayQueryGetIntersectionTKHR"},
+	{6019, {1, 1, 0, 1}, "RayQueryGetIntersectionInstanceCustomIndexKHR"},
+	{6020, {1, 1, 0, 1}, "RayQueryGetIntersectionInstanceIdKHR"},
+	{6021, {1, 1, 0, 1}, "RayQueryGetIntersectionInstanceShaderBindingTableRecordOffsetKHR"},
+	{6022, {1, 1, 0, 1}, "RayQueryGetIntersectionGeometryIndexKHR"},
+	{6023, {1, 1, 0, 1}, "RayQueryGetIntersectionPrimitiveIndexKHR"},
+	{6024, {1, 1, 0, 1}, "RayQueryGetIntersectionBarycentricsKHR"},
+	{6025, {1, 1, 0, 1}, "RayQueryGetIntersectionFrontFaceKHR"},
+	{6026, {1, 1, 0, 1}, "RayQueryGetIntersectionCandidateAABBOpaqueKHR"},
+	{6027, {1, 1, 0, 1}, "RayQueryGetIntersectionObjectRayDirectionKHR"},
+	{6028, {1, 1, 0, 1}, "RayQueryGetIntersectionObjectRayOriginKHR"},
+	{6029, {1, 1, 0, 1}, "RayQueryGetWorldRayDirectionKHR"},
+	{6030, {1, 1, 0, 1}, "RayQueryGetWorldRayOriginKHR"},
+	{6031, {1, 1, 0, 1}, "RayQueryGetIntersectionObjectToWorldKHR"},
+	{6032, {1, 1, 0, 1}, "RayQueryGetIntersectionWorldToObjectKHR"},
+	{6035, {1, 1, 0, 0}, "AtomicFAddEXT"},
+	{6401, {1, 1, 0, 0}, "GroupIMulKHR"},
+	{6402, {1, 1, 0, 0}, "GroupFMulKHR"},
+	{6403, {1, 1, 0, 0}, "GroupBitwiseAndKHR"},
+	{6404, {1, 1, 0, 0}, "GroupBitwiseOrKHR"},
+	{6405, {1, 1, 0, 0}, "GroupBitwiseXorKHR"},
+	{6406, {1, 1, 0, 0}, "GroupLogicalAndKHR"},
+	{6407, {1, 1, 0, 0}, "GroupLogicalOrKHR"},
+	{6408, {1, 1, 0, 0}, "GroupLogicalXorKHR"},
+};
+static const int kSparseOpsCount = _SMOLV_ARRAY_SIZE(kSpirvOpDataSparse);
+
+// Where the IDs are in each instruction (after the op word), for kEncodeFlagCanonicalizeIds. One char per operand:
+// 't' type ID, 'r' result ID, 'i' ID, 'o' optional ID, 'l' literal word, 's' literal string, 'I' all the rest are IDs,
+// 'L' all the rest are literals, 'A' optional memory access operands, 'M' optional image operands (mask, then IDs),
+// 'W' OpSwitch (literal, label) pairs, 'G' OpGroupMemberDecorate (ID, literal) pairs, 'X' OpSpecConstantOp operation.
+// NULL for op values that are not SPIR-V ops.
+static const char* kSpirvOpIdLayouts[] =
+{
+	"", // Nop
+	"tr", // Undef
+	"L", // SourceContinued
+	"lloL", // Source
+	"L", // SourceExtension
+	"iL", // Name
+	"ilL", // MemberName
+	"rL", // String
+	"ill", // Line
+	NULL, // #9
+	"L", // Extension
+	"rL", // ExtInstImport
+	"trilI", // ExtInst
+	NULL, // #13
+	"ll", // MemoryModel
+	"lisI", // EntryPoint
+	"ilL", // ExecutionMode
+	"l", // Capability
+	NULL, // #18
+	"r", // TypeVoid
+	"r", // TypeBool
+	"rll", // TypeInt
+	"rlL", // TypeFloat
+	"ril", // TypeVector
+	"ril", // TypeMatrix
+	"rillllllL", // TypeImage
+	"r", // TypeSampler
+	"ri", // TypeSampledImage
+	"rii", // TypeArray
+	"ri", // TypeRuntimeArray
+	"rI", // TypeStruct
+	"rL", // TypeOpaque
+	"rli", // TypePointer
+	"riI", // TypeFunction
+	"r", // TypeEvent
+	"r", // TypeDeviceEvent
+	"r", // TypeReserveId
+	"r", // TypeQueue
+	"rl", // TypePipe
+	"il", // TypeForwardPointer
+	NULL, // #40
+	"tr", // ConstantTrue
+	"tr", // ConstantFalse
+	"trL", // Constant
+	"trI", // ConstantComposite
+	"trlll", // ConstantSampler
+	"tr", // ConstantNull
+	NULL, // #47
+	"tr", // SpecConstantTrue
+	"tr", // SpecConstantFalse
+	"trL", // SpecConstant
+	"trI", // SpecConstantComposite
+	"trX", // SpecConstantOp
+	NULL, // #53
+	"trli", // Function
+	"tr", // FunctionParameter
+	"", // FunctionEnd
+	"triI", // FunctionCall
+	NULL, // #58
+	"trlo", // Variable
+	"triii", // ImageTexelPointer
+	"triA", // Load
+	"iiA", // Store
+	"iiAA", // CopyMemory
+	"iiiAA", // CopyMemorySized
+	"triI", // AccessChain
+	"triI", // InBoundsAccessChain
+	"triiI", // PtrAccessChain
+	"tril", // ArrayLength
+	"tri", // GenericPtrMemSemantics
+	"triiI", // InBoundsPtrAccessChain
+	"ilL", // Decorate
+	"illL", // MemberDecorate
+	"r", // DecorationGroup
+	"iI", // GroupDecorate
+	"iG", // GroupMemberDecorate
+	NULL, // #76
+	"trii", // VectorExtractDynamic
+	"triii", // VectorInsertDynamic
+	"triiL", // VectorShuffle
+	"trI", // CompositeConstruct
+	"triL", // CompositeExtract
+	"triiL", // CompositeInsert
+	"tri", // CopyObject
+	"tri", // Transpose
+	NULL, // #85
+	"trii", // SampledImage
+	"triiM", // ImageSampleImplicitLod
+	"triiM", // ImageSampleExplicitLod
+	"triiiM", // ImageSampleDrefImplicitLod
+	"triiiM", // ImageSampleDrefExplicitLod
+	"triiM", // ImageSampleProjImplicitLod
+	"triiM", // ImageSampleProjExplicitLod
+	"triiiM", // ImageSampleProjDrefImplicitLod
+	"triiiM", // ImageSampleProjDrefExplicitLod
+	"triiM", // ImageFetch
+	"triiiM", // ImageGather
+	"triiiM", // ImageDrefGather
+	"triiM", // ImageRead
+	"iiiM", // ImageWrite
+	"tri", // Image
+	"tri", // ImageQueryFormat
+	"tri", // ImageQueryOrder
+	"trii", // ImageQuerySizeLod
+	"tri", // ImageQuerySize
+	"trii", // ImageQueryLod
+	"tri", // ImageQueryLevels
+	"tri", // ImageQuerySamples
+	NULL, // #108
+	"tri", // ConvertFToU
+	"tri", // ConvertFToS
+	"tri", // ConvertSToF
+	"tri", // ConvertUToF
+	"tri", // UConvert
+	"tri", // SConvert
+	"tri", // FConvert
+	"tri", // QuantizeToF16
+	"tri", // ConvertPtrToU
+	"tri", // SatConvertSToU
+	"tri", // SatConvertUToS
+	"tri", // ConvertUToPtr
+	"tri", // PtrCastToGeneric
+	"tri", // GenericCastToPtr
+	"tril", // GenericCastToPtrExplicit
+	"tri", // Bitcast
+	NULL, // #125
+	"tri", // SNegate
+	"tri", // FNegate
+	"trii", // IAdd
+	"trii", // FAdd
+	"trii", // ISub
+	"trii", // FSub
+	"trii", // IMul
+	"trii", // FMul
+	"trii", // UDiv
+	"trii", // SDiv
+	"trii", // FDiv
+	"trii", // UMod
+	"trii", // SRem
+	"trii", // SMod
+	"trii", // FRem
+	"trii", // FMod
+	"trii", // VectorTimesScalar
+	"trii", // MatrixTimesScalar
+	"trii", // VectorTimesMatrix
+	"trii", // MatrixTimesVector
+	"trii", // MatrixTimesMatrix
+	"trii", // OuterProduct
+	"trii", // Dot
+	"trii", // IAddCarry
+	"trii", // ISubBorrow
+	"trii", // UMulExtended
+	"trii", // SMulExtended
+	NULL, // #153
+	"tri", // Any
+	"tri", // All
+	"tri", // IsNan
+	"tri", // IsInf
+	"tri", // IsFinite
+	"tri", // IsNormal
+	"tri", // SignBitSet
+	"trii", // LessOrGreater
+	"trii", // Ordered
+	"trii", // Unordered
+	"trii", // LogicalEqual
+	"trii", // LogicalNotEqual
+	"trii", // LogicalOr
+	"trii", // LogicalAnd
+	"tri", // LogicalNot
+	"triii", // Select
+	"trii", // IEqual
+	"trii", // INotEqual
+	"trii", // UGreaterThan
+	"trii", // SGreaterThan
+	"trii", // UGreaterThanEqual
+	"trii", // SGreaterThanEqual
+	"trii", // ULessThan
+	"trii", // SLessThan
+	"trii", // ULessThanEqual
+	"trii", // SLessThanEqual
+	"trii", // FOrdEqual
+	"trii", // FUnordEqual
+	"trii", // FOrdNotEqual
+	"trii", // FUnordNotEqual
+	"trii", // FOrdLessThan
+	"trii", // FUnordLessThan
+	"trii", // FOrdGreaterThan
+	"trii", // FUnordGreaterThan
+	"trii", // FOrdLessThanEqual
+	"trii", // FUnordLessThanEqual
+	"trii", // FOrdGreaterThanEqual
+	"trii", // FUnordGreaterThanEqual
+	NULL, // #192
+	NULL, // #193
+	"trii", // ShiftRightLogical
+	"trii", // ShiftRightArithmetic
+	"trii", // ShiftLeftLogical
+	"trii", // BitwiseOr
+	"trii", // BitwiseXor
+	"trii", // BitwiseAnd
+	"tri", // Not
+	"triiii", // BitFieldInsert
+	"triii", // BitFieldSExtract
+	"triii", // BitFieldUExtract
+	"tri", // BitReverse
+	"tri", // BitCount
+	NULL, // #206
+	"tri", // DPdx
+	"tri", // DPdy
+	"tri", // Fwidth
+	"tri", // DPdxFine
+	"tri", // DPdyFine
+	"tri", // FwidthFine
+	"tri", // DPdxCoarse
+	"tri", // DPdyCoarse
+	"tri", // FwidthCoarse
+	NULL, // #216
+	NULL, // #217
+	"", // EmitVertex
+	"", // EndPrimitive
+	"i", // EmitStreamVertex
+	"i", // EndStreamPrimitive
+	NULL, // #222
+	NULL, // #223
+	"iii", // ControlBarrier
+	"ii", // MemoryBarrier
+	NULL, // #226
+	"triii", // AtomicLoad
+	"iiii", // AtomicStore
+	"triiii", // AtomicExchange
+	"triiiiii", // AtomicCompareExchange
+	"triiiiii", // AtomicCompareExchangeWeak
+	"triii", // AtomicIIncrement
+	"triii", // AtomicIDecrement
+	"triiii", // AtomicIAdd
+	"triiii", // AtomicISub
+	"triiii", // AtomicSMin
+	"triiii", // AtomicUMin
+	"triiii", // AtomicSMax
+	"triiii", // AtomicUMax
+	"triiii", // AtomicAnd
+	"triiii", // AtomicOr
+	"triiii", // AtomicXor
+	NULL, // #243
+	NULL, // #244
+	"trI", // Phi
+	"iilL", // LoopMerge
+	"il", // SelectionMerge
+	"r", // Label
+	"i", // Branch
+	"iiiL", // BranchConditional
+	"iiW", // Switch
+	"", // Kill
+	"", // Return
+	"i", // ReturnValue
+	"", // Unreachable
+	"il", // LifetimeStart
+	"il", // LifetimeStop
+	NULL, // #258
+	"triiiiii", // GroupAsyncCopy
+	"iii", // GroupWaitEvents
+	"trii", // GroupAll
+	"trii", // GroupAny
+	"triii", // GroupBroadcast
+	"trili", // GroupIAdd
+	"trili", // GroupFAdd
+	"trili", // GroupFMin
+	"trili", // GroupUMin
+	"trili", // GroupSMin
+	"trili", // GroupFMax
+	"trili", // GroupUMax
+	"trili", // GroupSMax
+	NULL, // #272
+	NULL, // #273
+	"triiii", // ReadPipe
+	"triiii", // WritePipe
+	"triiiiii", // ReservedReadPipe
+	"triiiiii", // ReservedWritePipe
+	"triiii", // ReserveReadPipePackets
+	"triiii", // ReserveWritePipePackets
+	"iiii", // CommitReadPipe
+	"iiii", // CommitWritePipe
+	"tri", // IsValidReserveId
+	"triii", // GetNumPipePackets
+	"triii", // GetMaxPipePackets
+	"triiiii", // GroupReserveReadPipePackets
+	"triiiii", // GroupReserveWritePipePackets
+	"iiiii", // GroupCommitReadPipe
+	"iiiii", // GroupCommitWritePipe
+	NULL, // #289
+	NULL, // #290
+	"triiii", // EnqueueMarker
+	"triiiiiiiiiiI", // EnqueueKernel
+	"triiiii", // GetKernelNDrangeSubGroupCount
+	"triiiii", // GetKernelNDrangeMaxSubGroupSize
+	"triiii", // GetKernelWorkGroupSize
+	"triiii", // GetKernelPreferredWorkGroupSizeMultiple
+	"i", // RetainEvent
+	"i", // ReleaseEvent
+	"tr", // CreateUserEvent
+	"tri", // IsValidEvent
+	"ii", // SetUserEventStatus
+	"iii", // CaptureEventProfilingInfo
+	"tr", // GetDefaultQueue
+	"triii", // BuildNDRange
+	"triiM", // ImageSparseSampleImplicitLod
+	"triiM", // ImageSparseSampleExplicitLod
+	"triiiM", // ImageSparseSampleDrefImplicitLod
+	"triiiM", // ImageSparseSampleDrefExplicitLod
+	"triiM", // ImageSparseSampleProjImplicitLod
+	"triiM", // ImageSparseSampleProjExplicitLod
+	"triiiM", // ImageSparseSampleProjDrefImplicitLod
+	"triiiM", // ImageSparseSampleProjDrefExplicitLod
+	"triiM", // ImageSparseFetch
+	"triiiM", // ImageSparseGather
+	"triiiM", // ImageSparseDrefGather
+	"tri", // ImageSparseTexelsResident
+	"", // NoLine
+	"triii", // AtomicFlagTestAndSet
+	"iii", // AtomicFlagClear
+	"triiM", // ImageSparseRead
+	NULL, // #321
+	NULL, // #322
+	NULL, // #323
+	NULL, // #324
+	NULL, // #325
+	NULL, // #326
+	NULL, // #327
+	NULL, // #328
+	NULL, // #329
+	"L", // ModuleProcessed
+	"ilI", // ExecutionModeId
+	"ilI", // DecorateId
+	"tri", // GroupNonUniformElect
+	"trii", // GroupNonUniformAll
+	"trii", // GroupNonUniformAny
+	"trii", // GroupNonUniformAllEqual
+	"triii", // GroupNonUniformBroadcast
+	"trii", // GroupNonUniformBroadcastFirst
+	"trii", // GroupNonUniformBallot
+	"trii", // GroupNonUniformInverseBallot
+	"triii", // GroupNonUniformBallotBitExtract
+	"trili", // GroupNonUniformBallotBitCount
+	"trii", // GroupNonUniformBallotFindLSB
+	"trii", // GroupNonUniformBallotFindMSB
+	"triii", // GroupNonUniformShuffle
+	"triii", // GroupNonUniformShuffleXor
+	"triii", // GroupNonUniformShuffleUp
+	"triii", // GroupNonUniformShuffleDown
+	"trilio", // GroupNonUniformIAdd
+	"trilio", // GroupNonUniformFAdd
+	"trilio", // GroupNonUniformIMul
+	"trilio", // GroupNonUniformFMul
+	"trilio", // GroupNonUniformSMin
+	"trilio", // GroupNonUniformUMin
+	"trilio", // GroupNonUniformFMin
+	"trilio", // GroupNonUniformSMax
+	"trilio", // GroupNonUniformUMax
+	"trilio", // GroupNonUniformFMax
+	"trilio", // GroupNonUniformBitwiseAnd
+	"trilio", // GroupNonUniformBitwiseOr
+	"trilio", // GroupNonUniformBitwiseXor
+	"trilio", // GroupNonUniformLogicalAnd
+	"trilio", // GroupNonUniformLogicalOr
+	"trilio", // GroupNonUniformLogicalXor
+	"triii", // GroupNonUniformQuadBroadcast
+	"triii", // GroupNonUniformQuadSwap
+};
+static_assert(_SMOLV_ARRAY_SIZE(kSpirvOpIdLayouts) == kKnownOpsCount, "kSpirvOpIdLayouts table mismatch with known SpvOps");
+
 // Instruction encoding depends on the table that describes the various SPIR-V opcodes.
 // Whenever we change or expand the table, we need to bump up the SMOL-V version, and make
 // sure that we can still decode files encoded by an older version.
@@ -1127,49 +1698,66 @@ static int smolv_GetKnownOpsCount(int version)
 		return SpvOpModuleProcessed+1;
 	if (version == 1) // 2020 February, version 1 added ExecutionModeId..GroupNonUniformQuadSwap
 		return SpvOpGroupNonUniformQuadSwap+1;
+	if (version == 2) // 2026 October, version 2 added header features word; same ops as version 1
+		return SpvOpGroupNonUniformQuadSwap+1;
+	if (version == 3) // 2026 October, version 3 added kSpirvOpDataSparse ops past that, compact ExtInst & Constant encoding
+		return SpvOpGroupNonUniformQuadSwap+1;
 	return 0;
 }
 
-static bool smolv_OpHasResult(SpvOp op, int opsCount)
+static bool smolv_OpDebugInfo(SpvOp op, int opsCount)
 {
-	if (op < 0 || op >= opsCount)
-		return false;
-	return kSpirvOpData[op].hasResult != 0;
+	return
+		op == SpvOpSourceContinued ||
+		op == SpvOpSource ||
+		op == SpvOpSourceExtension ||
+		op == SpvOpName ||
+		op == SpvOpMemberName ||
+		op == SpvOpString ||
+		op == SpvOpLine ||
+		op == SpvOpNoLine ||
+		op == SpvOpModuleProcessed;
 }
 
-static bool smolv_OpHasType(SpvOp op, int opsCount)
+// Debug info stripping state of a program; filled in as instructions are checked in order
+// (ExtInstImport instructions come before any uses of them).
+struct smolv_StripState
 {
-	if (op < 0 || op >= opsCount)
-		return false;
-	return kSpirvOpData[op].hasType != 0;
-}
+	std::vector<uint32_t> debugInfoSets; // IDs of imported non-semantic debug info instruction sets
+};
 
-static int smolv_OpDeltaFromResult(SpvOp op, int opsCount)
+// Whether it is ExtInstImport of NonSemantic.Shader.DebugInfo.100 or similar
+static bool smolv_IsDebugInfoExtInstImport(const uint32_t* words, SpvOp op)
 {
-	if (op < 0 || op >= opsCount)
-		return 0;
-	return kSpirvOpData[op].deltaFromResult;
+	static const char kPrefix[] = "NonSemantic.Shader.DebugInfo.";
+	const uint32_t len = words[0] >> 16;
+	if (op != SpvOpExtInstImport || len < 3 || (len - 2) * 4 < sizeof(kPrefix) - 1)
+		return false;
+	return memcmp(&words[2], kPrefix, sizeof(kPrefix) - 1) == 0;
 }
 
-static bool smolv_OpVarRest(SpvOp op, int opsCount)
+// Whether it is ExtInst (or ExtInstWithForwardRefsKHR) of a non-semantic debug info instruction set
+static bool smolv_IsDebugInfoExtInst(const smolv_StripState& strip, const uint32_t* words, SpvOp op)
 {
-	if (op < 0 || op >= opsCount)
+	if ((op != SpvOpExtInst && op != 4433) || (words[0] >> 16) < 4)
 		return false;
-	return kSpirvOpData[op].varrest != 0;
+	return std::find(strip.debugInfoSets.begin(), strip.debugInfoSets.end(), words[3]) != strip.debugInfoSets.end();
 }
 
-static bool smolv_OpDebugInfo(SpvOp op, int opsCount)
+// Whether debug info stripping removes the instruction
+static bool smolv_IsStripped(smolv_StripState& strip, const uint32_t* words, SpvOp op, int knownOpsCount, smolv::StripOpNameFilterFunc stripFilter)
 {
-	return
-		op == SpvOpSourceContinued ||
-		op == SpvOpSource ||
-		op == SpvOpSourceExtension ||
-		op == SpvOpName ||
-		op == SpvOpMemberName ||
-		op == SpvOpString ||
-		op == SpvOpLine ||
-		op == SpvOpNoLine ||
-		op == SpvOpModuleProcessed;
+	if (smolv_IsDebugInfoExtInstImport(words, op))
+	{
+		// all instructions of this set get stripped too
+		strip.debugInfoSets.push_back(words[1]);
+		return true;
+	}
+	if (smolv_IsDebugInfoExtInst(strip, words, op))
+		return true;
+	if (!smolv_OpDebugInfo(op, knownOpsCount))
+		return false;
+	return !stripFilter || op != SpvOpName || !stripFilter(reinterpret_cast<const char*>(&words[2]));
 }
 
 
@@ -1205,8 +1793,53 @@ static bool smolv_CheckGenericHeader(const uint32_t* words, size_t wordCount, ui
 
 static const int kSpirVHeaderMagic = 0x07230203;
 static const int kSmolHeaderMagic = 0x534D4F4C; // "SMOL"
+static const size_t kSmolHeaderSize = 24;
+
+// Encoding always writes this version (compact ExtInst and Constant encodings of version 3 are used by almost
+// any program), so decoders that only know older versions cannot read anything newly encoded.
+static const int kSmolCurrEncodingVersion = 3;
+
+// Version 2 has the same instruction encoding as version 1, but the header has an extra word with
+// SMOL-V features that are used, followed by extra header data for some of the features. Later versions
+// have the features word too.
+static const int kSmolFeaturesEncodingVersion = 2;
+// Version 3 encodes ops from kSpirvOpDataSparse (ray tracing, mesh shading etc.) like the known ones,
+// and has compact ExtInst and Constant encodings.
+static const int kSmolSparseOpsEncodingVersion = 3;
+enum
+{
+	kSmolFeatureDictionary = (1<<0), // encoded with a dictionary; dictionary ID follows in the header
+	kSmolFeatureEntropyCoded = (1<<1), // instructions are entropy coded; their size before & after entropy coding follows in the header
+	kSmolFeatureSplitStreams = (1<<2), // instruction fields are split into streams by kind; sizes of the streams follow in the header
+	kSmolFeatureRestartPoints = (1<<3), // decoding state gets reset at restart points; their count and offsets follow in the header
+	kSmolFeatureContentHash = (1<<4), // 64 bit hash of the decoded SPIR-V follows in the header (right after dictionary ID)
+	kSmolKnownFeatures = kSmolFeatureDictionary | kSmolFeatureEntropyCoded | kSmolFeatureSplitStreams | kSmolFeatureRestartPoints | kSmolFeatureContentHash,
+};
 
-static const int kSmolCurrEncodingVersion = 1;
+// Kinds of encoded instruction fields. Normally they are all interleaved in one stream; with
+// kEncodeFlagSplitStreams each kind goes into a separate stream, one after another. Fields of the
+// same kind have similar values, so data compressors do better on them that way.
+enum
+{
+	kSmolvStreamOps, // length + op varints, type IDs; MemberDecorate counts and compact VectorShuffle swizzles (bytes)
+	kSmolvStreamIds, // result ID deltas, operand IDs relative to the result, decoration targets relative to the previous one
+	kSmolvStreamVarRest, // other varints: VarRest operands, MemberDecorate data, ExtInst numbers, Constant literals etc.
+	kSmolvStreamLiterals, // words that are not varint encoded
+	kSmolvStreamCount
+};
+
+// header: features, dictionary ID, content hash, stream sizes, size before & after entropy coding
+// (restart points come on top of that, see smolv_GetMaxSmolHeaderSize)
+static const size_t kSmolMaxHeaderSize = kSmolHeaderSize + 4 + 4 + 8 + kSmolvStreamCount * 4 + 8;
+
+// Restart points are at least this much decoded SPIR-V apart
+static const size_t kSmolvMinRestartInterval = 1024;
+
+// Largest possible header for a program of given SPIR-V size: restart point count, and two words for each
+static size_t smolv_GetMaxSmolHeaderSize(size_t spirvSize)
+{
+	return kSmolMaxHeaderSize + 4 + (spirvSize / kSmolvMinRestartInterval) * 8;
+}
 
 static bool smolv_CheckSpirVHeader(const uint32_t* words, size_t wordCount)
 {
@@ -1214,28 +1847,64 @@ static bool smolv_CheckSpirVHeader(const uint32_t* words, size_t wordCount)
 	// in a "big endian" order. Need to byteswap all words then.
 	return smolv_CheckGenericHeader(words, wordCount, kSpirVHeaderMagic, 0xFFFFFFFF);
 }
+// Size of the whole SMOL-V header, given at least first byteCount bytes of it. If the size can not
+// be known yet, returns the size needed to find that out (larger than byteCount).
+static size_t smolv_GetSmolHeaderSize(const uint8_t* bytes, size_t byteCount)
+{
+	if (byteCount < kSmolHeaderSize)
+		return kSmolHeaderSize;
+	const int smolVersion = ((const uint32_t*)bytes)[1] >> 24;
+	if (smolVersion < kSmolFeaturesEncodingVersion)
+		return kSmolHeaderSize;
+	if (byteCount < kSmolHeaderSize + 4)
+		return kSmolHeaderSize + 4;
+	const uint32_t features = ((const uint32_t*)bytes)[6];
+	size_t size = kSmolHeaderSize + 4;
+	if (features & kSmolFeatureDictionary)
+		size += 4;
+	if (features & kSmolFeatureContentHash)
+		size += 8;
+	if (features & kSmolFeatureRestartPoints)
+	{
+		if (byteCount < size + 4)
+			return size + 4;
+		size += 4 + size_t(((const uint32_t*)(bytes + size))[0]) * 8;
+	}
+	if (features & kSmolFeatureSplitStreams)
+		size += kSmolvStreamCount * 4;
+	if (features & kSmolFeatureEntropyCoded)
+		size += 8;
+	return size;
+}
+
 static bool smolv_CheckSmolHeader(const uint8_t* bytes, size_t byteCount)
 {
 	if (!smolv_CheckGenericHeader((const uint32_t*)bytes, byteCount/4, kSmolHeaderMagic, 0x00FFFFFF))
 		return false;
-	if (byteCount < 24) // one more word past header to store decoded length
+	if (byteCount < kSmolHeaderSize) // one more word past header to store decoded length
 		return false;
 	// SMOL-V version
 	int smolVersion = ((const uint32_t*)bytes)[1] >> 24;
 	if (smolVersion < 0 || smolVersion > kSmolCurrEncodingVersion)
 		return false;
+	if (smolVersion >= kSmolFeaturesEncodingVersion && byteCount >= kSmolHeaderSize + 4)
+	{
+		const uint32_t* words = (const uint32_t*)bytes;
+		const uint32_t features = words[6];
+		if (features & ~kSmolKnownFeatures)
+			return false; // uses features that we don't know about
+		if ((features & kSmolFeatureRestartPoints) && (features & kSmolFeatureSplitStreams))
+			return false; // restart points are not used with split streams
+		const size_t restartCountWord = 7 + ((features & kSmolFeatureDictionary) ? 1 : 0) + ((features & kSmolFeatureContentHash) ? 2 : 0);
+		if ((features & kSmolFeatureRestartPoints) && byteCount >= (restartCountWord + 1) * 4 && words[restartCountWord] > words[5] / kSmolvMinRestartInterval)
+			return false; // more restart points than possible
+	}
+	if (byteCount < smolv_GetSmolHeaderSize(bytes, byteCount))
+		return false;
 	return true;
 }
 
 
-static void smolv_Write4(smolv::ByteArray& arr, uint32_t v)
-{
-	arr.push_back(v & 0xFF);
-	arr.push_back((v >> 8) & 0xFF);
-	arr.push_back((v >> 16) & 0xFF);
-	arr.push_back(v >> 24);
-}
-
 static void smolv_Write4(uint8_t*& buf, uint32_t v)
 {
 	memcpy(buf, &v, 4);
@@ -1255,36 +1924,120 @@ static bool smolv_Read4(const uint8_t*& data, const uint8_t* dataEnd, uint32_t&
 
 // --------------------------------------------------------------------------------------------
 
+static int smolv_CountTrailingZeros64(uint64_t v) // v must be non-zero
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+	unsigned long idx;
+	_BitScanForward64(&idx, v);
+	return (int)idx;
+#elif defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctzll(v);
+#else
+	int n = 0;
+	while (!(v & 1)) { v >>= 1; ++n; }
+	return n;
+#endif
+}
+
 // Variable-length integer encoding for unsigned integers. In each byte:
 // - highest bit set if more bytes follow, cleared if this is last byte.
 // - other 7 bits are the actual value payload.
 // Takes 1-5 bytes to encode an integer (values between 0 and 127 take one byte, etc.).
 
-static void smolv_WriteVarint(smolv::ByteArray& arr, uint32_t v)
+static void smolv_WriteVarint(uint8_t*& buf, uint32_t v)
 {
 	while (v > 127)
 	{
-		arr.push_back((v & 127) | 128);
+		*buf++ = (v & 127) | 128;
 		v >>= 7;
 	}
-	arr.push_back(v & 127);
+	*buf++ = v & 127;
+}
+
+// Multi byte varint out of 8 bytes loaded at once: find the terminating byte (high bit clear) from the
+// continuation bit mask, and gather the 7-bit payloads with shifts & masks instead of a data-dependent loop.
+// Needs at least 8 bytes of input left; returns false if the varint is longer than 5 bytes, or does
+// not fit into 32 bits.
+_SMOLV_FORCE_INLINE static bool smolv_ReadVarint8(const uint8_t*& data, uint32_t& outVal)
+{
+	uint64_t x;
+	memcpy(&x, data, 8);
+	const uint64_t stops = ~x & 0x8080808080ull; // high bit clear, within first 5 bytes
+	if (!stops)
+		return false;
+	const int len = (smolv_CountTrailingZeros64(stops) >> 3) + 1;
+	if (len == 5 && (x & 0x7000000000ull))
+		return false; // 5th byte has payload bits above bit 31
+	x &= ~0ull >> (64 - len * 8); // only keep bytes of this varint
+	outVal = uint32_t(
+		(x & 0x7F) |
+		((x >> 1) & 0x3F80) |
+		((x >> 2) & 0x1FC000) |
+		((x >> 3) & 0xFE00000) |
+		((x >> 4) & 0xF0000000));
+	data += len;
+	return true;
 }
 
-static bool smolv_ReadVarint(const uint8_t*& data, const uint8_t* dataEnd, uint32_t& outVal)
+_SMOLV_FORCE_INLINE static bool smolv_ReadVarint(const uint8_t*& data, const uint8_t* dataEnd, uint32_t& outVal)
 {
+	// Fast path when there's at least 8 bytes of input left (i.e. almost always): no end-of-data checks.
+	// Single byte varints are by far the most common, so handle them first.
+	if (dataEnd - data >= 8)
+	{
+		if (data[0] < 128)
+		{
+			outVal = *data++;
+			return true;
+		}
+		if (smolv_ReadVarint8(data, outVal))
+			return true;
+	}
+
+	// Slow path: byte by byte near the end of data (or on malformed input)
 	uint32_t v = 0;
 	uint32_t shift = 0;
 	while (data < dataEnd)
 	{
 		uint8_t b = *data;
+		if (shift == 28 && (b & ~0xF))
+		{
+			outVal = v;
+			return false; // longer than 5 bytes, or does not fit into 32 bits
+		}
 		v |= (b & 127) << shift;
 		shift += 7;
 		data++;
 		if (!(b & 128))
-			break;
+		{
+			outVal = v;
+			return true;
+		}
 	}
 	outVal = v;
-	return true; //@TODO: report failures
+	return false; // data ended in the middle of a varint
+}
+
+// Same for data that is known to be valid (kDecodeFlagTrusted): the varint is known to end before
+// dataEnd, so the only check left is whether 8 bytes can be loaded at once.
+_SMOLV_FORCE_INLINE static uint32_t smolv_ReadVarintTrusted(const uint8_t*& data, const uint8_t* dataEnd)
+{
+	if (data[0] < 128)
+		return *data++;
+	uint32_t v;
+	if (dataEnd - data >= 8 && smolv_ReadVarint8(data, v))
+		return v;
+	v = 0;
+	uint32_t shift = 0;
+	uint8_t b;
+	do
+	{
+		b = *data++;
+		if (shift < 32) // valid data never has more than 5 bytes; don't shift out of range if it does
+			v |= (b & 127) << shift;
+		shift += 7;
+	} while (b & 128);
+	return v;
 }
 
 static uint32_t smolv_ZigEncode(int32_t i)
@@ -1331,26 +2084,185 @@ static SpvOp smolv_RemapOp(SpvOp op)
 // instructions they are guaranteed to be some other minimum length. Adjust the length before encoding,
 // and after decoding accordingly.
 
-static uint32_t smolv_EncodeLen(SpvOp op, uint32_t len)
+static uint32_t smolv_LengthBias(SpvOp op)
+{
+	if (op == SpvOpVectorShuffle)			return 1 + 4;
+	if (op == SpvOpVectorShuffleCompact)	return 1 + 4;
+	if (op == SpvOpDecorate)				return 1 + 2;
+	if (op == SpvOpLoad)					return 1 + 3;
+	if (op == SpvOpAccessChain)				return 1 + 3;
+	return 1;
+}
+
+
+// --------------------------------------------------------------------------------------------
+// Op descriptor tables: everything that the encoder/decoder needs to know about an op (what it is
+// remapped to, length adjustment, how its operands are encoded), so that each instruction needs
+// just a single table lookup instead of a bunch of compares & separate lookups.
+// Built once from kSpirvOpData etc., for each SMOL-V encoding version.
+
+enum
+{
+	kSmolvOpHasResult = (1<<0),
+	kSmolvOpHasType = (1<<1),
+	kSmolvOpVarRest = (1<<2),
+	kSmolvOpRelativeToDecorate = (1<<3), // Decorate & MemberDecorate: target ID relative to previous one
+	kSmolvOpExtInst = (1<<4), // ExtInst: set ID only written when it changes, operand IDs relative to result
+	kSmolvOpConstant = (1<<5), // Constant: literal encoded based on its type
+	kSmolvOpNumericType = (1<<6), // TypeInt & TypeFloat: remembered, for encoding of constants
+};
+
+struct smolv_OpDesc
+{
+	uint16_t op; // encoding table: op value it is encoded as; decoding table: actual op of encoded value
+	uint8_t lenBias; // encoded length is this much smaller than actual instruction length
+	uint8_t flags; // kSmolvOp* bits
+	uint8_t deltaFromResult; // see OpData
+};
+
+// Ops below kKnownOpsCount are looked up directly. Sparse ops above that are in a two-level table:
+// op value >> kSmolvOpPageBits indexes a small page of descriptors; most of the pages do not exist.
+static const int kSmolvOpPageBits = 4;
+static const int kSmolvOpPageSize = 1 << kSmolvOpPageBits;
+static const int kSmolvOpPageCount = 8192 >> kSmolvOpPageBits; // ops above 8191 have no pages
+static const int kSmolvOpMaxPages = 48; // enough for all of kSpirvOpDataSparse
+
+struct smolv_OpTable
+{
+	smolv_OpDesc ops[kKnownOpsCount];
+	uint8_t pageIndex[kSmolvOpPageCount]; // index+1 into pages, zero if no page
+	smolv_OpDesc pages[kSmolvOpMaxPages][kSmolvOpPageSize];
+	int pageCount;
+};
+
+struct smolv_OpTables
+{
+	smolv_OpTable encode; // indexed by actual op
+	smolv_OpTable decode; // indexed by encoded op
+};
+
+static smolv_OpDesc smolv_MakeOpDesc(SpvOp op, SpvOp storedOp, const OpData* data)
+{
+	smolv_OpDesc d;
+	d.op = (uint16_t)storedOp;
+	d.lenBias = (uint8_t)smolv_LengthBias(op);
+	d.flags = 0;
+	d.deltaFromResult = 0;
+	if (data)
+	{
+		if (data->hasResult) d.flags |= kSmolvOpHasResult;
+		if (data->hasType) d.flags |= kSmolvOpHasType;
+		if (data->varrest) d.flags |= kSmolvOpVarRest;
+		d.deltaFromResult = data->deltaFromResult;
+	}
+	if (op == SpvOpDecorate || op == SpvOpMemberDecorate)
+		d.flags |= kSmolvOpRelativeToDecorate;
+	return d;
+}
+
+static void smolv_SetSparseOpDesc(smolv_OpTable& t, uint32_t op, const smolv_OpDesc& desc)
+{
+	const uint32_t page = op >> kSmolvOpPageBits;
+	if (!t.pageIndex[page])
+	{
+		t.pageIndex[page] = (uint8_t)++t.pageCount;
+		for (int i = 0; i < kSmolvOpPageSize; ++i)
+			t.pages[t.pageCount-1][i] = smolv_MakeOpDesc((SpvOp)((page << kSmolvOpPageBits) + i), (SpvOp)((page << kSmolvOpPageBits) + i), NULL);
+	}
+	t.pages[t.pageIndex[page]-1][op & (kSmolvOpPageSize-1)] = desc;
+}
+
+// Sparse ops are remapped to values right after kKnownOpsCount, so that their encoded op is small.
+// Ops that are in that range but not in the sparse table (not valid SPIR-V) get the values freed
+// up by that, to keep the mapping one-to-one.
+static void smolv_AddSparseOps(smolv_OpTables& t)
+{
+	const uint32_t rangeEnd = kKnownOpsCount + kSparseOpsCount;
+	int sparseIndex = 0; // next sparse op inside the range
+	int freeIndex = 0; // next sparse op outside of the range, its value is free for use
+	for (uint32_t value = kKnownOpsCount; value < rangeEnd; ++value)
+	{
+		while (sparseIndex < kSparseOpsCount && kSpirvOpDataSparse[sparseIndex].op < value)
+			++sparseIndex;
+		if (sparseIndex < kSparseOpsCount && kSpirvOpDataSparse[sparseIndex].op == value)
+			continue;
+		while (kSpirvOpDataSparse[freeIndex].op < rangeEnd)
+			++freeIndex;
+		const SpvOp op = (SpvOp)value;
+		const SpvOp stored = (SpvOp)kSpirvOpDataSparse[freeIndex++].op;
+		smolv_SetSparseOpDesc(t.encode, op, smolv_MakeOpDesc(op, stored, NULL));
+		smolv_SetSparseOpDesc(t.decode, stored, smolv_MakeOpDesc(op, op, NULL));
+	}
+	for (int i = 0; i < kSparseOpsCount; ++i)
+	{
+		const SpvOp op = (SpvOp)kSpirvOpDataSparse[i].op;
+		const SpvOp stored = (SpvOp)(kKnownOpsCount + i);
+		const OpData* data = &kSpirvOpDataSparse[i].data;
+		smolv_SetSparseOpDesc(t.encode, op, smolv_MakeOpDesc(op, stored, data));
+		smolv_SetSparseOpDesc(t.decode, stored, smolv_MakeOpDesc(op, op, data));
+	}
+}
+
+struct smolv_OpTablesAllVersions
 {
-	len--;
-	if (op == SpvOpVectorShuffle)			len -= 4;
-	if (op == SpvOpVectorShuffleCompact)	len -= 4;
-	if (op == SpvOpDecorate)				len -= 2;
-	if (op == SpvOpLoad)					len -= 3;
-	if (op == SpvOpAccessChain)				len -= 3;
-	return len;
+	smolv_OpTables tables[kSmolCurrEncodingVersion+1];
+	smolv_OpTablesAllVersions()
+	{
+		memset(tables, 0, sizeof(tables));
+		for (int version = 0; version <= kSmolCurrEncodingVersion; ++version)
+		{
+			const int opsCount = smolv_GetKnownOpsCount(version);
+			smolv_OpTables& t = tables[version];
+			for (int i = 0; i < kKnownOpsCount; ++i)
+			{
+				const SpvOp op = (SpvOp)i;
+				const SpvOp remapped = smolv_RemapOp(op);
+				t.encode.ops[i] = smolv_MakeOpDesc(op, remapped, op < opsCount ? &kSpirvOpData[op] : NULL);
+				t.decode.ops[i] = smolv_MakeOpDesc(remapped, remapped, remapped < opsCount ? &kSpirvOpData[remapped] : NULL);
+			}
+			if (version >= kSmolSparseOpsEncodingVersion)
+			{
+				smolv_AddSparseOps(t);
+				t.encode.ops[SpvOpExtInst].flags |= kSmolvOpExtInst;
+				t.encode.ops[SpvOpExtInstWithSet].flags |= kSmolvOpExtInst; // so that it gets rejected
+				t.decode.ops[smolv_RemapOp(SpvOpExtInst)].flags |= kSmolvOpExtInst;
+				t.decode.ops[SpvOpExtInstWithSet] = t.decode.ops[smolv_RemapOp(SpvOpExtInst)];
+				t.decode.ops[SpvOpExtInstWithSet].op = SpvOpExtInstWithSet;
+				t.decode.ops[SpvOpConstantRaw] = t.decode.ops[smolv_RemapOp(SpvOpConstant)];
+				t.encode.ops[SpvOpConstant].flags |= kSmolvOpConstant;
+				t.encode.ops[SpvOpConstantRaw].flags |= kSmolvOpConstant; // so that it gets rejected
+				t.decode.ops[smolv_RemapOp(SpvOpConstant)].flags |= kSmolvOpConstant;
+				t.encode.ops[SpvOpTypeInt].flags |= kSmolvOpNumericType;
+				t.encode.ops[SpvOpTypeFloat].flags |= kSmolvOpNumericType;
+				t.decode.ops[smolv_RemapOp(SpvOpTypeInt)].flags |= kSmolvOpNumericType;
+				t.decode.ops[smolv_RemapOp(SpvOpTypeFloat)].flags |= kSmolvOpNumericType;
+			}
+		}
+	}
+};
+
+static const smolv_OpTables& smolv_GetOpTables(int version) // version must be valid
+{
+	static const smolv_OpTablesAllVersions s_Tables;
+	return s_Tables.tables[version];
+}
+
+static smolv_OpDesc smolv_GetSparseOpDesc(const smolv_OpTable* table, uint32_t op)
+{
+	const uint32_t page = op >> kSmolvOpPageBits;
+	if (page < (uint32_t)kSmolvOpPageCount && table->pageIndex[page])
+		return table->pages[table->pageIndex[page]-1][op & (kSmolvOpPageSize-1)];
+	// ops unknown to SMOL-V are not remapped, and have no special encoding
+	smolv_OpDesc d = { (uint16_t)op, 1, 0, 0 };
+	return d;
 }
 
-static uint32_t smolv_DecodeLen(SpvOp op, uint32_t len)
+// Works for both encoding and decoding tables
+_SMOLV_FORCE_INLINE static smolv_OpDesc smolv_GetOpDesc(const smolv_OpTable* table, uint32_t op)
 {
-	len++;
-	if (op == SpvOpVectorShuffle)			len += 4;
-	if (op == SpvOpVectorShuffleCompact)	len += 4;
-	if (op == SpvOpDecorate)				len += 2;
-	if (op == SpvOpLoad)					len += 3;
-	if (op == SpvOpAccessChain)				len += 3;
-	return len;
+	if (op < (uint32_t)kKnownOpsCount)
+		return table->ops[op];
+	return smolv_GetSparseOpDesc(table, op);
 }
 
 
@@ -1358,30 +2270,36 @@ static uint32_t smolv_DecodeLen(SpvOp op, uint32_t len)
 // 0x LLLL OOOO is how SPIR-V encodes it (L=length, O=op), we shuffle into:
 // 0x LLLO OOLO, so that common case (op<16, len<8) is encoded into one byte.
 
-static bool smolv_WriteLengthOp(smolv::ByteArray& arr, uint32_t len, SpvOp op)
+_SMOLV_FORCE_INLINE static bool smolv_WriteLengthOp(uint8_t*& buf, uint32_t len, const smolv_OpDesc& desc)
 {
-	len = smolv_EncodeLen(op, len);
+	len -= desc.lenBias;
 	// SPIR-V length field is 16 bits; if we get a larger value that means something
 	// was wrong, e.g. a vector shuffle instruction with less than 4 words (and our
-	// adjustment to common lengths in smolv_EncodeLen wrapped around)
+	// adjustment to common lengths wrapped around)
 	if (len > 0xFFFF)
 		return false;
-	op = smolv_RemapOp(op);
+	const uint32_t op = desc.op;
 	uint32_t oplen = ((len >> 4) << 20) | ((op >> 4) << 8) | ((len & 0xF) << 4) | (op & 0xF);
-	smolv_WriteVarint(arr, oplen);
+	smolv_WriteVarint(buf, oplen);
 	return true;
 }
 
-static bool smolv_ReadLengthOp(const uint8_t*& data, const uint8_t* dataEnd, uint32_t& outLen, SpvOp& outOp)
+_SMOLV_FORCE_INLINE static void smolv_UnpackLengthOp(uint32_t val, const smolv_OpTable* decodeTable, uint32_t& outLen, SpvOp& outOp, smolv_OpDesc& outDesc)
+{
+	const uint32_t len = ((val >> 20) << 4) | ((val >> 4) & 0xF);
+	const uint32_t op = ((val >> 4) & 0xFFF0) | (val & 0xF);
+
+	outDesc = smolv_GetOpDesc(decodeTable, op);
+	outOp = (SpvOp)outDesc.op;
+	outLen = len + outDesc.lenBias;
+}
+
+_SMOLV_FORCE_INLINE static bool smolv_ReadLengthOp(const uint8_t*& data, const uint8_t* dataEnd, const smolv_OpTable* decodeTable, uint32_t& outLen, SpvOp& outOp, smolv_OpDesc& outDesc)
 {
 	uint32_t val;
 	if (!smolv_ReadVarint(data, dataEnd, val))
 		return false;
-	outLen = ((val >> 20) << 4) | ((val >> 4) & 0xF);
-	outOp = (SpvOp)(((val >> 4) & 0xFFF0) | (val & 0xF));
-
-	outOp = smolv_RemapOp(outOp);
-	outLen = smolv_DecodeLen(outOp, outLen);
+	smolv_UnpackLengthOp(val, decodeTable, outLen, outOp, outDesc);
 	return true;
 }
 
@@ -1394,220 +2312,2218 @@ static bool smolv_ReadLengthOp(const uint8_t*& data, const uint8_t* dataEnd, uin
 	SpvOp op = (SpvOp)(words[0] & 0xFFFF)
 
 
-bool smolv::Encode(const void* spirvData, size_t spirvSize, ByteArray& outSmolv, uint32_t flags, StripOpNameFilterFunc stripFilter)
+// Where the encoded instruction fields are written to / read from: one stream with all of them
+// interleaved, or a separate stream for each kind of field (kSmolFeatureSplitStreams). Encoding and
+// decoding code is templated on these, so that the usual single stream case does not get any slower.
+struct smolv_EncodeOutput
 {
-	const size_t wordCount = spirvSize / 4;
-	if (wordCount * 4 != spirvSize)
-		return false;
-	const uint32_t* words = (const uint32_t*)spirvData;
-	const uint32_t* wordsEnd = words + wordCount;
-	if (!smolv_CheckSpirVHeader(words, wordCount))
-		return false;
+	uint8_t* bytes;
 
-	// reserve space in output (typical compression is to about 30%; reserve half of input space)
-	outSmolv.reserve(outSmolv.size() + spirvSize/2);
+	uint8_t*& Get(int) { return bytes; }
+	// Space for trial encodings (see smolv_EncodeDictionaryRef); here it's right where the output goes.
+	uint8_t* Scratch() const { return bytes; }
+};
 
-	// header (matches SPIR-V one, except different magic)
-	smolv_Write4(outSmolv, kSmolHeaderMagic);
-	smolv_Write4(outSmolv, (words[1] & 0x00FFFFFF) + (kSmolCurrEncodingVersion<<24)); // SPIR-V version (_XXX) + SMOL-V version (X___)
-	smolv_Write4(outSmolv, words[2]); // generator
-	smolv_Write4(outSmolv, words[3]); // bound
-	smolv_Write4(outSmolv, words[4]); // schema
-
-	const size_t headerSpirvSizeOffset = outSmolv.size(); // size field may get updated later if stripping is enabled
-	smolv_Write4(outSmolv, (uint32_t)spirvSize); // space needed to decode (i.e. original SPIR-V size)
-
-	size_t strippedSpirvWordCount = wordCount;
-	uint32_t prevResult = 0;
-	uint32_t prevDecorate = 0;
-	
-	const int knownOpsCount = smolv_GetKnownOpsCount(kSmolCurrEncodingVersion);
+struct smolv_SplitEncodeOutput
+{
+	uint8_t* bytes[kSmolvStreamCount];
+	uint8_t* scratch; // large enough for encoding of the whole program
 
-	words += 5;
-	while (words < wordsEnd)
-	{
-		_SMOLV_READ_OP(instrLen, words, op);
+	uint8_t*& Get(int stream) { return bytes[stream]; }
+	uint8_t* Scratch() const { return scratch; }
+};
 
-		if ((flags & kEncodeFlagStripDebugInfo) && smolv_OpDebugInfo(op, knownOpsCount))
-		{
-			if (!stripFilter || op != SpvOpName || !stripFilter(reinterpret_cast<const char*>(&words[2])))
-			{
-				strippedSpirvWordCount -= instrLen;
-				words += instrLen;
-				continue;
-			}
-		}
+struct smolv_DecodeInput
+{
+	const uint8_t* bytes;
+	const uint8_t* bytesEnd;
 
-		// A usual case of vector shuffle, with less than 4 components, each with a value
-		// in [0..3] range: encode it in a more compact form, with the swizzle pattern in one byte.
-		// Turn this into a VectorShuffleCompact instruction, that takes up unused slot in Ops.
-		uint32_t swizzle = 0;
-		if (op == SpvOpVectorShuffle && instrLen <= 9)
-		{
-			uint32_t swz0 = instrLen > 5 ? words[5] : 0;
-			uint32_t swz1 = instrLen > 6 ? words[6] : 0;
-			uint32_t swz2 = instrLen > 7 ? words[7] : 0;
-			uint32_t swz3 = instrLen > 8 ? words[8] : 0;
-			if (swz0 < 4 && swz1 < 4 && swz2 < 4 && swz3 < 4)
-			{
-				op = SpvOpVectorShuffleCompact;
-				swizzle = (swz0 << 6) | (swz1 << 4) | (swz2 << 2) | (swz3);
-			}
-		}
+	const uint8_t*& Get(int) { return bytes; }
+	const uint8_t* End(int) const { return bytesEnd; }
+	bool AtEnd() const { return bytes >= bytesEnd; } // no more instructions
+	bool AllRead() const { return bytes == bytesEnd; }
+	// Sum of stream positions; only differences between them (bytes read in between) mean anything.
+	size_t Position() const { return size_t(bytes); }
 
-		// length + opcode
-		if (!smolv_WriteLengthOp(outSmolv, instrLen, op))
+	_SMOLV_FORCE_INLINE bool ReadVarint(int, uint32_t& outVal) { return smolv_ReadVarint(bytes, bytesEnd, outVal); }
+	bool Read4(int, uint32_t& outVal) { return smolv_Read4(bytes, bytesEnd, outVal); }
+	bool ReadByte(int, uint32_t& outVal)
+	{
+		if (bytes >= bytesEnd)
 			return false;
+		outVal = *bytes++;
+		return true;
+	}
+};
 
-		size_t ioffs = 1;
-		// write type as varint, if we have it
-		if (smolv_OpHasType(op, knownOpsCount))
-		{
-			if (ioffs >= instrLen)
-				return false;
-			smolv_WriteVarint(outSmolv, words[ioffs]);
-			ioffs++;
-		}
-		// write result as delta+zig+varint, if we have it
-		if (smolv_OpHasResult(op, knownOpsCount))
-		{
-			if (ioffs >= instrLen)
-				return false;
-			uint32_t v = words[ioffs];
-			smolv_WriteVarint(outSmolv, smolv_ZigEncode(v - prevResult)); // some deltas are negative, use zig
-			prevResult = v;
-			ioffs++;
-		}
-
-		// Decorate & MemberDecorate: IDs relative to previous decorate
-		if (op == SpvOpDecorate || op == SpvOpMemberDecorate)
-		{
-			if (ioffs >= instrLen)
-				return false;
-			uint32_t v = words[ioffs];
-			smolv_WriteVarint(outSmolv, smolv_ZigEncode(v - prevDecorate)); // spirv-remapped deltas often negative, use zig
-			prevDecorate = v;
-			ioffs++;
-		}
-
-		// MemberDecorate special encoding: whole row of MemberDecorate instructions is often referring
-		// to the same type and linearly increasing member indices. Scan ahead to see how many we have,
-		// and encode whole bunch as one.
-		if (op == SpvOpMemberDecorate)
-		{
-			// scan ahead until we reach end, non-member-decoration or different type
-			const uint32_t decorationType = words[ioffs-1];
-			const uint32_t* memberWords = words;
-			uint32_t prevIndex = 0;
-			uint32_t prevOffset = 0;
-			// write a byte on how many we have encoded as a bunch
-			size_t countLocation = outSmolv.size();
-			outSmolv.push_back(0);
-			int count = 0;
-			while (memberWords < wordsEnd && count < 255)
-			{
-				_SMOLV_READ_OP(memberLen, memberWords, memberOp);
-				if (memberOp != SpvOpMemberDecorate)
-					break;
-				if (memberLen < 4)
-					return false; // invalid input
-				if (memberWords[1] != decorationType)
-					break;
-
-				// write member index as delta from previous
-				uint32_t memberIndex = memberWords[2];
-				smolv_WriteVarint(outSmolv, memberIndex - prevIndex);
-				prevIndex = memberIndex;
+// Input that passed smolv::Validate (kDecodeFlagTrusted): reads never fail, so the compiler drops all
+// the "ran out of input" branches from the decoding loop.
+struct smolv_TrustedDecodeInput
+{
+	const uint8_t* bytes;
+	const uint8_t* bytesEnd;
 
-				// decoration (and length if not common/known)
-				uint32_t memberDec = memberWords[3];
-				smolv_WriteVarint(outSmolv, memberDec);
-				const int knownExtraOps = smolv_DecorationExtraOps(memberDec);
-				if (knownExtraOps == -1)
-					smolv_WriteVarint(outSmolv, memberLen-4);
-				else if (unsigned(knownExtraOps) + 4 != memberLen)
-					return false; // invalid input
+	const uint8_t*& Get(int) { return bytes; }
+	const uint8_t* End(int) const { return bytesEnd; }
+	bool AtEnd() const { return bytes >= bytesEnd; }
+	bool AllRead() const { return bytes == bytesEnd; }
+	size_t Position() const { return size_t(bytes); }
 
-				// Offset decorations are most often linearly increasing, so encode as deltas
-				if (memberDec == 35) // Offset
-				{
-					if (memberLen != 5)
-						return false;
-					smolv_WriteVarint(outSmolv, memberWords[4]-prevOffset);
-					prevOffset = memberWords[4];
-				}
-				else
-				{
-					// write rest of decorations as varint
-					for (uint32_t i = 4; i < memberLen; ++i)
-						smolv_WriteVarint(outSmolv, memberWords[i]);
-				}
+	_SMOLV_FORCE_INLINE bool ReadVarint(int, uint32_t& outVal) { outVal = smolv_ReadVarintTrusted(bytes, bytesEnd); return true; }
+	bool Read4(int, uint32_t& outVal)
+	{
+		outVal = (bytes[0]) | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
+		bytes += 4;
+		return true;
+	}
+	bool ReadByte(int, uint32_t& outVal) { outVal = *bytes++; return true; }
+};
 
-				memberWords += memberLen;
-				++count;
-			}
-			outSmolv[countLocation] = uint8_t(count);
-			words = memberWords;
-			continue;
-		}
+struct smolv_SplitDecodeInput
+{
+	const uint8_t* bytes[kSmolvStreamCount];
+	const uint8_t* bytesEnd[kSmolvStreamCount];
 
-		// Write out this many IDs, encoding them relative+zigzag to result ID
-		int relativeCount = smolv_OpDeltaFromResult(op, knownOpsCount);
-		for (int i = 0; i < relativeCount && ioffs < instrLen; ++i, ++ioffs)
-		{
-			if (ioffs >= instrLen)
+	const uint8_t*& Get(int stream) { return bytes[stream]; }
+	const uint8_t* End(int stream) const { return bytesEnd[stream]; }
+	bool AtEnd() const { return bytes[kSmolvStreamOps] >= bytesEnd[kSmolvStreamOps]; }
+	bool AllRead() const
+	{
+		for (int i = 0; i < kSmolvStreamCount; ++i)
+			if (bytes[i] != bytesEnd[i])
 				return false;
-			uint32_t delta = prevResult - words[ioffs];
-			// some deltas are negative (often on branches, or if program was processed by spirv-remap),
-			// so use zig encoding
-			smolv_WriteVarint(outSmolv, smolv_ZigEncode(delta));
-		}
-
-		if (op == SpvOpVectorShuffleCompact)
-		{
-			// compact vector shuffle, just write out single swizzle byte
-			outSmolv.push_back(uint8_t(swizzle));
-			ioffs = instrLen;
-		}
-		else if (smolv_OpVarRest(op, knownOpsCount))
-		{
-			// write out rest of words with variable encoding (expected to be small integers)
-			for (; ioffs < instrLen; ++ioffs)
-				smolv_WriteVarint(outSmolv, words[ioffs]);
-		}
-		else
-		{
-			// write out rest of words without any encoding
-			for (; ioffs < instrLen; ++ioffs)
-				smolv_Write4(outSmolv, words[ioffs]);
-		}
-		
-		words += instrLen;
+		return true;
+	}
+	size_t Position() const
+	{
+		size_t pos = 0;
+		for (int i = 0; i < kSmolvStreamCount; ++i)
+			pos += size_t(bytes[i]);
+		return pos;
 	}
 
-	if (strippedSpirvWordCount != wordCount)
+	_SMOLV_FORCE_INLINE bool ReadVarint(int stream, uint32_t& outVal) { return smolv_ReadVarint(bytes[stream], bytesEnd[stream], outVal); }
+	bool Read4(int stream, uint32_t& outVal) { return smolv_Read4(bytes[stream], bytesEnd[stream], outVal); }
+	bool ReadByte(int stream, uint32_t& outVal)
 	{
-		uint8_t* headerSpirvSize = &outSmolv[headerSpirvSizeOffset];
-		smolv_Write4(headerSpirvSize, (uint32_t)strippedSpirvWordCount * 4);
+		if (bytes[stream] >= bytesEnd[stream])
+			return false;
+		outVal = *bytes[stream]++;
+		return true;
 	}
-	
-	return true;
+};
+
+
+// Constants: literals are encoded based on what their type is, so the numeric types declared in the
+// program are remembered. Programs only have a handful of them; any past the first few are not
+// remembered, and constants of those types are written as is.
+enum
+{
+	kSmolvTypeUnknown,
+	kSmolvTypeInt, // 32 bits or less
+	kSmolvTypeInt64,
+	kSmolvTypeFloat,
+	kSmolvTypeFloat64,
+};
+static const int kSmolvMaxNumericTypes = 16;
+
+struct smolv_NumericTypes
+{
+	uint32_t ids[kSmolvMaxNumericTypes];
+	uint8_t kinds[kSmolvMaxNumericTypes];
+	int count;
+};
+
+// words: TypeInt or TypeFloat instruction
+static void smolv_AddNumericType(smolv_NumericTypes& types, const uint32_t* words, uint32_t instrLen)
+{
+	if (instrLen < 3 || types.count == kSmolvMaxNumericTypes)
+		return;
+	const uint32_t width = words[2];
+	uint8_t kind = kSmolvTypeUnknown;
+	if ((words[0] & 0xFFFF) == SpvOpTypeInt)
+		kind = width <= 32 ? kSmolvTypeInt : (width == 64 ? kSmolvTypeInt64 : kSmolvTypeUnknown);
+	else if (instrLen == 3) // floats with explicit encoding operand are not handled
+		kind = width == 32 ? kSmolvTypeFloat : (width == 64 ? kSmolvTypeFloat64 : kSmolvTypeUnknown);
+	if (kind == kSmolvTypeUnknown)
+		return;
+	types.ids[types.count] = words[1];
+	types.kinds[types.count] = kind;
+	types.count++;
 }
 
+static int smolv_FindNumericType(const smolv_NumericTypes& types, uint32_t id)
+{
+	for (int i = 0; i < types.count; ++i)
+		if (types.ids[i] == id)
+			return types.kinds[i];
+	return kSmolvTypeUnknown;
+}
 
-size_t smolv::GetDecodedBufferSize(const void* smolvData, size_t smolvSize)
+static uint32_t smolv_ReverseBits(uint32_t v)
 {
-	if (!smolv_CheckSmolHeader((const uint8_t*)smolvData, smolvSize))
-		return 0;
-	const uint32_t* words = (const uint32_t*)smolvData;
-	return words[5];
+	v = ((v >> 1) & 0x55555555) | ((v & 0x55555555) << 1);
+	v = ((v >> 2) & 0x33333333) | ((v & 0x33333333) << 2);
+	v = ((v >> 4) & 0x0F0F0F0F) | ((v & 0x0F0F0F0F) << 4);
+	v = ((v >> 8) & 0x00FF00FF) | ((v & 0x00FF00FF) << 8);
+	return (v >> 16) | (v << 16);
 }
 
+// Float bits (or high word of a double) rearranged so that "nice" values like 0.5, 1.0, 2.0, -1.0 come out
+// as small numbers: sign in the lowest bit, then exponent relative to 1.0 (zigzag), then the mantissa
+// with its bits reversed (nice values only have a few high mantissa bits set).
+static uint32_t smolv_FloatToToken(uint32_t bits, int mantissaBits, int exponentBits)
+{
+	const uint32_t exponentMask = (1u << exponentBits) - 1;
+	const uint32_t exponent = ((bits >> mantissaBits) - (exponentMask >> 1)) & exponentMask; // 1.0 -> 0
+	const uint32_t exponentZig = ((exponent << 1) ^ (0u - (exponent >> (exponentBits - 1)))) & exponentMask; // zigzag within exponent bits
+	const uint32_t mantissa = smolv_ReverseBits(bits << (32 - mantissaBits));
+	return (mantissa << (exponentBits + 1)) | (exponentZig << 1) | (bits >> 31);
+}
 
-bool smolv::Decode(const void* smolvData, size_t smolvSize, void* spirvOutputBuffer, size_t spirvOutputBufferSize, uint32_t flags)
+static uint32_t smolv_TokenToFloat(uint32_t token, int mantissaBits, int exponentBits)
+{
+	const uint32_t exponentMask = (1u << exponentBits) - 1;
+	const uint32_t exponentZig = (token >> 1) & exponentMask;
+	const uint32_t exponent = ((exponentZig >> 1) ^ (0u - (exponentZig & 1))) & exponentMask;
+	const uint32_t mantissa = smolv_ReverseBits(token >> (exponentBits + 1)) >> (32 - mantissaBits);
+	return (token << 31) | (((exponent + (exponentMask >> 1)) & exponentMask) << mantissaBits) | mantissa;
+}
+
+
+// Encoding state that is carried over from one instruction to the next
+struct smolv_EncodeState
+{
+	uint32_t prevResult;
+	uint32_t prevDecorate;
+	uint32_t prevExtInstSet;
+	smolv_NumericTypes numericTypes;
+	const smolv_OpTable* opTable; // encoding table for the SMOL-V version
+};
+
+// State carried over from one instruction to the next starts out like this, and gets reset to it
+// at restart points (kSmolFeatureRestartPoints).
+template<typename State>
+static void smolv_RestartState(State& state)
+{
+	state.prevResult = 0;
+	state.prevDecorate = 0;
+	state.prevExtInstSet = 0;
+	state.numericTypes.count = 0;
+}
+
+// Restart points placed while encoding
+struct smolv_EncodeRestartPoints
+{
+	size_t interval; // at least this much SPIR-V between them
+	const uint8_t* instructionsBegin;
+	std::vector<uint32_t> points; // for each: offset into encoded instructions, offset into SPIR-V
+};
+
+// ExtInst: nearly all of them use the same (GLSL.std.450) instruction set, so the set ID is only
+// written when it changes, by using ExtInstWithSet op instead. Extended instruction number follows
+// as varint, and the operands (all IDs) are relative to the result ID.
+template<typename Output>
+_SMOLV_NO_INLINE static bool smolv_EncodeExtInst(smolv_EncodeState& state, const uint32_t*& words, uint32_t instrLen, Output& out)
+{
+	if (instrLen < 5 || (words[0] & 0xFFFF) != SpvOpExtInst)
+		return false; // invalid input
+	const uint32_t set = words[3];
+	const bool newSet = set != state.prevExtInstSet;
+	if (!smolv_WriteLengthOp(out.Get(kSmolvStreamOps), instrLen, smolv_GetOpDesc(state.opTable, newSet ? SpvOpExtInstWithSet : SpvOpExtInst)))
+		return false;
+	smolv_WriteVarint(out.Get(kSmolvStreamOps), words[1]); // type
+	smolv_WriteVarint(out.Get(kSmolvStreamIds), smolv_ZigEncode(words[2] - state.prevResult)); // result
+	state.prevResult = words[2];
+	if (newSet)
+	{
+		smolv_WriteVarint(out.Get(kSmolvStreamVarRest), set);
+		state.prevExtInstSet = set;
+	}
+	smolv_WriteVarint(out.Get(kSmolvStreamVarRest), words[4]); // extended instruction
+	for (uint32_t i = 5; i < instrLen; ++i)
+		smolv_WriteVarint(out.Get(kSmolvStreamIds), smolv_ZigEncode(state.prevResult - words[i]));
+	words += instrLen;
+	return true;
+}
+
+// Constant: literal is encoded based on the type. Integers as zigzag varints, floats as varint of
+// smolv_FloatToToken; 64 bit values as two varints. If that would not be smaller than the literal
+// words themselves (or the type is not known), writes ConstantRaw op with regular encoding instead.
+template<typename Output>
+_SMOLV_NO_INLINE static bool smolv_EncodeConstant(smolv_EncodeState& state, const uint32_t*& words, uint32_t instrLen, Output& out)
+{
+	if (instrLen < 3 || (words[0] & 0xFFFF) != SpvOpConstant)
+		return false; // invalid input
+	uint8_t literal[10];
+	uint8_t* literalEnd = literal;
+	switch (smolv_FindNumericType(state.numericTypes, words[1]))
+	{
+	case kSmolvTypeInt:
+		if (instrLen == 4)
+			smolv_WriteVarint(literalEnd, smolv_ZigEncode(words[3]));
+		break;
+	case kSmolvTypeInt64:
+		if (instrLen == 5)
+		{
+			const uint64_t v = words[3] | (uint64_t(words[4]) << 32);
+			const uint64_t zig = (v << 1) ^ (0 - (v >> 63));
+			smolv_WriteVarint(literalEnd, uint32_t(zig));
+			smolv_WriteVarint(literalEnd, uint32_t(zig >> 32));
+		}
+		break;
+	case kSmolvTypeFloat:
+		if (instrLen == 4)
+			smolv_WriteVarint(literalEnd, smolv_FloatToToken(words[3], 23, 8));
+		break;
+	case kSmolvTypeFloat64:
+		if (instrLen == 5)
+		{
+			smolv_WriteVarint(literalEnd, smolv_ReverseBits(words[3]));
+			smolv_WriteVarint(literalEnd, smolv_FloatToToken(words[4], 20, 11));
+		}
+		break;
+	}
+	const size_t literalSize = literalEnd - literal;
+	const bool raw = literalSize == 0 || literalSize >= (instrLen - 3) * 4;
+	if (!smolv_WriteLengthOp(out.Get(kSmolvStreamOps), instrLen, smolv_GetOpDesc(state.opTable, raw ? SpvOpConstantRaw : SpvOpConstant)))
+		return false;
+	smolv_WriteVarint(out.Get(kSmolvStreamOps), words[1]); // type
+	smolv_WriteVarint(out.Get(kSmolvStreamIds), smolv_ZigEncode(words[2] - state.prevResult)); // result
+	state.prevResult = words[2];
+	if (raw)
+	{
+		for (uint32_t i = 3; i < instrLen; ++i)
+			smolv_Write4(out.Get(kSmolvStreamLiterals), words[i]);
+	}
+	else
+	{
+		memcpy(out.Get(kSmolvStreamVarRest), literal, literalSize);
+		out.Get(kSmolvStreamVarRest) += literalSize;
+	}
+	words += instrLen;
+	return true;
+}
+
+// Encodes one SPIR-V instruction (or a run of MemberDecorate instructions, as one), that has
+// already been checked to fit into the input with _SMOLV_READ_OP. Output buffer is assumed to have enough space.
+template<typename Output>
+_SMOLV_FORCE_INLINE static bool smolv_EncodeInstruction(smolv_EncodeState& state, const uint32_t*& words, const uint32_t* wordsEnd, uint32_t instrLen, SpvOp op, Output& out)
+{
+	// A usual case of vector shuffle, with less than 4 components, each with a value
+	// in [0..3] range: encode it in a more compact form, with the swizzle pattern in one byte.
+	// Turn this into a VectorShuffleCompact instruction, that takes up unused slot in Ops.
+	uint32_t swizzle = 0;
+	if (op == SpvOpVectorShuffle && instrLen <= 9)
+	{
+		uint32_t swz0 = instrLen > 5 ? words[5] : 0;
+		uint32_t swz1 = instrLen > 6 ? words[6] : 0;
+		uint32_t swz2 = instrLen > 7 ? words[7] : 0;
+		uint32_t swz3 = instrLen > 8 ? words[8] : 0;
+		if (swz0 < 4 && swz1 < 4 && swz2 < 4 && swz3 < 4)
+		{
+			op = SpvOpVectorShuffleCompact;
+			swizzle = (swz0 << 6) | (swz1 << 4) | (swz2 << 2) | (swz3);
+		}
+	}
+
+	// length + opcode
+	const smolv_OpDesc desc = smolv_GetOpDesc(state.opTable, op);
+	if (desc.flags & (kSmolvOpExtInst | kSmolvOpConstant))
+	{
+		// copies of the pointers for non-inlined functions, see smolv_DecodeInstruction
+		const uint32_t* w = words;
+		Output o = out;
+		const bool ok = (desc.flags & kSmolvOpExtInst) ?
+			smolv_EncodeExtInst(state, w, instrLen, o) :
+			smolv_EncodeConstant(state, w, instrLen, o);
+		words = w;
+		out = o;
+		return ok;
+	}
+	if (desc.flags & kSmolvOpNumericType)
+		smolv_AddNumericType(state.numericTypes, words, instrLen); // and encode it regularly
+	if (!smolv_WriteLengthOp(out.Get(kSmolvStreamOps), instrLen, desc))
+		return false;
+
+	size_t ioffs = 1;
+	// write type as varint, if we have it
+	if (desc.flags & kSmolvOpHasType)
+	{
+		if (ioffs >= instrLen)
+			return false;
+		smolv_WriteVarint(out.Get(kSmolvStreamOps), words[ioffs]);
+		ioffs++;
+	}
+	// write result as delta+zig+varint, if we have it
+	if (desc.flags & kSmolvOpHasResult)
+	{
+		if (ioffs >= instrLen)
+			return false;
+		uint32_t v = words[ioffs];
+		smolv_WriteVarint(out.Get(kSmolvStreamIds), smolv_ZigEncode(v - state.prevResult)); // some deltas are negative, use zig
+		state.prevResult = v;
+		ioffs++;
+	}
+
+	// Decorate & MemberDecorate: IDs relative to previous decorate
+	if (desc.flags & kSmolvOpRelativeToDecorate)
+	{
+		if (ioffs >= instrLen)
+			return false;
+		uint32_t v = words[ioffs];
+		smolv_WriteVarint(out.Get(kSmolvStreamIds), smolv_ZigEncode(v - state.prevDecorate)); // spirv-remapped deltas often negative, use zig
+		state.prevDecorate = v;
+		ioffs++;
+	}
+
+	// MemberDecorate special encoding: whole row of MemberDecorate instructions is often referring
+	// to the same type and linearly increasing member indices. Scan ahead to see how many we have,
+	// and encode whole bunch as one.
+	if (op == SpvOpMemberDecorate)
+	{
+		// scan ahead until we reach end, non-member-decoration or different type
+		const uint32_t decorationType = words[ioffs-1];
+		const uint32_t* memberWords = words;
+		uint32_t prevIndex = 0;
+		uint32_t prevOffset = 0;
+		// write a byte on how many we have encoded as a bunch
+		uint8_t* countLocation = out.Get(kSmolvStreamOps)++;
+		int count = 0;
+		while (memberWords < wordsEnd && count < 255)
+		{
+			_SMOLV_READ_OP(memberLen, memberWords, memberOp);
+			if (memberOp != SpvOpMemberDecorate)
+				break;
+			if (memberLen < 4)
+				return false; // invalid input
+			if (memberWords[1] != decorationType)
+				break;
+
+			// write member index as delta from previous
+			uint32_t memberIndex = memberWords[2];
+			smolv_WriteVarint(out.Get(kSmolvStreamVarRest), memberIndex - prevIndex);
+			prevIndex = memberIndex;
+
+			// decoration (and length if not common/known)
+			uint32_t memberDec = memberWords[3];
+			smolv_WriteVarint(out.Get(kSmolvStreamVarRest), memberDec);
+			const int knownExtraOps = smolv_DecorationExtraOps(memberDec);
+			if (knownExtraOps == -1)
+				smolv_WriteVarint(out.Get(kSmolvStreamVarRest), memberLen-4);
+			else if (unsigned(knownExtraOps) + 4 != memberLen)
+				return false; // invalid input
+
+			// Offset decorations are most often linearly increasing, so encode as deltas
+			if (memberDec == 35) // Offset
+			{
+				if (memberLen != 5)
+					return false;
+				smolv_WriteVarint(out.Get(kSmolvStreamVarRest), memberWords[4]-prevOffset);
+				prevOffset = memberWords[4];
+			}
+			else
+			{
+				// write rest of decorations as varint
+				for (uint32_t i = 4; i < memberLen; ++i)
+					smolv_WriteVarint(out.Get(kSmolvStreamVarRest), memberWords[i]);
+			}
+
+			memberWords += memberLen;
+			++count;
+		}
+		*countLocation = uint8_t(count);
+		words = memberWords;
+		return true;
+	}
+
+	// Write out this many IDs, encoding them relative+zigzag to result ID
+	int relativeCount = desc.deltaFromResult;
+	for (int i = 0; i < relativeCount && ioffs < instrLen; ++i, ++ioffs)
+	{
+		if (ioffs >= instrLen)
+			return false;
+		uint32_t delta = state.prevResult - words[ioffs];
+		// some deltas are negative (often on branches, or if program was processed by spirv-remap),
+		// so use zig encoding
+		smolv_WriteVarint(out.Get(kSmolvStreamIds), smolv_ZigEncode(delta));
+	}
+
+	if (op == SpvOpVectorShuffleCompact)
+	{
+		// compact vector shuffle, just write out single swizzle byte
+		*out.Get(kSmolvStreamOps)++ = uint8_t(swizzle);
+		ioffs = instrLen;
+	}
+	else if (desc.flags & kSmolvOpVarRest)
+	{
+		// write out rest of words with variable encoding (expected to be small integers)
+		for (; ioffs < instrLen; ++ioffs)
+			smolv_WriteVarint(out.Get(kSmolvStreamVarRest), words[ioffs]);
+	}
+	else
+	{
+		// write out rest of words without any encoding
+		for (; ioffs < instrLen; ++ioffs)
+			smolv_Write4(out.Get(kSmolvStreamLiterals), words[ioffs]);
+	}
+	
+	words += instrLen;
+	return true;
+}
+
+
+// --------------------------------------------------------------------------------------------
+// Dictionaries: instructions common to many programs, that can be referenced instead of encoded
+
+
+struct smolv::Dictionary
+{
+	uint32_t id; // hash of the instructions, stored in encoded data to check that same dictionary is used
+	std::vector<uint32_t> words; // SPIR-V instructions
+	std::vector<uint32_t> instrOffsets; // word offset of each instruction, plus end offset
+	std::vector<uint64_t> lookup; // sorted (instruction hash << 32) | instruction index
+};
+
+static uint32_t smolv_HashWords(const uint32_t* words, size_t count)
+{
+	// FNV-1a, on whole words
+	uint32_t h = 2166136261u;
+	for (size_t i = 0; i < count; ++i)
+	{
+		h ^= words[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+smolv::Dictionary* smolv::DictionaryCreate(const void* smolvData, size_t smolvSize)
+{
+	ByteArray spirv(GetDecodedBufferSize(smolvData, smolvSize));
+	if (spirv.size() < 20 || !Decode(smolvData, smolvSize, spirv.data(), spirv.size()))
+		return NULL;
+
+	Dictionary* d = new Dictionary();
+	d->words.resize(spirv.size() / 4 - 5);
+	if (!d->words.empty())
+		memcpy(d->words.data(), spirv.data() + 20, d->words.size() * 4);
+	d->id = smolv_HashWords(d->words.data(), d->words.size());
+
+	const uint32_t* words = d->words.data();
+	const uint32_t* wordsEnd = words + d->words.size();
+	for (const uint32_t* w = words; w < wordsEnd; )
+	{
+		const uint32_t len = w[0] >> 16;
+		if (len < 1 || w + len > wordsEnd)
+		{
+			delete d;
+			return NULL;
+		}
+		const uint32_t index = (uint32_t)d->instrOffsets.size();
+		d->instrOffsets.push_back(uint32_t(w - words));
+		d->lookup.push_back((uint64_t(smolv_HashWords(w, len)) << 32) | index);
+		w += len;
+	}
+	d->instrOffsets.push_back((uint32_t)d->words.size());
+	std::sort(d->lookup.begin(), d->lookup.end());
+	return d;
+}
+
+void smolv::DictionaryDelete(Dictionary* d)
+{
+	delete d;
+}
+
+// Updates "previous result/decoration ID" state, same as encoding or decoding the instruction would.
+static void smolv_UpdateStateFromInstruction(const smolv_OpTable* spirvOpTable, const uint32_t* words, uint32_t& prevResult, uint32_t& prevDecorate, uint32_t& prevExtInstSet, smolv_NumericTypes& numericTypes)
+{
+	const uint32_t len = words[0] >> 16;
+	const smolv_OpDesc desc = smolv_GetOpDesc(spirvOpTable, words[0] & 0xFFFF);
+	if ((desc.flags & kSmolvOpExtInst) && len >= 5)
+		prevExtInstSet = words[3];
+	if (desc.flags & kSmolvOpNumericType)
+		smolv_AddNumericType(numericTypes, words, len);
+	uint32_t ioffs = 1;
+	if (desc.flags & kSmolvOpHasType)
+		ioffs++;
+	if ((desc.flags & kSmolvOpHasResult) && ioffs < len)
+		prevResult = words[ioffs++];
+	if ((desc.flags & kSmolvOpRelativeToDecorate) && ioffs < len)
+		prevDecorate = words[ioffs];
+}
+
+// Finds the longest run of dictionary instructions that matches the input at given position.
+// Returns number of matched instructions (zero if none).
+static uint32_t smolv_DictionaryFindMatch(const smolv::Dictionary& dict, const uint32_t* words, const uint32_t* wordsEnd, const smolv_StripState* strip, uint32_t& outStart, const uint32_t*& outEnd)
+{
+	const uint32_t len = words[0] >> 16;
+	const uint64_t hash = smolv_HashWords(words, len);
+	const uint32_t instrCount = (uint32_t)dict.instrOffsets.size() - 1;
+	const int kMaxCandidates = 32;
+	uint32_t bestCount = 0;
+	std::vector<uint64_t>::const_iterator it = std::lower_bound(dict.lookup.begin(), dict.lookup.end(), hash << 32);
+	for (int c = 0; c < kMaxCandidates && it != dict.lookup.end() && (*it >> 32) == hash; ++c, ++it)
+	{
+		const uint32_t start = uint32_t(*it);
+		uint32_t count = 0;
+		const uint32_t* w = words;
+		while (start + count < instrCount && w < wordsEnd && count < 0xFFFF)
+		{
+			const uint32_t* dw = dict.words.data() + dict.instrOffsets[start + count];
+			const uint32_t wlen = w[0] >> 16;
+			const SpvOp op = (SpvOp)(w[0] & 0xFFFF);
+			if (wlen < 1 || w + wlen > wordsEnd || dw[0] != w[0] || memcmp(dw, w, wlen * 4) != 0)
+				break;
+			if (op == SpvOpDictionaryRef)
+				break;
+			if (strip && (smolv_OpDebugInfo(op, 0) || smolv_IsDebugInfoExtInstImport(w, op) || smolv_IsDebugInfoExtInst(*strip, w, op)))
+				break;
+			w += wlen;
+			++count;
+		}
+		if (count > 0 && w > outEnd)
+		{
+			bestCount = count;
+			outStart = start;
+			outEnd = w;
+		}
+	}
+	return bestCount;
+}
+
+// Regular encoding of a dictionary match turned out smaller than a reference. With a single output
+// stream it's already in place; split streams need it encoded again.
+static bool smolv_EncodeRegularRun(smolv_EncodeOutput& out, const smolv_EncodeOutput& regularOut, smolv_EncodeState, const uint32_t*, const uint32_t*, const uint32_t*)
+{
+	out = regularOut;
+	return true;
+}
+
+static bool smolv_EncodeRegularRun(smolv_SplitEncodeOutput& out, const smolv_EncodeOutput&, smolv_EncodeState state, const uint32_t* words, const uint32_t* runEnd, const uint32_t* wordsEnd)
+{
+	while (words < runEnd)
+	{
+		_SMOLV_READ_OP(instrLen, words, op);
+		if (!smolv_EncodeInstruction(state, words, wordsEnd, instrLen, op, out))
+			return false;
+	}
+	return true;
+}
+
+// Tries to encode instructions at current position as a reference into the dictionary. Returns
+// true if it encoded something (either as a reference, or regularly if that turned out smaller).
+template<typename Output>
+static bool smolv_EncodeDictionaryRef(const smolv::Dictionary& dict, smolv_EncodeState& state, const uint32_t*& words, const uint32_t* wordsEnd, const smolv_StripState* strip, Output& out)
+{
+	uint32_t start = 0;
+	const uint32_t* runEnd = words;
+	const uint32_t count = smolv_DictionaryFindMatch(dict, words, wordsEnd, strip, start, runEnd);
+	if (count == 0)
+		return false;
+
+	// encode the run regularly, and see if a reference would be smaller
+	smolv_EncodeState regularState = state;
+	const uint32_t* regularWords = words;
+	uint8_t* const regularBegin = out.Scratch();
+	smolv_EncodeOutput regularOut = { regularBegin };
+	while (regularWords < runEnd)
+	{
+		_SMOLV_READ_OP(instrLen, regularWords, op);
+		if (!smolv_EncodeInstruction(regularState, regularWords, wordsEnd, instrLen, op, regularOut))
+			return false;
+	}
+	if (regularWords != runEnd)
+		return false; // MemberDecorate run went past the matched instructions; just encode regularly
+
+	// reference: instruction count in the length field, and varint starting instruction index
+	static const smolv_OpDesc kRefDesc = { SpvOpDictionaryRef, 1, 0, 0 };
+	uint8_t ref[10];
+	uint8_t* refEnd = ref;
+	smolv_WriteLengthOp(refEnd, count, kRefDesc);
+	smolv_WriteVarint(refEnd, start);
+	if (refEnd - ref < regularOut.bytes - regularBegin)
+	{
+		smolv_WriteLengthOp(out.Get(kSmolvStreamOps), count, kRefDesc);
+		smolv_WriteVarint(out.Get(kSmolvStreamVarRest), start);
+	}
+	else if (!smolv_EncodeRegularRun(out, regularOut, state, words, runEnd, wordsEnd))
+		return false;
+	state = regularState;
+	words = runEnd;
+	return true;
+}
+
+
+// --------------------------------------------------------------------------------------------
+// Entropy coding: optional stage on top of the encoded instructions (kEncodeFlagEntropyCode).
+//
+// Canonical Huffman codes, with two sets of them: one for bytes that follow a byte with the high
+// bit set (varint continuation bytes, larger IDs and literals), and one for all other bytes (op
+// tokens, small IDs/deltas, and first bytes of varints). These have quite different statistics.
+//
+// Data is split into four parts, each coded into its own bitstream, so that the decoder can work
+// on all four at once (decoding a single Huffman stream is bound by latency of table lookups).
+//
+// Coded data is: for each of the two contexts, 32 byte bitmap of used byte values, followed by
+// 4 bit code lengths of the used values (two per byte); then sizes of the first three bitstreams
+// as varints; then the bitstreams, most significant bit first.
+
+
+static const int kSmolvEntropyContexts = 2;
+static const int kSmolvEntropyStreams = 4;
+static const int kSmolvEntropyMaxCodeLength = 11;
+static const int kSmolvEntropyTableSize = 1 << kSmolvEntropyMaxCodeLength;
+
+static int smolv_EntropyContext(uint8_t prevByte)
+{
+	return prevByte >> 7;
+}
+
+// Huffman code lengths for given byte counts, limited to kSmolvEntropyMaxCodeLength. Lengths
+// over the limit are rare (very skewed counts); when that happens the counts get flattened and
+// lengths are built again.
+static void smolv_EntropyBuildLengths(const uint32_t counts[256], uint8_t lengths[256])
+{
+	uint32_t c[256];
+	memcpy(c, counts, sizeof(c));
+	while (true)
+	{
+		memset(lengths, 0, 256);
+		int syms[256];
+		int n = 0;
+		for (int i = 0; i < 256; ++i)
+			if (c[i])
+				syms[n++] = i;
+		if (n == 0)
+			return;
+		if (n == 1)
+		{
+			lengths[syms[0]] = 1;
+			return;
+		}
+		std::sort(syms, syms + n, [&c](int a, int b) { return c[a] != c[b] ? c[a] < c[b] : a < b; });
+
+		// two queues: leaves sorted by weight, and internal nodes that are created in increasing
+		// weight order
+		uint64_t weights[511];
+		int parents[511];
+		for (int i = 0; i < n; ++i)
+			weights[i] = c[syms[i]];
+		int leaf = 0, node = n;
+		for (int next = n; next < 2 * n - 1; ++next)
+		{
+			int pick[2];
+			for (int k = 0; k < 2; ++k)
+			{
+				if (leaf < n && (node >= next || weights[leaf] <= weights[node]))
+					pick[k] = leaf++;
+				else
+					pick[k] = node++;
+			}
+			weights[next] = weights[pick[0]] + weights[pick[1]];
+			parents[pick[0]] = parents[pick[1]] = next;
+		}
+		// depths, from the root down
+		int depths[511];
+		int maxDepth = 0;
+		depths[2 * n - 2] = 0;
+		for (int i = 2 * n - 3; i >= 0; --i)
+		{
+			depths[i] = depths[parents[i]] + 1;
+			if (i < n)
+				maxDepth = std::max(maxDepth, depths[i]);
+		}
+		if (maxDepth <= kSmolvEntropyMaxCodeLength)
+		{
+			for (int i = 0; i < n; ++i)
+				lengths[syms[i]] = (uint8_t)depths[i];
+			return;
+		}
+		for (int i = 0; i < 256; ++i)
+			c[i] = (c[i] + 1) >> 1;
+	}
+}
+
+// Canonical codes for given lengths: shorter codes first, same length codes in byte value order.
+static void smolv_EntropyBuildCodes(const uint8_t lengths[256], uint16_t codes[256])
+{
+	int lengthCounts[kSmolvEntropyMaxCodeLength + 1] = {};
+	for (int i = 0; i < 256; ++i)
+		lengthCounts[lengths[i]]++;
+	lengthCounts[0] = 0;
+	uint32_t nextCode[kSmolvEntropyMaxCodeLength + 1];
+	uint32_t code = 0;
+	for (int len = 1; len <= kSmolvEntropyMaxCodeLength; ++len)
+	{
+		code = (code + lengthCounts[len - 1]) << 1;
+		nextCode[len] = code;
+	}
+	for (int i = 0; i < 256; ++i)
+		if (lengths[i])
+			codes[i] = (uint16_t)nextCode[lengths[i]]++;
+}
+
+// Part of the data where each of the bitstreams starts
+static size_t smolv_EntropyStreamStart(size_t size, int stream)
+{
+	return std::min((size + kSmolvEntropyStreams - 1) / kSmolvEntropyStreams * stream, size);
+}
+
+static bool smolv_EntropyEncodeStream(const uint8_t* bytes, const uint8_t* bytesEnd, const uint8_t lengths[][256], const uint16_t codes[][256], uint8_t*& out, uint8_t* outEnd)
+{
+	// bits go from the top of the buffer down
+	uint64_t bits = 0;
+	int bitCount = 0;
+	uint8_t prev = 0;
+	for (; bytes < bytesEnd; ++bytes)
+	{
+		const int ctx = smolv_EntropyContext(prev);
+		prev = *bytes;
+		bitCount += lengths[ctx][prev];
+		bits |= uint64_t(codes[ctx][prev]) << (64 - bitCount);
+		for (; bitCount >= 8; bitCount -= 8, bits <<= 8)
+		{
+			if (out == outEnd)
+				return false;
+			*out++ = uint8_t(bits >> 56);
+		}
+	}
+	if (bitCount > 0)
+	{
+		if (out == outEnd)
+			return false;
+		*out++ = uint8_t(bits >> 56);
+	}
+	return true;
+}
+
+// Entropy codes the encoded instructions into [out, outEnd). Returns coded size, or zero if it did
+// not fit (caller uses that to only entropy code when it makes the data smaller).
+static size_t smolv_EntropyEncode(const uint8_t* bytes, size_t size, uint8_t* out, uint8_t* outEnd)
+{
+	uint32_t counts[kSmolvEntropyContexts][256] = {};
+	for (int i = 0; i < kSmolvEntropyStreams; ++i)
+	{
+		uint8_t prev = 0;
+		for (size_t j = smolv_EntropyStreamStart(size, i); j < smolv_EntropyStreamStart(size, i + 1); ++j)
+		{
+			counts[smolv_EntropyContext(prev)][bytes[j]]++;
+			prev = bytes[j];
+		}
+	}
+
+	uint8_t* const outBegin = out;
+	uint8_t lengths[kSmolvEntropyContexts][256];
+	uint16_t codes[kSmolvEntropyContexts][256];
+	for (int ctx = 0; ctx < kSmolvEntropyContexts; ++ctx)
+	{
+		smolv_EntropyBuildLengths(counts[ctx], lengths[ctx]);
+		smolv_EntropyBuildCodes(lengths[ctx], codes[ctx]);
+		if (outEnd - out < 32 + 128)
+			return 0;
+		memset(out, 0, 32);
+		for (int i = 0; i < 256; ++i)
+			if (lengths[ctx][i])
+				out[i >> 3] |= 1 << (i & 7);
+		out += 32;
+		int used = 0;
+		for (int i = 0; i < 256; ++i)
+		{
+			if (!lengths[ctx][i])
+				continue;
+			if (used & 1)
+				out[-1] |= lengths[ctx][i] << 4;
+			else
+				*out++ = lengths[ctx][i];
+			++used;
+		}
+	}
+
+	// bitstreams go after space for the largest possible sizes, then get moved to right after the sizes
+	const size_t kSizesSpace = (kSmolvEntropyStreams - 1) * 5;
+	if (size_t(outEnd - out) < kSizesSpace)
+		return 0;
+	uint8_t* streams = out + kSizesSpace;
+	uint8_t* streamsEnd = streams;
+	uint32_t streamSizes[kSmolvEntropyStreams];
+	for (int i = 0; i < kSmolvEntropyStreams; ++i)
+	{
+		uint8_t* streamBegin = streamsEnd;
+		if (!smolv_EntropyEncodeStream(bytes + smolv_EntropyStreamStart(size, i), bytes + smolv_EntropyStreamStart(size, i + 1), lengths, codes, streamsEnd, outEnd))
+			return 0;
+		streamSizes[i] = uint32_t(streamsEnd - streamBegin);
+	}
+	for (int i = 0; i < kSmolvEntropyStreams - 1; ++i)
+		smolv_WriteVarint(out, streamSizes[i]);
+	memmove(out, streams, streamsEnd - streams);
+	out += streamsEnd - streams;
+	return out - outBegin;
+}
+
+// One of the bitstreams being decoded
+struct smolv_EntropyStream
+{
+	const uint8_t* in;
+	const uint8_t* inBegin;
+	const uint8_t* inEnd;
+	uint8_t* out;
+	uint8_t* outEnd;
+	uint64_t bits;
+	int bitCount;
+	const uint16_t* table; // for the context of the next byte
+};
+
+// Refills the bit buffer with 8 bytes at once; caller checks that there are that many. Valid bits
+// are at the top of the buffer.
+_SMOLV_FORCE_INLINE static void smolv_EntropyRefill(smolv_EntropyStream& s)
+{
+	uint64_t v;
+	memcpy(&v, s.in, 8);
+#	if defined(_MSC_VER)
+	v = _byteswap_uint64(v);
+#	elif defined(__GNUC__) || defined(__clang__)
+	v = __builtin_bswap64(v);
+#	else
+	v = ((v & 0xFF) << 56) | ((v & 0xFF00) << 40) | ((v & 0xFF0000) << 24) | ((v & 0xFF000000) << 8) |
+		((v >> 8) & 0xFF000000) | ((v >> 24) & 0xFF0000) | ((v >> 40) & 0xFF00) | (v >> 56);
+#	endif
+	s.bits |= v >> s.bitCount;
+	s.in += (63 - s.bitCount) >> 3;
+	s.bitCount |= 56;
+}
+
+_SMOLV_FORCE_INLINE static void smolv_EntropyDecodeByte(smolv_EntropyStream& s, const uint16_t tables[][kSmolvEntropyTableSize])
+{
+	const uint32_t e = s.table[s.bits >> (64 - kSmolvEntropyMaxCodeLength)];
+	s.bits <<= e >> 8;
+	s.bitCount -= e >> 8;
+	*s.out++ = uint8_t(e);
+	s.table = tables[(e >> 7) & 1];
+}
+
+// Decodes entropy coded data (of exactly codedSize bytes) into size bytes of encoded instructions.
+static bool smolv_EntropyDecode(const uint8_t* in, size_t codedSize, uint8_t* out, size_t size)
+{
+	const uint8_t* inEnd = in + codedSize;
+
+	// decoding tables: (code length << 8) | byte value, indexed by next kSmolvEntropyMaxCodeLength bits
+	uint16_t tables[kSmolvEntropyContexts][kSmolvEntropyTableSize];
+	for (int ctx = 0; ctx < kSmolvEntropyContexts; ++ctx)
+	{
+		if (inEnd - in < 32)
+			return false;
+		const uint8_t* bitmap = in;
+		in += 32;
+		// read lengths, and sort the byte values into canonical code order
+		uint8_t lengths[256];
+		int lengthCounts[kSmolvEntropyMaxCodeLength + 1] = {};
+		int used = 0;
+		for (int i = 0; i < 256; ++i)
+		{
+			if (!(bitmap[i >> 3] & (1 << (i & 7))))
+				continue;
+			if (!(used & 1) && in == inEnd)
+				return false;
+			const int len = (used & 1) ? (in[-1] >> 4) : (*in++ & 15);
+			if (len == 0 || len > kSmolvEntropyMaxCodeLength)
+				return false;
+			lengths[used++] = uint8_t(len);
+			lengthCounts[len]++;
+		}
+		int offsets[kSmolvEntropyMaxCodeLength + 1];
+		int space = 0;
+		offsets[1] = 0;
+		for (int len = 1; len <= kSmolvEntropyMaxCodeLength; ++len)
+		{
+			if (len > 1)
+				offsets[len] = offsets[len - 1] + lengthCounts[len - 1];
+			space += lengthCounts[len] << (kSmolvEntropyMaxCodeLength - len);
+		}
+		if (space > kSmolvEntropyTableSize)
+			return false; // over-subscribed code
+		uint8_t sorted[256];
+		for (int i = 0, u = 0; i < 256; ++i)
+			if (bitmap[i >> 3] & (1 << (i & 7)))
+				sorted[offsets[lengths[u++]]++] = uint8_t(i);
+
+		// with the codes in canonical order, entries for each byte value come right after previous ones
+		uint16_t* t = tables[ctx];
+		for (int len = 1, u = 0; len <= kSmolvEntropyMaxCodeLength; ++len)
+		{
+			const int count = 1 << (kSmolvEntropyMaxCodeLength - len);
+			for (int n = lengthCounts[len]; n > 0; --n, ++u)
+			{
+				const uint16_t e = uint16_t((len << 8) | sorted[u]);
+				for (int k = 0; k < count; ++k)
+					*t++ = e;
+			}
+		}
+		// codes that are not used by the data (incomplete code) decode into something harmless
+		for (; t < tables[ctx] + kSmolvEntropyTableSize; ++t)
+			*t = kSmolvEntropyMaxCodeLength << 8;
+	}
+
+	uint32_t streamSizes[kSmolvEntropyStreams];
+	for (int i = 0; i < kSmolvEntropyStreams - 1; ++i)
+		if (!smolv_ReadVarint(in, inEnd, streamSizes[i]))
+			return false;
+	smolv_EntropyStream s[kSmolvEntropyStreams];
+	for (int i = 0; i < kSmolvEntropyStreams; ++i)
+	{
+		const size_t streamSize = i < kSmolvEntropyStreams - 1 ? streamSizes[i] : size_t(inEnd - in);
+		if (streamSize > size_t(inEnd - in))
+			return false;
+		s[i].inBegin = s[i].in = in;
+		s[i].inEnd = in += streamSize;
+		s[i].out = out + smolv_EntropyStreamStart(size, i);
+		s[i].outEnd = out + smolv_EntropyStreamStart(size, i + 1);
+		s[i].bits = 0;
+		s[i].bitCount = 0;
+		s[i].table = tables[0];
+	}
+
+	// all four streams at once, refilling 8 bytes at a time; that has enough bits for 5 codes
+	// (last stream is the shortest one)
+	while (s[3].outEnd - s[3].out >= 5 &&
+		s[0].inEnd - s[0].in >= 8 && s[1].inEnd - s[1].in >= 8 && s[2].inEnd - s[2].in >= 8 && s[3].inEnd - s[3].in >= 8)
+	{
+		smolv_EntropyRefill(s[0]); smolv_EntropyRefill(s[1]); smolv_EntropyRefill(s[2]); smolv_EntropyRefill(s[3]);
+		for (int k = 0; k < 5; ++k)
+		{
+			smolv_EntropyDecodeByte(s[0], tables);
+			smolv_EntropyDecodeByte(s[1], tables);
+			smolv_EntropyDecodeByte(s[2], tables);
+			smolv_EntropyDecodeByte(s[3], tables);
+		}
+	}
+	// the rest of each stream, a byte at a time
+	for (int i = 0; i < kSmolvEntropyStreams; ++i)
+	{
+		smolv_EntropyStream& st = s[i];
+		while (st.out < st.outEnd)
+		{
+			for (; st.bitCount <= 56 && st.in < st.inEnd; st.bitCount += 8)
+				st.bits |= uint64_t(*st.in++) << (56 - st.bitCount);
+			if (int(st.table[st.bits >> (64 - kSmolvEntropyMaxCodeLength)] >> 8) > st.bitCount)
+				return false; // stream ended
+			smolv_EntropyDecodeByte(st, tables);
+		}
+		// should have used all of the stream, except for the padding bits
+		const size_t bitsUsed = size_t(st.in - st.inBegin) * 8 - st.bitCount;
+		const size_t bitsTotal = size_t(st.inEnd - st.inBegin) * 8;
+		if (bitsUsed > bitsTotal || bitsUsed + 8 <= bitsTotal)
+			return false;
+	}
+	return true;
+}
+
+// Whether encoded instructions of a SMOL-V program are entropy coded; if they are, gets their size
+// before and after entropy coding (last two words of the header).
+static bool smolv_IsEntropyCoded(const uint8_t* smolvData, size_t headerSize, uint32_t& outSize, uint32_t& outCodedSize)
+{
+	const uint32_t* header = (const uint32_t*)smolvData;
+	const int smolVersion = header[1] >> 24;
+	if (smolVersion < kSmolFeaturesEncodingVersion || !(header[6] & kSmolFeatureEntropyCoded))
+		return false;
+	outSize = header[headerSize / 4 - 2];
+	outCodedSize = header[headerSize / 4 - 1];
+	return true;
+}
+
+// Whether encoded instructions of a SMOL-V program are split into streams by kind; if they are, gets
+// the stream sizes (from the header, before the entropy coding sizes).
+static bool smolv_IsSplitStreams(const uint8_t* smolvData, size_t headerSize, uint32_t outSizes[kSmolvStreamCount])
+{
+	const uint32_t* header = (const uint32_t*)smolvData;
+	const int smolVersion = header[1] >> 24;
+	if (smolVersion < kSmolFeaturesEncodingVersion || !(header[6] & kSmolFeatureSplitStreams))
+		return false;
+	const uint32_t* sizes = header + headerSize / 4 - kSmolvStreamCount - ((header[6] & kSmolFeatureEntropyCoded) ? 2 : 0);
+	memcpy(outSizes, sizes, kSmolvStreamCount * 4);
+	return true;
+}
+
+// Gets restart points of a SMOL-V program (pairs of offsets into the encoded instructions and into the
+// decoded SPIR-V, see smolv_EncodeInstructions); returns their count.
+static uint32_t smolv_GetRestartPoints(const uint8_t* smolvData, const uint32_t*& outPoints)
+{
+	const uint32_t* header = (const uint32_t*)smolvData;
+	const int smolVersion = header[1] >> 24;
+	outPoints = NULL;
+	if (smolVersion < kSmolFeaturesEncodingVersion || !(header[6] & kSmolFeatureRestartPoints))
+		return 0;
+	const uint32_t* count = header + 7 + ((header[6] & kSmolFeatureDictionary) ? 1 : 0) + ((header[6] & kSmolFeatureContentHash) ? 2 : 0);
+	outPoints = count + 1;
+	return *count;
+}
+
+// Gets the content hash of a SMOL-V program, if it has one stored.
+static bool smolv_GetStoredHash(const uint8_t* smolvData, uint64_t& outHash)
+{
+	const uint32_t* header = (const uint32_t*)smolvData;
+	const int smolVersion = header[1] >> 24;
+	if (smolVersion < kSmolFeaturesEncodingVersion || !(header[6] & kSmolFeatureContentHash))
+		return false;
+	const uint32_t* hash = header + 7 + ((header[6] & kSmolFeatureDictionary) ? 1 : 0);
+	outHash = hash[0] | (uint64_t(hash[1]) << 32);
+	return true;
+}
+
+// Restart points have to be in increasing order, and inside the encoded instructions and decoded SPIR-V.
+static bool smolv_CheckRestartPoints(const uint32_t* points, uint32_t count, size_t instructionsSize, size_t spirvSize)
+{
+	uint32_t prevIn = 0, prevOut = 20;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const uint32_t in = points[i * 2], out = points[i * 2 + 1];
+		if (in <= prevIn || in >= instructionsSize || out <= prevOut || out >= spirvSize || (out & 3))
+			return false;
+		prevIn = in;
+		prevOut = out;
+	}
+	return true;
+}
+
+// Points the input streams into encoded instructions; the stream sizes have to add up to their size.
+static bool smolv_SplitStreams(const uint32_t sizes[kSmolvStreamCount], const uint8_t* bytes, const uint8_t* bytesEnd, smolv_SplitDecodeInput& outInput)
+{
+	for (int i = 0; i < kSmolvStreamCount; ++i)
+	{
+		if (size_t(bytesEnd - bytes) < sizes[i])
+			return false;
+		outInput.bytes[i] = bytes;
+		bytes += sizes[i];
+		outInput.bytesEnd[i] = bytes;
+	}
+	return bytes == bytesEnd;
+}
+
+// If encoded instructions are entropy coded, decodes them into the given array and points
+// bytes/bytesEnd to it. bytes should point past the SMOL-V header.
+static bool smolv_EntropyDecodeInstructions(const uint8_t* smolvData, const uint8_t*& bytes, const uint8_t*& bytesEnd, smolv::ByteArray& buffer)
+{
+	uint32_t size, codedSize;
+	if (!smolv_IsEntropyCoded(smolvData, bytes - smolvData, size, codedSize))
+		return true;
+	if (size_t(bytesEnd - bytes) != codedSize || size / 8 > codedSize)
+		return false; // coded size does not match, or decoded size is more than possible
+	buffer.resize(size);
+	if (!smolv_EntropyDecode(bytes, codedSize, buffer.data(), size))
+		return false;
+	bytes = buffer.data();
+	bytesEnd = bytes + size;
+	return true;
+}
+
+
+// --------------------------------------------------------------------------------------------
+// Canonical ID numbering (kEncodeFlagCanonicalizeIds): result IDs get renumbered in the order they are
+// defined in, so that result ID deltas are almost always 1 and operand IDs are close to the result.
+
+static const char* smolv_GetIdLayout(uint32_t op)
+{
+	if (op < (uint32_t)kKnownOpsCount)
+		return kSpirvOpIdLayouts[op];
+	// a few common sparse ops; programs with any other ones are not renumbered
+	switch (op)
+	{
+	case 400: return "tri"; // CopyLogical
+	case 401: case 402: case 403: return "trii"; // PtrEqual, PtrNotEqual, PtrDiff
+	case 4416: return ""; // TerminateInvocation
+	case 4433: return "trilI"; // ExtInstWithForwardRefsKHR
+	case 4445: case 5337: return "I"; // TraceRayKHR, TraceNV
+	case 4446: case 5344: return "ii"; // ExecuteCallableKHR, ExecuteCallableNV
+	case 4447: return "tri"; // ConvertUToAccelerationStructureKHR
+	case 4448: case 4449: case 5335: case 5336: return ""; // IgnoreIntersectionKHR, TerminateRayKHR, IgnoreIntersectionNV, TerminateRayNV
+	case 5334: return "trii"; // ReportIntersectionKHR
+	case 5341: return "r"; // TypeAccelerationStructureKHR
+	case 5358: return "rI"; // TypeCooperativeMatrixNV
+	case 5380: return ""; // DemoteToHelperInvocation
+	case 5381: return "tr"; // IsHelperInvocationEXT
+	}
+	return NULL;
+}
+
+struct smolv_CanonicalState
+{
+	std::vector<uint32_t> remap; // old ID -> new ID (zero if not assigned yet)
+	std::vector<uint32_t> types; // ID -> its type ID
+	std::vector<uint8_t> literalWords; // integer type ID -> word count of its literals (for OpSwitch)
+	std::vector<uint8_t> extInstSets; // ExtInstImport IDs of instruction sets with only ID operands
+	std::vector<uint32_t> ids; // positions of IDs in current instruction
+};
+
+// Finds positions of the result ID and other IDs (type ID first, if there is one) in the instruction;
+// returns false if the instruction does not match its layout, or the layout is not known.
+static bool smolv_GetIdPositions(smolv_CanonicalState& state, const uint32_t* words, uint32_t len, uint32_t& outResult, bool& outHasType)
+{
+	const char* layout = smolv_GetIdLayout(words[0] & 0xFFFF);
+	if (!layout)
+		return false;
+	const uint32_t bound = (uint32_t)state.remap.size();
+	state.ids.clear();
+	outResult = 0;
+	outHasType = layout[0] == 't';
+	uint32_t pos = 1;
+	const char* l = layout;
+	while (*l)
+	{
+		switch (*l++)
+		{
+		case 't': case 'i':
+			if (pos >= len)
+				return false;
+			state.ids.push_back(pos++);
+			break;
+		case 'r':
+			if (pos >= len)
+				return false;
+			outResult = pos++;
+			break;
+		case 'o':
+			if (pos < len)
+				state.ids.push_back(pos++);
+			break;
+		case 'l':
+			if (pos >= len)
+				return false;
+			pos++;
+			break;
+		case 's':
+			for (;;)
+			{
+				if (pos >= len)
+					return false;
+				const uint32_t w = words[pos++];
+				if (!(w & 0xFF) || !(w & 0xFF00) || !(w & 0xFF0000) || !(w & 0xFF000000))
+					break;
+			}
+			break;
+		case 'I':
+			while (pos < len)
+				state.ids.push_back(pos++);
+			break;
+		case 'L':
+			pos = len;
+			break;
+		case 'A':
+			if (pos < len)
+			{
+				const uint32_t mask = words[pos++];
+				if (mask & ~0x3Fu)
+					return false; // unknown memory access bits, might have more operands
+				if (mask & 0x2) // Aligned
+				{
+					if (pos >= len)
+						return false;
+					pos++;
+				}
+				for (uint32_t bit = 0x8; bit <= 0x10; bit <<= 1) // MakePointerAvailable, MakePointerVisible
+				{
+					if (!(mask & bit))
+						continue;
+					if (pos >= len)
+						return false;
+					state.ids.push_back(pos++);
+				}
+			}
+			break;
+		case 'M':
+			if (pos < len)
+			{
+				pos++;
+				while (pos < len)
+					state.ids.push_back(pos++);
+			}
+			break;
+		case 'W':
+			{
+				// literal size depends on the selector type
+				const uint32_t selector = words[pos - 2];
+				if (selector >= bound || state.types[selector] >= bound)
+					return false;
+				const uint32_t literalWords = state.literalWords[state.types[selector]];
+				if (literalWords == 0)
+					return false;
+				while (pos < len)
+				{
+					pos += literalWords;
+					if (pos >= len)
+						return false;
+					state.ids.push_back(pos++);
+				}
+			}
+			break;
+		case 'G':
+			while (pos < len)
+			{
+				state.ids.push_back(pos++);
+				if (pos >= len)
+					return false;
+				pos++;
+			}
+			break;
+		case 'X':
+			{
+				if (pos >= len)
+					return false;
+				const uint32_t specOp = words[pos++];
+				// continue with the rest of the operation operands
+				if (specOp == SpvOpVectorShuffle || specOp == SpvOpCompositeInsert)
+					l = "iiL";
+				else if (specOp == SpvOpCompositeExtract)
+					l = "iL";
+				else
+					l = "I";
+			}
+			break;
+		}
+	}
+	return pos == len;
+}
+
+static bool smolv_CanonicalIdsPass(smolv_CanonicalState& state, const uint32_t* words, const uint32_t* wordsEnd, int pass, bool stripDebugInfo, smolv::StripOpNameFilterFunc stripFilter, uint32_t& nextId, uint32_t* out)
+{
+	const int knownOpsCount = smolv_GetKnownOpsCount(kSmolCurrEncodingVersion);
+	const uint32_t bound = (uint32_t)state.remap.size();
+	uint32_t* const outBegin = out;
+	const uint32_t* const wordsBegin = words;
+	smolv_StripState strip;
+	while (words < wordsEnd)
+	{
+		_SMOLV_READ_OP(instrLen, words, op);
+		const bool stripped = stripDebugInfo && smolv_IsStripped(strip, words, op, knownOpsCount, stripFilter);
+		uint32_t result;
+		bool hasType;
+		if (!smolv_GetIdPositions(state, words, instrLen, result, hasType))
+			return false;
+		if (result && words[result] >= bound)
+			return false;
+
+		if (pass == 0 && !stripped && result)
+		{
+			// result IDs of instructions that are kept, in order
+			const uint32_t id = words[result];
+			if (state.remap[id])
+				return false; // defined twice
+			state.remap[id] = nextId++;
+			if (hasType)
+				state.types[id] = words[1];
+			if (op == SpvOpTypeInt && instrLen >= 3)
+				state.literalWords[id] = words[2] > 32 ? 2 : 1;
+			if (op == SpvOpExtInstImport)
+			{
+				const char* name = (const char*)&words[2];
+				const size_t nameSize = (instrLen - 2) * 4;
+				state.extInstSets[id] = (strncmp(name, "GLSL.std.450", nameSize) == 0 || strncmp(name, "NonSemantic.", std::min<size_t>(nameSize, 12)) == 0) ? 1 : 0;
+			}
+		}
+		if (pass == 1 && stripped && result)
+		{
+			// then the ones that get stripped, so that the numbering does not depend on them
+			if (state.remap[words[result]])
+				return false;
+			state.remap[words[result]] = nextId++;
+		}
+		if (pass == 2)
+		{
+			// extended instruction sets that might have literal operands are not known (unless those get stripped)
+			if (!stripped && (op == SpvOpExtInst || op == 4433) && (instrLen < 4 || words[3] >= bound || !state.extInstSets[words[3]]))
+				return false;
+			memcpy(out, words, instrLen * 4);
+			if (result)
+				out[result] = state.remap[words[result]];
+			for (size_t i = 0; i < state.ids.size(); ++i)
+			{
+				const uint32_t id = words[state.ids[i]];
+				if (id >= bound)
+					return false;
+				if (!state.remap[id])
+					state.remap[id] = nextId++; // used but never defined
+				out[state.ids[i]] = state.remap[id];
+			}
+			out += instrLen;
+		}
+		words += instrLen;
+	}
+	return pass != 2 || size_t(out - outBegin) == size_t(wordsEnd - wordsBegin);
+}
+
+// Writes the program with canonical ID numbering into outWords; returns false if that could not be done
+// (unknown ops, extended instruction sets etc.), the program should be encoded as is then.
+static bool smolv_CanonicalizeIds(const uint32_t* words, size_t wordCount, bool stripDebugInfo, smolv::StripOpNameFilterFunc stripFilter, std::vector<uint32_t>& outWords)
+{
+	const uint32_t bound = words[3];
+	if (bound > (1 << 22))
+		return false; // don't allocate huge tables for programs that are not likely valid
+	smolv_CanonicalState state;
+	state.remap.resize(bound, 0);
+	state.types.resize(bound, 0);
+	state.literalWords.resize(bound, 0);
+	state.extInstSets.resize(bound, 0);
+	outWords.resize(wordCount);
+	memcpy(outWords.data(), words, 5 * 4);
+	uint32_t nextId = 1;
+	for (int pass = 0; pass < 3; ++pass)
+	{
+		if (!smolv_CanonicalIdsPass(state, words + 5, words + wordCount, pass, stripDebugInfo, stripFilter, nextId, outWords.data() + 5))
+			return false;
+	}
+	outWords[3] = nextId; // new ID bound
+	return true;
+}
+
+
+// Encodes all instructions (SPIR-V words past the header); outStrippedWordCount gets how many words of
+// debug info were stripped. If restarts is given, places restart points into the instructions.
+template<typename Output>
+static bool smolv_EncodeInstructions(const uint32_t* words, const uint32_t* wordsEnd, int encodingVersion, uint32_t flags, smolv::StripOpNameFilterFunc stripFilter, const smolv::Dictionary* dictionary, Output& out, size_t& outStrippedWordCount, smolv_EncodeRestartPoints* restarts = NULL)
+{
+	outStrippedWordCount = 0;
+	const bool stripDebugInfo = (flags & smolv::kEncodeFlagStripDebugInfo) != 0;
+
+	const int knownOpsCount = smolv_GetKnownOpsCount(encodingVersion);
+	smolv_EncodeState state;
+	smolv_RestartState(state);
+	state.opTable = &smolv_GetOpTables(encodingVersion).encode;
+	const uint32_t* const wordsBegin = words;
+	size_t blockBegin = 0; // SPIR-V offset (past the header) where the current restart block begins
+	smolv_StripState strip;
+
+	while (words < wordsEnd)
+	{
+		_SMOLV_READ_OP(instrLen, words, op);
+
+		if (stripDebugInfo && smolv_IsStripped(strip, words, op, knownOpsCount, stripFilter))
+		{
+			outStrippedWordCount += instrLen;
+			words += instrLen;
+			continue;
+		}
+
+		if (restarts)
+		{
+			const size_t spirvPos = ((words - wordsBegin) - outStrippedWordCount) * 4;
+			if (spirvPos - blockBegin >= restarts->interval)
+			{
+				restarts->points.push_back((uint32_t)(out.Get(kSmolvStreamOps) - restarts->instructionsBegin));
+				restarts->points.push_back((uint32_t)(20 + spirvPos));
+				smolv_RestartState(state);
+				blockBegin = spirvPos;
+			}
+		}
+
+		if (dictionary)
+		{
+			if (op == SpvOpDictionaryRef)
+				return false; // can not be encoded when dictionary is used
+			if (smolv_EncodeDictionaryRef(*dictionary, state, words, wordsEnd, stripDebugInfo ? &strip : NULL, out))
+				continue;
+		}
+
+		if (!smolv_EncodeInstruction(state, words, wordsEnd, instrLen, op, out))
+			return false;
+	}
+	return true;
+}
+
+
+// --------------------------------------------------------------------------------------------
+// Content hash: XXH64 (https://github.com/Cyan4973/xxHash), zero seed. Streaming form, so that
+// decoded output can be hashed in pieces as it gets written.
+
+static const uint64_t kSmolvXXPrime1 = 11400714785074694791ull;
+static const uint64_t kSmolvXXPrime2 = 14029467366897019727ull;
+static const uint64_t kSmolvXXPrime3 = 1609587929392839161ull;
+static const uint64_t kSmolvXXPrime4 = 9650029242287828579ull;
+static const uint64_t kSmolvXXPrime5 = 2870177450012600261ull;
+
+struct smolv_HashState
+{
+	uint64_t acc[4];
+	uint64_t totalSize;
+	uint8_t buffer[32]; // input that did not make a whole 32 byte stripe yet
+	size_t bufferSize;
+};
+
+static uint64_t smolv_Rotl64(uint64_t v, int bits)
+{
+	return (v << bits) | (v >> (64 - bits));
+}
+
+static uint64_t smolv_Get8LE(const uint8_t* p)
+{
+	uint64_t v;
+	memcpy(&v, p, 8);
+	return v;
+}
+
+static uint64_t smolv_XXRound(uint64_t acc, uint64_t input)
+{
+	acc += input * kSmolvXXPrime2;
+	return smolv_Rotl64(acc, 31) * kSmolvXXPrime1;
+}
+
+static uint64_t smolv_XXMergeRound(uint64_t acc, uint64_t val)
+{
+	acc ^= smolv_XXRound(0, val);
+	return acc * kSmolvXXPrime1 + kSmolvXXPrime4;
+}
+
+static void smolv_HashInit(smolv_HashState& h)
+{
+	h.acc[0] = kSmolvXXPrime1 + kSmolvXXPrime2;
+	h.acc[1] = kSmolvXXPrime2;
+	h.acc[2] = 0;
+	h.acc[3] = 0 - kSmolvXXPrime1;
+	h.totalSize = 0;
+	h.bufferSize = 0;
+}
+
+static void smolv_HashUpdate(smolv_HashState& h, const void* data, size_t size)
+{
+	const uint8_t* p = (const uint8_t*)data;
+	const uint8_t* pEnd = p + size;
+	h.totalSize += size;
+	if (h.bufferSize != 0)
+	{
+		const size_t fill = std::min(size, sizeof(h.buffer) - h.bufferSize);
+		memcpy(h.buffer + h.bufferSize, p, fill);
+		h.bufferSize += fill;
+		p += fill;
+		if (h.bufferSize < sizeof(h.buffer))
+			return;
+		for (int i = 0; i < 4; ++i)
+			h.acc[i] = smolv_XXRound(h.acc[i], smolv_Get8LE(h.buffer + i * 8));
+		h.bufferSize = 0;
+	}
+	uint64_t a0 = h.acc[0], a1 = h.acc[1], a2 = h.acc[2], a3 = h.acc[3];
+	for (; pEnd - p >= 32; p += 32)
+	{
+		a0 = smolv_XXRound(a0, smolv_Get8LE(p));
+		a1 = smolv_XXRound(a1, smolv_Get8LE(p + 8));
+		a2 = smolv_XXRound(a2, smolv_Get8LE(p + 16));
+		a3 = smolv_XXRound(a3, smolv_Get8LE(p + 24));
+	}
+	h.acc[0] = a0; h.acc[1] = a1; h.acc[2] = a2; h.acc[3] = a3;
+	if (p != pEnd)
+	{
+		memcpy(h.buffer, p, pEnd - p);
+		h.bufferSize = pEnd - p;
+	}
+}
+
+static uint64_t smolv_HashFinal(const smolv_HashState& h)
+{
+	uint64_t v;
+	if (h.totalSize >= 32)
+	{
+		v = smolv_Rotl64(h.acc[0], 1) + smolv_Rotl64(h.acc[1], 7) + smolv_Rotl64(h.acc[2], 12) + smolv_Rotl64(h.acc[3], 18);
+		for (int i = 0; i < 4; ++i)
+			v = smolv_XXMergeRound(v, h.acc[i]);
+	}
+	else
+		v = kSmolvXXPrime5;
+	v += h.totalSize;
+
+	const uint8_t* p = h.buffer;
+	const uint8_t* pEnd = p + h.bufferSize;
+	for (; pEnd - p >= 8; p += 8)
+		v = smolv_Rotl64(v ^ smolv_XXRound(0, smolv_Get8LE(p)), 27) * kSmolvXXPrime1 + kSmolvXXPrime4;
+	if (pEnd - p >= 4)
+	{
+		uint32_t w;
+		memcpy(&w, p, 4);
+		v = smolv_Rotl64(v ^ (w * kSmolvXXPrime1), 23) * kSmolvXXPrime2 + kSmolvXXPrime3;
+		p += 4;
+	}
+	for (; p < pEnd; ++p)
+		v = smolv_Rotl64(v ^ (*p * kSmolvXXPrime5), 11) * kSmolvXXPrime1;
+
+	v ^= v >> 33;
+	v *= kSmolvXXPrime2;
+	v ^= v >> 29;
+	v *= kSmolvXXPrime3;
+	v ^= v >> 32;
+	return v;
+}
+
+uint64_t smolv::ContentHash(const void* spirvData, size_t spirvSize)
+{
+	smolv_HashState h;
+	smolv_HashInit(h);
+	if (spirvSize != 0)
+		smolv_HashUpdate(h, spirvData, spirvSize);
+	return smolv_HashFinal(h);
+}
+
+bool smolv::GetContentHash(const void* smolvData, size_t smolvSize, uint64_t* outHash)
+{
+	if (!outHash || !smolv_CheckSmolHeader((const uint8_t*)smolvData, smolvSize))
+		return false;
+	return smolv_GetStoredHash((const uint8_t*)smolvData, *outHash);
+}
+
+// Hash of the SPIR-V program that decoding the encoded one will produce: same header, and
+// only the instructions that were not stripped.
+static uint64_t smolv_EncodedContentHash(const uint32_t* words, const uint32_t* wordsEnd, uint32_t flags, smolv::StripOpNameFilterFunc stripFilter)
+{
+	smolv_HashState h;
+	smolv_HashInit(h);
+	const uint32_t header[5] = { words[0], words[1] & 0x00FFFFFF, words[2], words[3], words[4] };
+	smolv_HashUpdate(h, header, sizeof(header));
+	words += 5;
+	const int knownOpsCount = smolv_GetKnownOpsCount(kSmolCurrEncodingVersion);
+	const uint32_t* run = words; // instructions that are kept, not hashed yet
+	smolv_StripState strip;
+	while (words < wordsEnd)
+	{
+		const uint32_t instrLen = words[0] >> 16;
+		if (instrLen < 1 || words + instrLen > wordsEnd)
+			break; // malformed; encoding fails on it anyway
+		if ((flags & smolv::kEncodeFlagStripDebugInfo) && smolv_IsStripped(strip, words, SpvOp(words[0] & 0xFFFF), knownOpsCount, stripFilter))
+		{
+			if (run != words)
+				smolv_HashUpdate(h, run, (words - run) * 4);
+			run = words + instrLen;
+		}
+		words += instrLen;
+	}
+	if (run < words)
+		smolv_HashUpdate(h, run, (words - run) * 4);
+	return smolv_HashFinal(h);
+}
+
+
+size_t smolv::GetEncodeBoundSize(size_t spirvSize)
+{
+	// Worst case each word becomes a 5 byte varint; compact VectorShuffle and MemberDecorate
+	// encodings can add a few more bytes per (at least 4 words long) instruction.
+	return smolv_GetMaxSmolHeaderSize(spirvSize) + (spirvSize / 4) * 7;
+}
+
+
+bool smolv::Encode(const void* spirvData, size_t spirvSize, ByteArray& outSmolv, uint32_t flags, StripOpNameFilterFunc stripFilter, const Dictionary* dictionary, size_t restartInterval)
+{
+	// encode into worst case sized space at the end of the array, then trim it
+	const size_t prevSize = outSmolv.size();
+	outSmolv.resize(prevSize + GetEncodeBoundSize(spirvSize));
+	size_t written = 0;
+	bool ok = Encode(spirvData, spirvSize, outSmolv.data() + prevSize, outSmolv.size() - prevSize, &written, flags, stripFilter, dictionary, restartInterval);
+	outSmolv.resize(prevSize + written);
+	return ok;
+}
+
+
+bool smolv::Encode(const void* spirvData, size_t spirvSize, void* outSmolv, size_t outSmolvSize, size_t* outSmolvWritten, uint32_t flags, StripOpNameFilterFunc stripFilter, const Dictionary* dictionary, size_t restartInterval)
+{
+	if (outSmolvWritten)
+		*outSmolvWritten = 0;
+	const size_t wordCount = spirvSize / 4;
+	if (wordCount * 4 != spirvSize)
+		return false;
+	const uint32_t* words = (const uint32_t*)spirvData;
+	const uint32_t* wordsEnd = words + wordCount;
+	if (!smolv_CheckSpirVHeader(words, wordCount))
+		return false;
+	if (!outSmolv || outSmolvSize < GetEncodeBoundSize(spirvSize))
+		return false;
+
+	// encode a renumbered copy of the program, when that can be done
+	std::vector<uint32_t> canonicalWords;
+	if ((flags & kEncodeFlagCanonicalizeIds) && smolv_CanonicalizeIds(words, wordCount, (flags & kEncodeFlagStripDebugInfo) != 0, stripFilter, canonicalWords))
+	{
+		words = canonicalWords.data();
+		wordsEnd = words + wordCount;
+	}
+
+	// output buffer is large enough for the worst case, so just write into it without any checks
+	uint8_t* const outBegin = (uint8_t*)outSmolv;
+	uint8_t* out = outBegin;
+
+	// SMOL-V features used
+	uint32_t features = 0;
+	if (dictionary)
+		features |= kSmolFeatureDictionary;
+	if (flags & kEncodeFlagSplitStreams)
+		features |= kSmolFeatureSplitStreams;
+	if (flags & kEncodeFlagContentHash)
+		features |= kSmolFeatureContentHash;
+	const int encodingVersion = kSmolCurrEncodingVersion;
+
+	// header (matches SPIR-V one, except different magic)
+	smolv_Write4(out, kSmolHeaderMagic);
+	smolv_Write4(out, (words[1] & 0x00FFFFFF) + (encodingVersion<<24)); // SPIR-V version (_XXX) + SMOL-V version (X___)
+	smolv_Write4(out, words[2]); // generator
+	smolv_Write4(out, words[3]); // bound
+	smolv_Write4(out, words[4]); // schema
+
+	uint8_t* headerSpirvSize = out; // size field may get updated later if stripping is enabled
+	smolv_Write4(out, (uint32_t)spirvSize); // space needed to decode (i.e. original SPIR-V size)
+
+	uint8_t* headerFeatures = out; // entropy coding feature gets added later, if it is used
+	if (encodingVersion >= kSmolFeaturesEncodingVersion)
+	{
+		smolv_Write4(out, features);
+		if (features & kSmolFeatureDictionary)
+			smolv_Write4(out, dictionary->id);
+		if (features & kSmolFeatureContentHash)
+		{
+			const uint64_t hash = smolv_EncodedContentHash(words, wordsEnd, flags, stripFilter);
+			smolv_Write4(out, (uint32_t)hash);
+			smolv_Write4(out, (uint32_t)(hash >> 32));
+		}
+	}
+	uint8_t* headerStreamSizes = out; // filled in once the streams are encoded
+	if (features & kSmolFeatureSplitStreams)
+		out += kSmolvStreamCount * 4;
+	uint8_t* instructionsBegin = out;
+
+	// restart points are not used with split streams; they would need offsets into each stream
+	smolv_EncodeRestartPoints restarts;
+	restarts.interval = std::max(restartInterval, kSmolvMinRestartInterval);
+	restarts.instructionsBegin = instructionsBegin;
+	const bool useRestarts = restartInterval != 0 && !(features & kSmolFeatureSplitStreams);
+
+	smolv_EncodeOutput output = { out };
+	size_t strippedWordCount = 0;
+	if (!smolv_EncodeInstructions(words + 5, wordsEnd, encodingVersion, flags, stripFilter, dictionary, output, strippedWordCount, useRestarts ? &restarts : NULL))
+		return false;
+	out = output.bytes;
+	if (strippedWordCount != 0)
+		smolv_Write4(headerSpirvSize, (uint32_t)(wordCount - strippedWordCount) * 4);
+
+	// Restart points: only known now, move the instructions to make space for them in the header
+	// (buffer is sized to have space for the most restart points possible).
+	if (!restarts.points.empty())
+	{
+		const size_t count = restarts.points.size() / 2;
+		const size_t size = 4 + count * 8;
+		memmove(instructionsBegin + size, instructionsBegin, out - instructionsBegin);
+		features |= kSmolFeatureRestartPoints;
+		uint8_t* header = headerFeatures;
+		smolv_Write4(header, features);
+		header = instructionsBegin;
+		smolv_Write4(header, (uint32_t)count);
+		for (size_t i = 0; i < restarts.points.size(); ++i)
+			smolv_Write4(header, restarts.points[i]);
+		instructionsBegin += size;
+		out += size;
+	}
+
+	// Split streams: encoding into one stream told the total size, none of the separate streams
+	// can be larger than that. Encode again into temporary space for them, and place them one
+	// after another. Output buffer is free until then, use it for dictionary trial encodings.
+	if (features & kSmolFeatureSplitStreams)
+	{
+		const size_t size = out - instructionsBegin;
+		ByteArray streams(size * kSmolvStreamCount);
+		smolv_SplitEncodeOutput splitOutput;
+		for (int i = 0; i < kSmolvStreamCount; ++i)
+			splitOutput.bytes[i] = streams.data() + size * i;
+		splitOutput.scratch = instructionsBegin;
+		if (size != 0 && !smolv_EncodeInstructions(words + 5, wordsEnd, encodingVersion, flags, stripFilter, dictionary, splitOutput, strippedWordCount))
+			return false;
+		out = instructionsBegin;
+		for (int i = 0; i < kSmolvStreamCount; ++i)
+		{
+			const uint8_t* streamBegin = streams.data() + size * i;
+			const size_t streamSize = splitOutput.bytes[i] - streamBegin;
+			smolv_Write4(headerStreamSizes, (uint32_t)streamSize);
+			if (streamSize != 0)
+				memcpy(out, streamBegin, streamSize);
+			out += streamSize;
+		}
+	}
+
+	// Entropy code the instructions, into the space past them (output buffer is worst case sized,
+	// there's almost always enough). Only keep that if it is smaller, including the extra header words.
+	if (flags & kEncodeFlagEntropyCode)
+	{
+		const size_t size = out - instructionsBegin;
+		uint8_t* codedEnd = size > 8 ? std::min(out + (size - 8), outBegin + outSmolvSize) : out;
+		const size_t codedSize = smolv_EntropyEncode(instructionsBegin, size, out, codedEnd);
+		if (codedSize != 0 && codedSize + 8 < size)
+		{
+			smolv_Write4(headerFeatures, features | kSmolFeatureEntropyCoded);
+			memmove(instructionsBegin + 8, out, codedSize);
+			out = instructionsBegin;
+			smolv_Write4(out, (uint32_t)size); // header: size before and after entropy coding
+			smolv_Write4(out, (uint32_t)codedSize);
+			out += codedSize;
+		}
+	}
+
+	if (outSmolvWritten)
+		*outSmolvWritten = out - outBegin;
+	return true;
+}
+
+
+size_t smolv::GetDecodedBufferSize(const void* smolvData, size_t smolvSize)
+{
+	if (!smolv_CheckSmolHeader((const uint8_t*)smolvData, smolvSize))
+		return 0;
+	const uint32_t* words = (const uint32_t*)smolvData;
+	return words[5];
+}
+
+
+// Decoding state that is carried over from one instruction to the next
+struct smolv_DecodeState
+{
+	uint32_t prevResult;
+	uint32_t prevDecorate;
+	uint32_t prevExtInstSet;
+	smolv_NumericTypes numericTypes;
+	const smolv_OpTable* opTable; // decoding table for the SMOL-V version
+	const smolv_OpTable* spirvOpTable; // same, indexed by SPIR-V op
+	const smolv::Dictionary* dictionary; // if data was encoded with a dictionary
+	bool beforeZeroVersion;
+};
+
+enum smolv_DecodeResult
+{
+	kSmolvDecodeOk,
+	kSmolvDecodeNeedInput, // input ended in the middle of the instruction
+	kSmolvDecodeNeedOutput, // not enough output space for the instruction
+	kSmolvDecodeError, // malformed input
+};
+
+// Checks SMOL-V header and writes out SPIR-V header (20 bytes) for it.
+static bool smolv_DecodeHeader(const uint8_t* bytes, size_t byteCount, uint32_t flags, const smolv::Dictionary* dictionary, uint8_t*& outSpirv, smolv_DecodeState& outState)
+{
+	if (!smolv_CheckSmolHeader(bytes, byteCount))
+		return false;
+	const uint8_t* bytesEnd = bytes + byteCount;
+	uint32_t val;
+	int smolVersion = 0;
+	smolv_Write4(outSpirv, kSpirVHeaderMagic); bytes += 4;
+	smolv_Read4(bytes, bytesEnd, val); smolVersion = val >> 24; val &= 0x00FFFFFF; smolv_Write4(outSpirv, val); // version
+	smolv_Read4(bytes, bytesEnd, val); smolv_Write4(outSpirv, val); // generator
+	smolv_Read4(bytes, bytesEnd, val); smolv_Write4(outSpirv, val); // bound
+	smolv_Read4(bytes, bytesEnd, val); smolv_Write4(outSpirv, val); // schema
+	// decode buffer size is the next header word; not needed here
+	bytes += 4;
+
+	outState.dictionary = NULL;
+	if (smolVersion >= kSmolFeaturesEncodingVersion)
+	{
+		uint32_t features = 0;
+		if (!smolv_Read4(bytes, bytesEnd, features))
+			return false;
+		if (features & kSmolFeatureDictionary)
+		{
+			// needs the same dictionary that was used for encoding
+			if (!smolv_Read4(bytes, bytesEnd, val))
+				return false;
+			if (!dictionary || dictionary->id != val)
+				return false;
+			outState.dictionary = dictionary;
+		}
+	}
+
+	// there are two SMOL-V encoding versions, both not indicating anything in their header version field:
+	// one that is called "before zero" here (2016-08-31 code). Support decoding that one only by presence
+	// of this special flag.
+	outState.beforeZeroVersion = smolVersion == 0 && (flags & smolv::kDecodeFlagUse20160831AsZeroVersion) != 0;
+	outState.opTable = &smolv_GetOpTables(smolVersion).decode;
+	outState.spirvOpTable = &smolv_GetOpTables(smolVersion).encode;
+	outState.prevResult = 0;
+	outState.prevDecorate = 0;
+	outState.prevExtInstSet = 0;
+	outState.numericTypes.count = 0;
+	return true;
+}
+
+// Copies instructions referenced from the dictionary. Rarely used, keep it out of the main decoding loop.
+template<typename Input>
+_SMOLV_NO_INLINE static smolv_DecodeResult smolv_DecodeDictionaryRef(smolv_DecodeState& state, uint32_t count, Input& in, uint8_t*& outSpirv, const uint8_t* outSpirvEnd)
+{
+	uint32_t start;
+	if (!in.ReadVarint(kSmolvStreamVarRest, start))
+		return kSmolvDecodeNeedInput;
+	const smolv::Dictionary& dict = *state.dictionary;
+	const uint32_t instrCount = (uint32_t)dict.instrOffsets.size() - 1;
+	if (start >= instrCount || count > instrCount - start)
+		return kSmolvDecodeError;
+	const uint32_t* words = dict.words.data() + dict.instrOffsets[start];
+	const uint32_t* wordsEnd = dict.words.data() + dict.instrOffsets[start + count];
+	const size_t size = (wordsEnd - words) * 4;
+	if (size_t(outSpirvEnd - outSpirv) < size)
+		return kSmolvDecodeNeedOutput;
+	memcpy(outSpirv, words, size);
+	outSpirv += size;
+	for (; words < wordsEnd; words += words[0] >> 16)
+		smolv_UpdateStateFromInstruction(state.spirvOpTable, words, state.prevResult, state.prevDecorate, state.prevExtInstSet, state.numericTypes);
+	return kSmolvDecodeOk;
+}
+
+// See smolv_EncodeExtInst. Instruction length and output space are already checked.
+template<typename Input>
+_SMOLV_FORCE_INLINE static smolv_DecodeResult smolv_DecodeExtInst(smolv_DecodeState& state, bool newSet, uint32_t instrLen, Input& in, uint8_t*& outSpirv)
+{
+	if (instrLen < 5)
+		return kSmolvDecodeError;
+	uint32_t type, result, inst;
+	if (!in.ReadVarint(kSmolvStreamOps, type)) return kSmolvDecodeNeedInput;
+	if (!in.ReadVarint(kSmolvStreamIds, result)) return kSmolvDecodeNeedInput;
+	if (newSet && !in.ReadVarint(kSmolvStreamVarRest, state.prevExtInstSet)) return kSmolvDecodeNeedInput;
+	if (!in.ReadVarint(kSmolvStreamVarRest, inst)) return kSmolvDecodeNeedInput;
+	result = state.prevResult + smolv_ZigDecode(result);
+	state.prevResult = result;
+	smolv_Write4(outSpirv, (instrLen << 16) | SpvOpExtInst);
+	smolv_Write4(outSpirv, type);
+	smolv_Write4(outSpirv, result);
+	smolv_Write4(outSpirv, state.prevExtInstSet);
+	smolv_Write4(outSpirv, inst);
+	for (uint32_t i = 5; i < instrLen; ++i)
+	{
+		uint32_t val;
+		if (!in.ReadVarint(kSmolvStreamIds, val)) return kSmolvDecodeNeedInput;
+		smolv_Write4(outSpirv, result - smolv_ZigDecode(val));
+	}
+	return kSmolvDecodeOk;
+}
+
+// See smolv_EncodeConstant. Instruction length and output space are already checked.
+template<typename Input>
+_SMOLV_NO_INLINE static smolv_DecodeResult smolv_DecodeConstant(smolv_DecodeState& state, uint32_t instrLen, Input& in, uint8_t*& outSpirv)
+{
+	uint32_t type, result, lo, hi = 0;
+	if (!in.ReadVarint(kSmolvStreamOps, type)) return kSmolvDecodeNeedInput;
+	if (!in.ReadVarint(kSmolvStreamIds, result)) return kSmolvDecodeNeedInput;
+	if (!in.ReadVarint(kSmolvStreamVarRest, lo)) return kSmolvDecodeNeedInput;
+	const int kind = smolv_FindNumericType(state.numericTypes, type);
+	const uint32_t literalWords = (kind == kSmolvTypeInt64 || kind == kSmolvTypeFloat64) ? 2 : 1;
+	if (kind == kSmolvTypeUnknown || instrLen != 3 + literalWords)
+		return kSmolvDecodeError;
+	if (literalWords == 2 && !in.ReadVarint(kSmolvStreamVarRest, hi)) return kSmolvDecodeNeedInput;
+	result = state.prevResult + smolv_ZigDecode(result);
+	state.prevResult = result;
+	smolv_Write4(outSpirv, (instrLen << 16) | SpvOpConstant);
+	smolv_Write4(outSpirv, type);
+	smolv_Write4(outSpirv, result);
+	switch (kind)
+	{
+	case kSmolvTypeInt:
+		smolv_Write4(outSpirv, smolv_ZigDecode(lo));
+		break;
+	case kSmolvTypeInt64:
+	{
+		const uint64_t zig = lo | (uint64_t(hi) << 32);
+		const uint64_t v = (zig >> 1) ^ (0 - (zig & 1));
+		smolv_Write4(outSpirv, uint32_t(v));
+		smolv_Write4(outSpirv, uint32_t(v >> 32));
+		break;
+	}
+	case kSmolvTypeFloat:
+		smolv_Write4(outSpirv, smolv_TokenToFloat(lo, 23, 8));
+		break;
+	case kSmolvTypeFloat64:
+		smolv_Write4(outSpirv, smolv_ReverseBits(lo));
+		smolv_Write4(outSpirv, smolv_TokenToFloat(hi, 20, 11));
+		break;
+	}
+	return kSmolvDecodeOk;
+}
+
+// TypeInt & TypeFloat: regular encoding (result ID, varint literals), but they also need to be remembered.
+template<typename Input>
+_SMOLV_NO_INLINE static smolv_DecodeResult smolv_DecodeNumericType(smolv_DecodeState& state, SpvOp op, uint32_t instrLen, Input& in, uint8_t*& outSpirv)
+{
+	if (instrLen < 2)
+		return kSmolvDecodeError;
+	uint32_t words[3] = { (instrLen << 16) | op, 0, 0 };
+	uint32_t val;
+	if (!in.ReadVarint(kSmolvStreamIds, val)) return kSmolvDecodeNeedInput;
+	words[1] = state.prevResult + smolv_ZigDecode(val);
+	state.prevResult = words[1];
+	smolv_Write4(outSpirv, words[0]);
+	smolv_Write4(outSpirv, words[1]);
+	for (uint32_t i = 2; i < instrLen; ++i)
+	{
+		if (!in.ReadVarint(kSmolvStreamVarRest, val)) return kSmolvDecodeNeedInput;
+		smolv_Write4(outSpirv, val);
+		if (i == 2)
+			words[2] = val;
+	}
+	smolv_AddNumericType(state.numericTypes, words, instrLen);
+	return kSmolvDecodeOk;
+}
+
+// Decodes one SMOL-V instruction (or a run of MemberDecorate instructions that were encoded as one).
+// On anything else than kSmolvDecodeOk, the input/output pointers and the state are left partially
+// updated; callers that want to retry need to restore them.
+// "Before zero" version and dictionary support are template parameters, so that decoding of the
+// current version does not have any per-instruction checks for them; smolv_DecodeInstructionAny
+// picks the right one at runtime.
+template<bool kBeforeZeroVersion, bool kAllowDictionary, typename Input>
+_SMOLV_FORCE_INLINE static smolv_DecodeResult smolv_DecodeInstruction(smolv_DecodeState& state, Input& in, uint8_t*& outSpirv, const uint8_t* outSpirvEnd)
+{
+	uint32_t val;
+
+	// read length + opcode
+	uint32_t instrLen;
+	SpvOp op;
+	smolv_OpDesc desc;
+	if (!in.ReadVarint(kSmolvStreamOps, val))
+		return kSmolvDecodeNeedInput;
+	smolv_UnpackLengthOp(val, state.opTable, instrLen, op, desc);
+	if (kAllowDictionary && op == SpvOpDictionaryRef && state.dictionary)
+		return smolv_DecodeDictionaryRef(state, instrLen, in, outSpirv, outSpirvEnd);
+	if (instrLen > 0xFFFF)
+		return kSmolvDecodeError; // SPIR-V instruction length is 16 bits
+	if (size_t(outSpirvEnd - outSpirv) < instrLen * 4)
+		return kSmolvDecodeNeedOutput;
+	if (desc.flags & (kSmolvOpExtInst | kSmolvOpConstant | kSmolvOpNumericType))
+	{
+		if (desc.flags & kSmolvOpExtInst)
+			return smolv_DecodeExtInst(state, op == SpvOpExtInstWithSet, instrLen, in, outSpirv);
+		// pass copies of the pointers to non-inlined functions; if the actual ones had their
+		// address taken, the compiler would have to reload them after every output write
+		Input i = in;
+		uint8_t* o = outSpirv;
+		const smolv_DecodeResult res = (desc.flags & kSmolvOpConstant) ?
+			smolv_DecodeConstant(state, instrLen, i, o) :
+			smolv_DecodeNumericType(state, op, instrLen, i, o);
+		in = i;
+		outSpirv = o;
+		return res;
+	}
+	const bool wasSwizzle = (op == SpvOpVectorShuffleCompact);
+	if (wasSwizzle)
+		op = SpvOpVectorShuffle;
+	smolv_Write4(outSpirv, (instrLen << 16) | op);
+
+	size_t ioffs = 1;
+
+	// read type as varint, if we have it
+	if (desc.flags & kSmolvOpHasType)
+	{
+		if (ioffs >= instrLen) return kSmolvDecodeError;
+		if (!in.ReadVarint(kSmolvStreamOps, val)) return kSmolvDecodeNeedInput;
+		smolv_Write4(outSpirv, val);
+		ioffs++;
+	}
+	// read result as delta+varint, if we have it
+	if (desc.flags & kSmolvOpHasResult)
+	{
+		if (ioffs >= instrLen) return kSmolvDecodeError;
+		if (!in.ReadVarint(kSmolvStreamIds, val)) return kSmolvDecodeNeedInput;
+		val = state.prevResult + smolv_ZigDecode(val);
+		smolv_Write4(outSpirv, val);
+		state.prevResult = val;
+		ioffs++;
+	}
+	
+	// Decorate: IDs relative to previous decorate
+	if (desc.flags & kSmolvOpRelativeToDecorate)
+	{
+		if (ioffs >= instrLen) return kSmolvDecodeError;
+		if (!in.ReadVarint(kSmolvStreamIds, val)) return kSmolvDecodeNeedInput;
+		// "before zero" version did not use zig encoding for the value
+		val = state.prevDecorate + (kBeforeZeroVersion ? val : smolv_ZigDecode(val));
+		smolv_Write4(outSpirv, val);
+		state.prevDecorate = val;
+		ioffs++;
+	}
+
+	// MemberDecorate special decoding
+	if (op == SpvOpMemberDecorate && !kBeforeZeroVersion)
+	{
+		uint32_t count;
+		if (!in.ReadByte(kSmolvStreamOps, count))
+			return kSmolvDecodeNeedInput;
+		int prevIndex = 0;
+		int prevOffset = 0;
+		for (uint32_t m = 0; m < count; ++m)
+		{
+			// read member index
+			uint32_t memberIndex;
+			if (!in.ReadVarint(kSmolvStreamVarRest, memberIndex)) return kSmolvDecodeNeedInput;
+			memberIndex += prevIndex;
+			prevIndex = memberIndex;
+			
+			// decoration (and length if not common/known)
+			uint32_t memberDec;
+			if (!in.ReadVarint(kSmolvStreamVarRest, memberDec)) return kSmolvDecodeNeedInput;
+			const int knownExtraOps = smolv_DecorationExtraOps(memberDec);
+			uint32_t memberLen;
+			if (knownExtraOps == -1)
+			{
+				if (!in.ReadVarint(kSmolvStreamVarRest, memberLen)) return kSmolvDecodeNeedInput;
+				memberLen += 4;
+			}
+			else
+				memberLen = 4 + knownExtraOps;
+			if (memberLen > 0xFFFF)
+				return kSmolvDecodeError;
+
+			// write SPIR-V op+length (unless it's first member decoration, in which case it was written before)
+			if (m != 0)
+			{
+				if (size_t(outSpirvEnd - outSpirv) < memberLen * 4)
+					return kSmolvDecodeNeedOutput;
+				smolv_Write4(outSpirv, (memberLen << 16) | op);
+				smolv_Write4(outSpirv, state.prevDecorate);
+			}
+			else if (size_t(outSpirvEnd - outSpirv) < (memberLen - 2) * 4)
+				return kSmolvDecodeNeedOutput;
+			smolv_Write4(outSpirv, memberIndex);
+			smolv_Write4(outSpirv, memberDec);
+			// Special case for Offset decorations
+			if (memberDec == 35) // Offset
+			{
+				if (memberLen != 5)
+					return kSmolvDecodeError;
+				if (!in.ReadVarint(kSmolvStreamVarRest, val)) return kSmolvDecodeNeedInput;
+				val += prevOffset;
+				smolv_Write4(outSpirv, val);
+				prevOffset = val;
+			}
+			else
+			{
+				for (uint32_t i = 4; i < memberLen; ++i)
+				{
+					if (!in.ReadVarint(kSmolvStreamVarRest, val)) return kSmolvDecodeNeedInput;
+					smolv_Write4(outSpirv, val);
+				}
+			}
+		}
+		return kSmolvDecodeOk;
+	}
+
+	// Read this many IDs, that are relative to result ID
+	int relativeCount = desc.deltaFromResult;
+	// "before zero" version only used zig encoding for IDs of several ops; after
+	// that ops got zig encoding for their IDs
+	bool zigDecodeVals = true;
+	if (kBeforeZeroVersion)
+	{
+		if (op != SpvOpControlBarrier && op != SpvOpMemoryBarrier && op != SpvOpLoopMerge && op != SpvOpSelectionMerge && op != SpvOpBranch && op != SpvOpBranchConditional && op != SpvOpMemoryNamedBarrier)
+			zigDecodeVals = false;
+	}
+	for (int i = 0; i < relativeCount && ioffs < instrLen; ++i, ++ioffs)
+	{
+		if (!in.ReadVarint(kSmolvStreamIds, val)) return kSmolvDecodeNeedInput;
+		if (zigDecodeVals)
+			val = smolv_ZigDecode(val);
+		smolv_Write4(outSpirv, state.prevResult - val);
+	}
+
+	if (wasSwizzle && instrLen <= 9)
+	{
+		uint32_t swizzle;
+		if (!in.ReadByte(kSmolvStreamOps, swizzle))
+			return kSmolvDecodeNeedInput;
+		if (instrLen > 5) smolv_Write4(outSpirv, (swizzle >> 6) & 3);
+		if (instrLen > 6) smolv_Write4(outSpirv, (swizzle >> 4) & 3);
+		if (instrLen > 7) smolv_Write4(outSpirv, (swizzle >> 2) & 3);
+		if (instrLen > 8) smolv_Write4(outSpirv, swizzle & 3);
+	}
+	else if (desc.flags & kSmolvOpVarRest)
+	{
+		// read rest of words with variable encoding
+		for (; ioffs < instrLen; ++ioffs)
+		{
+			if (!in.ReadVarint(kSmolvStreamVarRest, val)) return kSmolvDecodeNeedInput;
+			smolv_Write4(outSpirv, val);
+		}
+	}
+	else
+	{
+		// read rest of words without any encoding
+		for (; ioffs < instrLen; ++ioffs)
+		{
+			if (!in.Read4(kSmolvStreamLiterals, val)) return kSmolvDecodeNeedInput;
+			smolv_Write4(outSpirv, val);
+		}
+	}
+	return kSmolvDecodeOk;
+}
+
+
+template<typename Input>
+static smolv_DecodeResult smolv_DecodeInstructionAny(smolv_DecodeState& state, Input& in, uint8_t*& outSpirv, const uint8_t* outSpirvEnd)
+{
+	if (state.beforeZeroVersion)
+		return smolv_DecodeInstruction<true, false>(state, in, outSpirv, outSpirvEnd);
+	return smolv_DecodeInstruction<false, true>(state, in, outSpirv, outSpirvEnd);
+}
+
+template<bool kBeforeZeroVersion, bool kAllowDictionary, typename Input>
+static bool smolv_DecodeInstructions(smolv_DecodeState& state, Input in, uint8_t*& outSpirv, const uint8_t* outSpirvEnd)
+{
+	while (!in.AtEnd())
+	{
+		if (smolv_DecodeInstruction<kBeforeZeroVersion, kAllowDictionary>(state, in, outSpirv, outSpirvEnd) != kSmolvDecodeOk)
+			return false;
+	}
+	return in.AllRead();
+}
+
+// Decodes all the instructions of a block (whole program, if it has no restart points), which have
+// to decode into exactly outSpirv..outSpirvEnd. Picks the decoding loop once; "before zero" version
+// can not have a dictionary, split streams or restart points.
+template<typename Input>
+static bool smolv_DecodeBlock(smolv_DecodeState& state, Input in, uint8_t* outSpirv, const uint8_t* outSpirvEnd)
+{
+	bool ok;
+	if (state.beforeZeroVersion)
+		ok = smolv_DecodeInstructions<true, false>(state, in, outSpirv, outSpirvEnd);
+	else if (state.dictionary)
+		ok = smolv_DecodeInstructions<false, true>(state, in, outSpirv, outSpirvEnd);
+	else
+		ok = smolv_DecodeInstructions<false, false>(state, in, outSpirv, outSpirvEnd);
+	return ok && outSpirv == outSpirvEnd;
+}
+
+// Blocks of instructions between restart points, each decoded on its own (possibly on multiple threads)
+struct smolv_DecodeBlocksData
+{
+	smolv_DecodeState state; // state at start of each block
+	const uint8_t* bytes; // encoded instructions
+	size_t size;
+	uint8_t* spirv; // decoded SPIR-V, including the header
+	size_t spirvSize;
+	const uint32_t* restartPoints;
+	uint32_t restartCount;
+	bool trusted; // kDecodeFlagTrusted
+	std::atomic<bool> failed;
+};
+
+static void smolv_DecodeBlockTask(void* taskData, size_t index)
+{
+	smolv_DecodeBlocksData* data = (smolv_DecodeBlocksData*)taskData;
+	const uint32_t* points = data->restartPoints;
+	const size_t inBegin = index == 0 ? 0 : points[index * 2 - 2];
+	const size_t outBegin = index == 0 ? 20 : points[index * 2 - 1];
+	const size_t inEnd = index == data->restartCount ? data->size : points[index * 2];
+	const size_t outEnd = index == data->restartCount ? data->spirvSize : points[index * 2 + 1];
+	smolv_DecodeState state = data->state;
+	bool ok;
+	if (data->trusted)
+	{
+		smolv_TrustedDecodeInput in = { data->bytes + inBegin, data->bytes + inEnd };
+		ok = smolv_DecodeBlock(state, in, data->spirv + outBegin, data->spirv + outEnd);
+	}
+	else
+	{
+		smolv_DecodeInput in = { data->bytes + inBegin, data->bytes + inEnd };
+		ok = smolv_DecodeBlock(state, in, data->spirv + outBegin, data->spirv + outEnd);
+	}
+	if (!ok)
+		data->failed = true;
+}
+
+static void smolv_RunParallel(size_t count, smolv::ParallelTaskFunc task, void* taskData, int threadCount, smolv::ParallelForFunc parallelFor, void* parallelForUserData);
+
+static bool smolv_DecodeData(const void* smolvData, size_t smolvSize, void* spirvOutputBuffer, size_t spirvOutputBufferSize, uint32_t flags, const smolv::Dictionary* dictionary,
+	bool parallel, int threadCount, smolv::ParallelForFunc parallelFor, void* parallelForUserData)
 {
 	// check header, and whether we have enough output buffer space
-	const size_t neededBufferSize = GetDecodedBufferSize(smolvData, smolvSize);
+	const size_t neededBufferSize = smolv::GetDecodedBufferSize(smolvData, smolvSize);
 	if (neededBufferSize == 0)
 		return false; // invalid SMOL-V
 	if (spirvOutputBufferSize < neededBufferSize)
@@ -1615,197 +4531,1818 @@ bool smolv::Decode(const void* smolvData, size_t smolvSize, void* spirvOutputBuf
 	if (spirvOutputBuffer == NULL)
 		return false; // output buffer is null
 
-	const uint8_t* bytes = (const uint8_t*)smolvData;
-	const uint8_t* bytesEnd = bytes + smolvSize;
+	const uint8_t* bytes = (const uint8_t*)smolvData;
+	const uint8_t* bytesEnd = bytes + smolvSize;
+
+	uint8_t* outSpirv = (uint8_t*)spirvOutputBuffer;
+	const uint8_t* outSpirvEnd = outSpirv + neededBufferSize;
+
+	smolv_DecodeState state;
+	if (!smolv_DecodeHeader(bytes, smolvSize, flags, dictionary, outSpirv, state))
+		return false;
+	const size_t headerSize = smolv_GetSmolHeaderSize(bytes, smolvSize);
+	bytes += headerSize;
+	smolv::ByteArray entropyDecoded;
+	if (!smolv_EntropyDecodeInstructions((const uint8_t*)smolvData, bytes, bytesEnd, entropyDecoded))
+		return false;
+
+	uint32_t streamSizes[kSmolvStreamCount];
+	if (smolv_IsSplitStreams((const uint8_t*)smolvData, headerSize, streamSizes))
+	{
+		smolv_SplitDecodeInput in;
+		if (!smolv_SplitStreams(streamSizes, bytes, bytesEnd, in))
+			return false;
+		return smolv_DecodeBlock(state, in, outSpirv, outSpirvEnd);
+	}
+
+	const uint32_t* restartPoints;
+	const uint32_t restartCount = smolv_GetRestartPoints((const uint8_t*)smolvData, restartPoints);
+	const bool trusted = (flags & smolv::kDecodeFlagTrusted) != 0;
+	if (restartCount == 0)
+	{
+		if (trusted)
+		{
+			smolv_TrustedDecodeInput in = { bytes, bytesEnd };
+			return smolv_DecodeBlock(state, in, outSpirv, outSpirvEnd);
+		}
+		smolv_DecodeInput in = { bytes, bytesEnd };
+		return smolv_DecodeBlock(state, in, outSpirv, outSpirvEnd);
+	}
+
+	if (!smolv_CheckRestartPoints(restartPoints, restartCount, bytesEnd - bytes, neededBufferSize))
+		return false;
+	smolv_DecodeBlocksData data;
+	data.state = state;
+	data.bytes = bytes;
+	data.size = bytesEnd - bytes;
+	data.spirv = (uint8_t*)spirvOutputBuffer;
+	data.spirvSize = neededBufferSize;
+	data.restartPoints = restartPoints;
+	data.restartCount = restartCount;
+	data.trusted = trusted;
+	data.failed = false;
+	if (parallel)
+		smolv_RunParallel(restartCount + 1, smolv_DecodeBlockTask, &data, threadCount, parallelFor, parallelForUserData);
+	else
+	{
+		for (size_t i = 0; i <= restartCount && !data.failed; ++i)
+			smolv_DecodeBlockTask(&data, i);
+	}
+	return !data.failed;
+}
+
+// Decode, or DecodeParallel when parallel is set
+static bool smolv_Decode(const void* smolvData, size_t smolvSize, void* spirvOutputBuffer, size_t spirvOutputBufferSize, uint32_t flags, const smolv::Dictionary* dictionary,
+	bool parallel, int threadCount, smolv::ParallelForFunc parallelFor, void* parallelForUserData)
+{
+	if (!smolv_DecodeData(smolvData, smolvSize, spirvOutputBuffer, spirvOutputBufferSize, flags, dictionary, parallel, threadCount, parallelFor, parallelForUserData))
+		return false;
+	if (flags & smolv::kDecodeFlagVerifyHash)
+	{
+		uint64_t hash;
+		if (!smolv_GetStoredHash((const uint8_t*)smolvData, hash))
+			return false;
+		return smolv::ContentHash(spirvOutputBuffer, smolv::GetDecodedBufferSize(smolvData, smolvSize)) == hash;
+	}
+	return true;
+}
+
+bool smolv::Decode(const void* smolvData, size_t smolvSize, void* spirvOutputBuffer, size_t spirvOutputBufferSize, uint32_t flags, const Dictionary* dictionary)
+{
+	return smolv_Decode(smolvData, smolvSize, spirvOutputBuffer, spirvOutputBufferSize, flags, dictionary, false, 0, NULL, NULL);
+}
+
+bool smolv::Validate(const void* smolvData, size_t smolvSize, uint32_t flags, const Dictionary* dictionary)
+{
+	const size_t decodedSize = GetDecodedBufferSize(smolvData, smolvSize);
+	if (decodedSize == 0)
+		return false;
+	// Trusted decoding reads exactly the same input as the regular one does, so a fully checked
+	// decode of it is all the validation there is to do.
+	flags &= ~kDecodeFlagTrusted;
+	uint64_t hash;
+	if (smolv_GetStoredHash((const uint8_t*)smolvData, hash))
+		flags |= kDecodeFlagVerifyHash;
+	ByteArray spirv(decodedSize);
+	return smolv_Decode(smolvData, smolvSize, spirv.data(), spirv.size(), flags, dictionary, false, 0, NULL, NULL);
+}
+
+
+// --------------------------------------------------------------------------------------------
+// Partial decoding
+
+// Module section (smolv::ModuleSection) an instruction belongs to, going by its op alone;
+// anything not listed goes with types/constants/variables.
+static int smolv_GetModuleSection(uint32_t op)
+{
+	switch (op)
+	{
+	case SpvOpCapability:
+	case SpvOpExtension:
+	case SpvOpExtInstImport:
+	case SpvOpMemoryModel:
+		return smolv::kSectionCapabilities;
+	case SpvOpEntryPoint:
+	case SpvOpExecutionMode:
+	case SpvOpExecutionModeId:
+		return smolv::kSectionEntryPoints;
+	case SpvOpString:
+	case SpvOpSourceExtension:
+	case SpvOpSource:
+	case SpvOpSourceContinued:
+	case SpvOpName:
+	case SpvOpMemberName:
+	case SpvOpModuleProcessed:
+		return smolv::kSectionDebug;
+	case SpvOpDecorate:
+	case SpvOpMemberDecorate:
+	case SpvOpDecorationGroup:
+	case SpvOpGroupDecorate:
+	case SpvOpGroupMemberDecorate:
+	case SpvOpDecorateId:
+	case 5632: // OpDecorateString
+	case 5633: // OpMemberDecorateString
+		return smolv::kSectionAnnotations;
+	case SpvOpFunction:
+		return smolv::kSectionFunctions;
+	default:
+		return smolv::kSectionTypes;
+	}
+}
+
+struct smolv_DecodeSectionsData
+{
+	int lastSection;
+	int section; // section of the last decoded instruction; sections only go forward
+	bool done;
+	size_t maxInstructionsSize; // decoded size of all instructions; nothing decodes into more
+	size_t outSize; // used part of the output array; the rest is space to decode into
+	smolv::DecodeInstructionFunc instructionFunc; // if null, decoded instructions are kept in the output array
+	void* userData;
+};
+
+// Buffer for decoding one instruction at a time into: uses fixed storage inside of it, and only
+// allocates memory for instructions that do not fit (e.g. debug info with embedded shader source).
+struct smolv_ScratchBuffer
+{
+	uint32_t fixed[1024];
+	smolv::ByteArray heap;
+
+	uint8_t* data() { return heap.empty() ? (uint8_t*)fixed : heap.data(); }
+	size_t size() const { return heap.empty() ? sizeof(fixed) : heap.size(); }
+	void resize(size_t size)
+	{
+		if (size <= this->size())
+			return; // only ever grows
+		const bool wasFixed = heap.empty();
+		heap.resize(size);
+		if (wasFixed)
+			memcpy(heap.data(), fixed, sizeof(fixed));
+	}
+};
+
+// Decodes instructions one by one onto the end of the out buffer (ByteArray or smolv_ScratchBuffer),
+// until input ends or an instruction past the last wanted section is found (data.done gets set then).
+template<typename Input, typename Buffer>
+static bool smolv_DecodeSectionsBlock(smolv_DecodeState& state, Input in, smolv_DecodeSectionsData& data, Buffer& out)
+{
+	size_t space = 256;
+	while (!in.AtEnd())
+	{
+		// decode next instruction (or a run of them, for dictionary references) into free space at
+		// the end; if it does not fit, try again with more space
+		const size_t begin = data.outSize;
+		if (out.size() < begin + space)
+			out.resize(std::max(begin + space, out.size() * 2));
+		const smolv_DecodeState prevState = state;
+		Input instrIn = in;
+		uint8_t* instrOut = out.data() + begin;
+		const smolv_DecodeResult res = smolv_DecodeInstructionAny(state, instrIn, instrOut, out.data() + out.size());
+		if (res == kSmolvDecodeNeedOutput && out.size() - begin < data.maxInstructionsSize)
+		{
+			state = prevState;
+			space = (out.size() - begin) * 2;
+			continue;
+		}
+		if (res != kSmolvDecodeOk)
+			return false;
+		in = instrIn;
+		const size_t end = instrOut - out.data();
+
+		for (size_t pos = begin; pos < end; )
+		{
+			const uint32_t* words = (const uint32_t*)(out.data() + pos);
+			const uint32_t wordCount = words[0] >> 16;
+			if (wordCount == 0 || pos + wordCount * 4 > end)
+				return false;
+			const int section = smolv_GetModuleSection(words[0] & 0xFFFF);
+			if (section > data.section)
+				data.section = section;
+			if (data.section > data.lastSection)
+			{
+				data.outSize = pos;
+				data.done = true;
+				return true;
+			}
+			if (data.instructionFunc && !data.instructionFunc(data.userData, words, wordCount))
+			{
+				data.done = true;
+				return true;
+			}
+			pos += wordCount * 4;
+		}
+		// with a callback, instructions were passed on already; array is only a scratch buffer then
+		data.outSize = data.instructionFunc ? 0 : end;
+	}
+	return in.AllRead();
+}
+
+template<typename Buffer>
+static bool smolv_DecodeSections(const void* smolvData, size_t smolvSize, smolv_DecodeSectionsData& data, uint32_t flags, const smolv::Dictionary* dictionary, Buffer& out)
+{
+	const size_t decodedSize = smolv::GetDecodedBufferSize(smolvData, smolvSize);
+	if (decodedSize == 0)
+		return false; // invalid SMOL-V
+
+	const uint8_t* bytes = (const uint8_t*)smolvData;
+	const uint8_t* bytesEnd = bytes + smolvSize;
+
+	uint8_t spirvHeader[20];
+	uint8_t* outSpirv = spirvHeader;
+	smolv_DecodeState initialState;
+	if (!smolv_DecodeHeader(bytes, smolvSize, flags, dictionary, outSpirv, initialState))
+		return false;
+	if (!data.instructionFunc)
+	{
+		out.resize(sizeof(spirvHeader));
+		memcpy(out.data(), spirvHeader, sizeof(spirvHeader));
+	}
+	data.section = smolv::kSectionCapabilities;
+	data.done = false;
+	data.maxInstructionsSize = decodedSize - 20;
+	data.outSize = data.instructionFunc ? 0 : 20;
+
+	const size_t headerSize = smolv_GetSmolHeaderSize(bytes, smolvSize);
+	bytes += headerSize;
+	smolv::ByteArray entropyDecoded;
+	if (!smolv_EntropyDecodeInstructions((const uint8_t*)smolvData, bytes, bytesEnd, entropyDecoded))
+		return false;
+
+	smolv_DecodeState state = initialState;
+	uint32_t streamSizes[kSmolvStreamCount];
+	if (smolv_IsSplitStreams((const uint8_t*)smolvData, headerSize, streamSizes))
+	{
+		smolv_SplitDecodeInput in;
+		if (!smolv_SplitStreams(streamSizes, bytes, bytesEnd, in))
+			return false;
+		if (!smolv_DecodeSectionsBlock(state, in, data, out))
+			return false;
+	}
+	else
+	{
+		// with restart points, go over blocks in order; each starts with initial decoding state
+		const uint32_t* restartPoints;
+		const uint32_t restartCount = smolv_GetRestartPoints((const uint8_t*)smolvData, restartPoints);
+		if (restartCount != 0 && !smolv_CheckRestartPoints(restartPoints, restartCount, bytesEnd - bytes, decodedSize))
+			return false;
+		for (uint32_t i = 0; i <= restartCount && !data.done; ++i)
+		{
+			const size_t inBegin = i == 0 ? 0 : restartPoints[i * 2 - 2];
+			const size_t inEnd = i == restartCount ? bytesEnd - bytes : restartPoints[i * 2];
+			smolv_DecodeInput in = { bytes + inBegin, bytes + inEnd };
+			state = initialState;
+			if (!smolv_DecodeSectionsBlock(state, in, data, out))
+				return false;
+		}
+	}
+	if (data.instructionFunc)
+		return true;
+	out.resize(data.outSize);
+	// when the whole program got decoded, it has to be of the size the header says
+	return data.done || data.outSize == decodedSize;
+}
+
+bool smolv::DecodeSections(const void* smolvData, size_t smolvSize, ByteArray& outSpirv, int lastSection, uint32_t flags, const Dictionary* dictionary)
+{
+	smolv_DecodeSectionsData data;
+	data.lastSection = lastSection;
+	data.instructionFunc = NULL;
+	data.userData = NULL;
+	outSpirv.clear();
+	return smolv_DecodeSections(smolvData, smolvSize, data, flags, dictionary, outSpirv);
+}
+
+bool smolv::DecodeSections(const void* smolvData, size_t smolvSize, DecodeInstructionFunc instructionFunc, void* userData, int lastSection, uint32_t flags, const Dictionary* dictionary)
+{
+	if (instructionFunc == NULL)
+		return false;
+	smolv_DecodeSectionsData data;
+	data.lastSection = lastSection;
+	data.instructionFunc = instructionFunc;
+	data.userData = userData;
+	smolv_ScratchBuffer scratch;
+	return smolv_DecodeSections(smolvData, smolvSize, data, flags, dictionary, scratch);
+}
+
+
+// --------------------------------------------------------------------------------------------
+// Reflection
+
+enum
+{
+	kSmolvReflectNone = 0, // only decorations were seen so far
+	kSmolvReflectInt,
+	kSmolvReflectFloat,
+	kSmolvReflectVector,
+	kSmolvReflectMatrix,
+	kSmolvReflectArray,
+	kSmolvReflectStruct,
+	kSmolvReflectPointer,
+	kSmolvReflectConstant,
+};
+
+// What is known about a type (or integer constant) needed to figure out push constant block sizes
+struct smolv_ReflectType
+{
+	uint32_t id; // zero: unused table slot
+	uint8_t kind;
+	bool hasOffsets; // structs: any member has an Offset
+	uint32_t size; // size in bytes; zero if not known
+	uint32_t count; // vectors: component count; matrices: column count; constants: value; pointers: pointee type
+	uint32_t stride; // arrays: ArrayStride; matrices: row count
+	uint32_t lastMember; // structs: member with the highest Offset
+	uint32_t lastOffset;
+};
+
+// Matrix layout decorations of a struct member; these can come before or after its Offset
+struct smolv_ReflectMember
+{
+	uint32_t id; // struct ID; zero: unused table slot
+	uint32_t member;
+	uint32_t stride; // MatrixStride
+	bool rowMajor;
+};
+
+// Fixed size hash tables, indexed by ID (and member index)
+static const int kSmolvReflectTypeBits = 10;
+static const uint32_t kSmolvReflectTypeCount = 1 << kSmolvReflectTypeBits;
+static const int kSmolvReflectMemberBits = 9;
+static const uint32_t kSmolvReflectMemberCount = 1 << kSmolvReflectMemberBits;
+
+struct smolv_Reflect
+{
+	smolv::Reflection* refl;
+	smolv_ReflectType types[kSmolvReflectTypeCount];
+	uint32_t typeCount;
+	smolv_ReflectMember members[kSmolvReflectMemberCount];
+	uint32_t memberCount;
+};
+
+static smolv_ReflectType* smolv_ReflectFindType(smolv_Reflect& r, uint32_t id, bool add)
+{
+	if (id == 0)
+		return NULL;
+	uint32_t index = (id * 2654435761u) >> (32 - kSmolvReflectTypeBits);
+	while (r.types[index].id != 0)
+	{
+		if (r.types[index].id == id)
+			return &r.types[index];
+		index = (index + 1) & (kSmolvReflectTypeCount - 1);
+	}
+	if (!add)
+		return NULL;
+	if (r.typeCount == kSmolvReflectTypeCount - 1) // keep one slot free, so that lookups end
+	{
+		r.refl->truncated = true;
+		return NULL;
+	}
+	r.typeCount++;
+	r.types[index].id = id;
+	return &r.types[index];
+}
+
+static smolv_ReflectMember* smolv_ReflectFindMember(smolv_Reflect& r, uint32_t id, uint32_t member, bool add)
+{
+	if (id == 0)
+		return NULL;
+	uint32_t index = ((id ^ (member * 0x9E3779B9u)) * 2654435761u) >> (32 - kSmolvReflectMemberBits);
+	while (r.members[index].id != 0)
+	{
+		if (r.members[index].id == id && r.members[index].member == member)
+			return &r.members[index];
+		index = (index + 1) & (kSmolvReflectMemberCount - 1);
+	}
+	if (!add)
+		return NULL;
+	if (r.memberCount == kSmolvReflectMemberCount - 1) // keep one slot free, so that lookups end
+	{
+		r.refl->truncated = true;
+		return NULL;
+	}
+	r.memberCount++;
+	r.members[index].id = id;
+	r.members[index].member = member;
+	return &r.members[index];
+}
+
+static uint32_t smolv_ReflectTypeSize(smolv_Reflect& r, uint32_t id)
+{
+	const smolv_ReflectType* t = smolv_ReflectFindType(r, id, false);
+	return t ? t->size : 0;
+}
+
+static smolv::ReflectBinding* smolv_ReflectFindBinding(smolv::Reflection& refl, uint32_t id, bool add)
+{
+	for (uint32_t i = 0; i < refl.bindingCount; ++i)
+		if (refl.bindings[i].id == id)
+			return &refl.bindings[i];
+	if (!add)
+		return NULL;
+	if (refl.bindingCount == smolv::kReflectMaxBindings)
+	{
+		refl.truncated = true;
+		return NULL;
+	}
+	smolv::ReflectBinding* b = &refl.bindings[refl.bindingCount++];
+	b->id = id;
+	b->storageClass = ~0u;
+	return b;
+}
+
+static smolv::ReflectLocation* smolv_ReflectFindLocation(smolv::Reflection& refl, uint32_t id, bool add)
+{
+	for (uint32_t i = 0; i < refl.locationCount; ++i)
+		if (refl.locations[i].id == id)
+			return &refl.locations[i];
+	if (!add)
+		return NULL;
+	if (refl.locationCount == smolv::kReflectMaxLocations)
+	{
+		refl.truncated = true;
+		return NULL;
+	}
+	smolv::ReflectLocation* l = &refl.locations[refl.locationCount++];
+	l->id = id;
+	l->storageClass = ~0u;
+	return l;
+}
+
+static void smolv_ReflectDecorate(smolv_Reflect& r, uint32_t id, uint32_t dec, uint32_t value)
+{
+	smolv::Reflection& refl = *r.refl;
+	switch (dec)
+	{
+	case 1: // SpecId
+		if (refl.specConstantCount == smolv::kReflectMaxSpecConstants)
+		{
+			refl.truncated = true;
+			break;
+		}
+		refl.specConstants[refl.specConstantCount].id = id;
+		refl.specConstants[refl.specConstantCount].specId = value;
+		refl.specConstantCount++;
+		break;
+	case 6: // ArrayStride
+		if (smolv_ReflectType* t = smolv_ReflectFindType(r, id, true))
+			t->stride = value;
+		break;
+	case 30: // Location
+		if (smolv::ReflectLocation* l = smolv_ReflectFindLocation(refl, id, true))
+			l->location = value;
+		break;
+	case 33: // Binding
+		if (smolv::ReflectBinding* b = smolv_ReflectFindBinding(refl, id, true))
+			b->binding = value;
+		break;
+	case 34: // DescriptorSet
+		if (smolv::ReflectBinding* b = smolv_ReflectFindBinding(refl, id, true))
+			b->set = value;
+		break;
+	}
+}
+
+static void smolv_ReflectMemberDecorate(smolv_Reflect& r, uint32_t id, uint32_t member, uint32_t dec, uint32_t value)
+{
+	// only the member at the highest offset matters for the struct size; matrix layout of members
+	// is remembered until the struct type is reached, since it can be decorated before the Offset
+	if (dec == 35) // Offset
+	{
+		smolv_ReflectType* t = smolv_ReflectFindType(r, id, true);
+		if (t && (!t->hasOffsets || value >= t->lastOffset))
+		{
+			t->hasOffsets = true;
+			t->lastMember = member;
+			t->lastOffset = value;
+		}
+	}
+	else if (dec == 7 || dec == 4) // MatrixStride, RowMajor
+	{
+		smolv_ReflectMember* m = smolv_ReflectFindMember(r, id, member, true);
+		if (!m)
+			return;
+		if (dec == 7)
+			m->stride = value;
+		else
+			m->rowMajor = true;
+	}
+}
+
+static void smolv_ReflectString(const uint32_t* words, const uint32_t* wordsEnd, char* out, size_t outSize)
+{
+	const char* str = (const char*)words;
+	const size_t maxLength = std::min(size_t(wordsEnd - words) * 4, outSize - 1);
+	size_t length = 0;
+	while (length < maxLength && str[length] != 0)
+		++length;
+	memcpy(out, str, length);
+	out[length] = 0;
+}
+
+// DecodeSections callback
+static bool smolv_ReflectInstruction(void* userData, const uint32_t* words, size_t wordCount)
+{
+	smolv_Reflect& r = *(smolv_Reflect*)userData;
+	smolv::Reflection& refl = *r.refl;
+	const uint32_t op = words[0] & 0xFFFF;
+	if (wordCount < 3)
+		return true;
+	smolv_ReflectType* t;
+	switch (op)
+	{
+	case SpvOpEntryPoint:
+		if (refl.entryPointCount == smolv::kReflectMaxEntryPoints)
+		{
+			refl.truncated = true;
+			break;
+		}
+		refl.entryPoints[refl.entryPointCount].executionModel = words[1];
+		refl.entryPoints[refl.entryPointCount].id = words[2];
+		smolv_ReflectString(words + 3, words + wordCount, refl.entryPoints[refl.entryPointCount].name, smolv::kReflectMaxNameLength);
+		refl.entryPointCount++;
+		break;
+	case SpvOpDecorate:
+		smolv_ReflectDecorate(r, words[1], words[2], wordCount > 3 ? words[3] : 0);
+		break;
+	case SpvOpMemberDecorate:
+		if (wordCount > 3)
+			smolv_ReflectMemberDecorate(r, words[1], words[2], words[3], wordCount > 4 ? words[4] : 0);
+		break;
+	case SpvOpTypeInt:
+	case SpvOpTypeFloat:
+		if ((t = smolv_ReflectFindType(r, words[1], true)) != NULL)
+		{
+			t->kind = op == SpvOpTypeInt ? kSmolvReflectInt : kSmolvReflectFloat;
+			t->size = words[2] / 8;
+		}
+		break;
+	case SpvOpTypeVector:
+		if (wordCount > 3 && (t = smolv_ReflectFindType(r, words[1], true)) != NULL)
+		{
+			t->kind = kSmolvReflectVector;
+			t->count = words[3];
+			t->size = smolv_ReflectTypeSize(r, words[2]) * words[3];
+		}
+		break;
+	case SpvOpTypeMatrix:
+		if (wordCount > 3 && (t = smolv_ReflectFindType(r, words[1], true)) != NULL)
+		{
+			// without a MatrixStride, assume columns are aligned like 4 component vectors when they have 3
+			const smolv_ReflectType* column = smolv_ReflectFindType(r, words[2], false);
+			t->kind = kSmolvReflectMatrix;
+			t->count = words[3];
+			t->stride = column ? column->count : 0;
+			const uint32_t columnSize = column ? column->size : 0;
+			t->size = words[3] * (t->stride == 3 ? columnSize / 3 * 4 : columnSize);
+		}
+		break;
+	case SpvOpTypeArray:
+		if (wordCount > 3 && (t = smolv_ReflectFindType(r, words[1], true)) != NULL)
+		{
+			const smolv_ReflectType* length = smolv_ReflectFindType(r, words[3], false);
+			t->kind = kSmolvReflectArray;
+			const uint32_t stride = t->stride ? t->stride : smolv_ReflectTypeSize(r, words[2]);
+			t->size = length && length->kind == kSmolvReflectConstant ? length->count * stride : 0;
+		}
+		break;
+	case SpvOpTypeStruct:
+		if ((t = smolv_ReflectFindType(r, words[1], true)) != NULL)
+		{
+			t->kind = kSmolvReflectStruct;
+			t->size = 0;
+			if (t->hasOffsets && t->lastMember < wordCount - 2)
+			{
+				const smolv_ReflectType* member = smolv_ReflectFindType(r, words[2 + t->lastMember], false);
+				const smolv_ReflectMember* layout = smolv_ReflectFindMember(r, words[1], t->lastMember, false);
+				uint32_t memberSize = member ? member->size : 0;
+				if (member && member->kind == kSmolvReflectMatrix && layout && layout->stride != 0)
+					memberSize = (layout->rowMajor ? member->stride : member->count) * layout->stride;
+				t->size = t->lastOffset + memberSize;
+			}
+		}
+		break;
+	case SpvOpTypePointer:
+		// only push constant pointers, and physical pointers that can be inside push constant blocks
+		if (wordCount > 3 && (words[2] == 9 || words[2] == 5349) && (t = smolv_ReflectFindType(r, words[1], true)) != NULL)
+		{
+			t->kind = kSmolvReflectPointer;
+			t->count = words[3];
+			t->size = words[2] == 5349 ? 8 : 0;
+		}
+		break;
+	case SpvOpConstant:
+	case SpvOpSpecConstant:
+		// integer constants, for array lengths
+		if (wordCount > 3)
+		{
+			const smolv_ReflectType* type = smolv_ReflectFindType(r, words[1], false);
+			if (type && type->kind == kSmolvReflectInt && (t = smolv_ReflectFindType(r, words[2], true)) != NULL)
+			{
+				t->kind = kSmolvReflectConstant;
+				t->count = words[3];
+			}
+		}
+		break;
+	case SpvOpVariable:
+		if (wordCount > 3)
+		{
+			if (smolv::ReflectBinding* b = smolv_ReflectFindBinding(refl, words[2], false))
+				b->storageClass = words[3];
+			if (smolv::ReflectLocation* l = smolv_ReflectFindLocation(refl, words[2], false))
+				l->storageClass = words[3];
+			if (words[3] == 9) // PushConstant
+			{
+				const smolv_ReflectType* pointer = smolv_ReflectFindType(r, words[1], false);
+				if (pointer && pointer->kind == kSmolvReflectPointer)
+					refl.pushConstantSize = std::max(refl.pushConstantSize, smolv_ReflectTypeSize(r, pointer->count));
+			}
+		}
+		break;
+	}
+	return true;
+}
+
+bool smolv::Reflect(const void* smolvData, size_t smolvSize, Reflection* outReflection, uint32_t flags, const Dictionary* dictionary)
+{
+	if (outReflection == NULL)
+		return false;
+	memset(outReflection, 0, sizeof(*outReflection));
+	smolv_Reflect r;
+	memset(r.types, 0, sizeof(r.types));
+	memset(r.members, 0, sizeof(r.members));
+	r.refl = outReflection;
+	r.typeCount = 0;
+	r.memberCount = 0;
 
-	uint8_t* outSpirv = (uint8_t*)spirvOutputBuffer;
-	
-	uint32_t val;
-	int smolVersion = 0;
+	smolv_DecodeSectionsData data;
+	data.lastSection = kSectionTypes;
+	data.instructionFunc = smolv_ReflectInstruction;
+	data.userData = &r;
+	smolv_ScratchBuffer scratch;
+	return smolv_DecodeSections(smolvData, smolvSize, data, flags, dictionary, scratch);
+}
 
-	// header
-	smolv_Write4(outSpirv, kSpirVHeaderMagic); bytes += 4;
-	smolv_Read4(bytes, bytesEnd, val); smolVersion = val >> 24; val &= 0x00FFFFFF; smolv_Write4(outSpirv, val); // version
-	smolv_Read4(bytes, bytesEnd, val); smolv_Write4(outSpirv, val); // generator
-	smolv_Read4(bytes, bytesEnd, val); smolv_Write4(outSpirv, val); // bound
-	smolv_Read4(bytes, bytesEnd, val); smolv_Write4(outSpirv, val); // schema
-	bytes += 4; // decode buffer size
-	
-	// there are two SMOL-V encoding versions, both not indicating anything in their header version field:
-	// one that is called "before zero" here (2016-08-31 code). Support decoding that one only by presence
-	// of this special flag.
-	const bool beforeZeroVersion = smolVersion == 0 && (flags & kDecodeFlagUse20160831AsZeroVersion) != 0;
 
-	const int knownOpsCount = smolv_GetKnownOpsCount(smolVersion);
+// --------------------------------------------------------------------------------------------
+// Streaming decoding
+
+
+struct smolv::DecodeStream
+{
+	uint32_t flags;
+	const Dictionary* dictionary;
+	smolv_DecodeState state;
+	std::vector<uint8_t> header;
+	size_t headerSize; // how much of the header we have received so far
+	bool headerDone;
+	size_t decodedSize; // total SPIR-V size, known once we have the header
+	size_t decodedSoFar; // how much SPIR-V was decoded so far (including not yet returned pendingOutput)
+	bool failed;
+	// bytes of an instruction that did not arrive in full yet
+	std::vector<uint8_t> pendingInput;
+	// decoded SPIR-V that did not fit into the output yet
+	std::vector<uint8_t> pendingOutput;
+	size_t pendingOutputPos;
+	// entropy coded or split stream instructions get gathered until all of them arrive, then decoded from there
+	bool gatherInput;
+	bool gatherDone;
+	size_t gatherSize; // size of the gathered input
+	bool entropyCoded;
+	uint32_t entropyDecodedSize;
+	bool splitStreams;
+	uint32_t streamSizes[kSmolvStreamCount];
+	std::vector<uint8_t> gathered; // gathered input; entropy decoded once all of it is there
+	smolv_DecodeInput gatheredInput; // position in the gathered data
+	smolv_SplitDecodeInput gatheredSplitInput; // same, for split streams
+	// restart points (pointing into the header), and position in the encoded instructions to know when we reach them
+	const uint32_t* restartPoints;
+	uint32_t restartCount;
+	uint32_t nextRestart;
+	size_t instructionsPos;
+	// with kDecodeFlagVerifyHash: hash of the output returned so far, and the one it should end up as
+	smolv_HashState hash;
+	uint64_t storedHash;
+};
+
+
+static void smolv_DecodeStreamInit(smolv::DecodeStream* s, uint32_t flags, const smolv::Dictionary* dictionary)
+{
+	s->flags = flags;
+	s->dictionary = dictionary;
+	memset(&s->state, 0, sizeof(s->state));
+	s->headerSize = 0;
+	s->headerDone = false;
+	s->decodedSize = 0;
+	s->decodedSoFar = 0;
+	s->failed = false;
+	s->pendingOutputPos = 0;
+	s->gatherInput = false;
+	s->gatherDone = false;
+	s->gatherSize = 0;
+	s->entropyCoded = false;
+	s->entropyDecodedSize = 0;
+	s->splitStreams = false;
+	memset(s->streamSizes, 0, sizeof(s->streamSizes));
+	memset(&s->gatheredInput, 0, sizeof(s->gatheredInput));
+	memset(&s->gatheredSplitInput, 0, sizeof(s->gatheredSplitInput));
+	s->restartPoints = NULL;
+	s->restartCount = 0;
+	s->nextRestart = 0;
+	s->instructionsPos = 0;
+	smolv_HashInit(s->hash);
+	s->storedHash = 0;
+}
+
+smolv::DecodeStream* smolv::DecodeStreamCreate(uint32_t flags, const Dictionary* dictionary)
+{
+	DecodeStream* s = new DecodeStream();
+	smolv_DecodeStreamInit(s, flags, dictionary);
+	return s;
+}
+
+void smolv::DecodeStreamDelete(DecodeStream* s)
+{
+	delete s;
+}
+
+bool smolv::DecodeStreamIsDone(const DecodeStream* s)
+{
+	return s && !s->failed && s->headerDone && s->decodedSoFar == s->decodedSize && s->pendingOutputPos == s->pendingOutput.size();
+}
+
+size_t smolv::DecodeStreamGetDecodedSize(const DecodeStream* s)
+{
+	return s && s->headerDone ? s->decodedSize : 0;
+}
 
-	uint32_t prevResult = 0;
-	uint32_t prevDecorate = 0;
+// Decode one instruction from given input, directly into the output if there's space for it, and
+// into pendingOutput otherwise. Returns kSmolvDecodeOk, kSmolvDecodeNeedInput or kSmolvDecodeError.
+template<typename Input>
+static smolv_DecodeResult smolv_DecodeStreamInstruction(smolv::DecodeStream* s, Input& in, uint8_t*& out, uint8_t* outEnd)
+{
+	const size_t decodedLeft = s->decodedSize - s->decodedSoFar;
+	if ((size_t)(outEnd - out) > decodedLeft)
+		outEnd = out + decodedLeft;
 
-	while (bytes < bytesEnd)
+	// at a restart point, reset the state; it has to be where the decoded output is too
+	if (s->nextRestart < s->restartCount)
 	{
-		// read length + opcode
-		uint32_t instrLen;
-		SpvOp op;
-		if (!smolv_ReadLengthOp(bytes, bytesEnd, instrLen, op))
-			return false;
-		const bool wasSwizzle = (op == SpvOpVectorShuffleCompact);
-		if (wasSwizzle)
-			op = SpvOpVectorShuffle;
-		smolv_Write4(outSpirv, (instrLen << 16) | op);
+		const uint32_t* point = s->restartPoints + s->nextRestart * 2;
+		if (s->instructionsPos > point[0])
+			return kSmolvDecodeError; // instruction went past the restart point
+		if (s->instructionsPos == point[0])
+		{
+			if (s->decodedSoFar != point[1])
+				return kSmolvDecodeError;
+			smolv_RestartState(s->state);
+			s->nextRestart++;
+		}
+	}
 
-		size_t ioffs = 1;
+	const smolv_DecodeState prevState = s->state;
+	Input instrIn = in;
+	uint8_t* instrOut = out;
+	smolv_DecodeResult res = smolv_DecodeInstructionAny(s->state, instrIn, instrOut, outEnd);
+	if (res == kSmolvDecodeOk)
+	{
+		s->decodedSoFar += instrOut - out;
+		s->instructionsPos += instrIn.Position() - in.Position();
+		in = instrIn;
+		out = instrOut;
+		return res;
+	}
+	s->state = prevState;
+	if (res != kSmolvDecodeNeedOutput)
+		return res;
 
-		// read type as varint, if we have it
-		if (smolv_OpHasType(op, knownOpsCount))
+	// does not fit into output; decode into pendingOutput (growing as needed, up to total decoded size)
+	size_t capacity = 1024;
+	while (true)
+	{
+		if (capacity > decodedLeft)
+			capacity = decodedLeft;
+		s->pendingOutput.resize(capacity);
+		s->pendingOutputPos = 0;
+		instrIn = in;
+		uint8_t* pendingOut = s->pendingOutput.data();
+		res = smolv_DecodeInstructionAny(s->state, instrIn, pendingOut, s->pendingOutput.data() + capacity);
+		if (res == kSmolvDecodeOk)
 		{
-			if (!smolv_ReadVarint(bytes, bytesEnd, val)) return false;
-			smolv_Write4(outSpirv, val);
-			ioffs++;
+			s->pendingOutput.resize(pendingOut - s->pendingOutput.data());
+			s->decodedSoFar += s->pendingOutput.size();
+			s->instructionsPos += instrIn.Position() - in.Position();
+			in = instrIn;
+			return res;
 		}
-		// read result as delta+varint, if we have it
-		if (smolv_OpHasResult(op, knownOpsCount))
+		s->state = prevState;
+		s->pendingOutput.clear();
+		if (res != kSmolvDecodeNeedOutput)
+			return res;
+		if (capacity == decodedLeft)
+			return kSmolvDecodeError; // would decode to more than the header said
+		capacity *= 2;
+	}
+}
+
+// Decode as many whole instructions as there are in the input and fit into the output, in one go
+// (state kept in locals, like regular decoding does). Stops before an instruction that did not fully
+// arrive or does not fit; that one is left for smolv_DecodeStreamInstruction.
+template<bool kAllowDictionary>
+static bool smolv_DecodeStreamRun(smolv::DecodeStream* s, smolv_DecodeInput& in, uint8_t*& out, uint8_t* outEnd)
+{
+	const size_t decodedLeft = s->decodedSize - s->decodedSoFar;
+	if ((size_t)(outEnd - out) > decodedLeft)
+		outEnd = out + decodedLeft;
+
+	smolv_DecodeState state = s->state;
+	smolv_DecodeInput i = in;
+	uint8_t* o = out;
+	smolv_DecodeResult res = kSmolvDecodeOk;
+	// stop at the next restart point; smolv_DecodeStreamInstruction deals with it
+	if (s->nextRestart < s->restartCount)
+	{
+		const size_t restartPos = s->restartPoints[s->nextRestart * 2];
+		if (s->instructionsPos >= restartPos)
+			return true;
+		if (size_t(i.bytesEnd - i.bytes) > restartPos - s->instructionsPos)
+			i.bytesEnd = i.bytes + (restartPos - s->instructionsPos);
+	}
+	while (!i.AtEnd())
+	{
+		// on failure, only these need restoring (numeric types only ever get appended)
+		const smolv_DecodeInput instrIn = i;
+		uint8_t* const instrOut = o;
+		const uint32_t prevResult = state.prevResult, prevDecorate = state.prevDecorate, prevExtInstSet = state.prevExtInstSet;
+		const int numericTypeCount = state.numericTypes.count;
+		res = smolv_DecodeInstruction<false, kAllowDictionary>(state, i, o, outEnd);
+		if (res != kSmolvDecodeOk)
 		{
-			if (!smolv_ReadVarint(bytes, bytesEnd, val)) return false;
-			val = prevResult + smolv_ZigDecode(val);
-			smolv_Write4(outSpirv, val);
-			prevResult = val;
-			ioffs++;
+			i = instrIn;
+			o = instrOut;
+			state.prevResult = prevResult;
+			state.prevDecorate = prevDecorate;
+			state.prevExtInstSet = prevExtInstSet;
+			state.numericTypes.count = numericTypeCount;
+			break;
 		}
-		
-		// Decorate: IDs relative to previous decorate
-		if (op == SpvOpDecorate || op == SpvOpMemberDecorate)
+	}
+	s->state = state;
+	s->decodedSoFar += o - out;
+	s->instructionsPos += i.bytes - in.bytes;
+	in.bytes = i.bytes;
+	out = o;
+	return res != kSmolvDecodeError;
+}
+
+bool smolv::DecodeStreamProcess(DecodeStream* s, const void* input, size_t inputSize, size_t* outInputUsed, void* output, size_t outputSize, size_t* outOutputWritten)
+{
+	const uint8_t* in = (const uint8_t*)input;
+	const uint8_t* inEnd = in + inputSize;
+	uint8_t* out = (uint8_t*)output;
+	uint8_t* outEnd = out + outputSize;
+	if (outInputUsed)
+		*outInputUsed = 0;
+	if (outOutputWritten)
+		*outOutputWritten = 0;
+	if (!s || s->failed || (!in && inputSize) || (!out && outputSize))
+		return false;
+
+	while (true)
+	{
+		// return whatever decoded data we still have
+		if (s->pendingOutputPos < s->pendingOutput.size())
 		{
-			if (!smolv_ReadVarint(bytes, bytesEnd, val)) return false;
-			// "before zero" version did not use zig encoding for the value
-			val = prevDecorate + (beforeZeroVersion ? val : smolv_ZigDecode(val));
-			smolv_Write4(outSpirv, val);
-			prevDecorate = val;
-			ioffs++;
+			size_t size = std::min(s->pendingOutput.size() - s->pendingOutputPos, size_t(outEnd - out));
+			if (size != 0)
+				memcpy(out, s->pendingOutput.data() + s->pendingOutputPos, size);
+			out += size;
+			s->pendingOutputPos += size;
+			if (s->pendingOutputPos < s->pendingOutput.size())
+				break; // output is full
 		}
+		s->pendingOutput.clear();
+		s->pendingOutputPos = 0;
 
-		// MemberDecorate special decoding
-		if (op == SpvOpMemberDecorate && !beforeZeroVersion)
+		// header
+		if (!s->headerDone)
 		{
-			if (bytes >= bytesEnd)
-				return false; // broken input
-			int count = *bytes++;
-			int prevIndex = 0;
-			int prevOffset = 0;
-			for (int m = 0; m < count; ++m)
+			// header size depends on the header itself, so read in pieces until we know it
+			size_t needed = smolv_GetSmolHeaderSize(s->header.data(), s->headerSize);
+			if (s->headerSize < needed)
 			{
-				// read member index
-				uint32_t memberIndex;
-				if (!smolv_ReadVarint(bytes, bytesEnd, memberIndex)) return false;
-				memberIndex += prevIndex;
-				prevIndex = memberIndex;
-				
-				// decoration (and length if not common/known)
-				uint32_t memberDec;
-				if (!smolv_ReadVarint(bytes, bytesEnd, memberDec)) return false;
-				const int knownExtraOps = smolv_DecorationExtraOps(memberDec);
-				uint32_t memberLen;
-				if (knownExtraOps == -1)
+				const size_t maxSize = s->headerSize >= kSmolHeaderSize ? smolv_GetMaxSmolHeaderSize(((const uint32_t*)s->header.data())[5]) : kSmolHeaderSize;
+				if (needed > maxSize)
 				{
-					if (!smolv_ReadVarint(bytes, bytesEnd, memberLen)) return false;
-					memberLen += 4;
+					s->failed = true;
+					return false;
 				}
-				else
-					memberLen = 4 + knownExtraOps;
+				s->header.resize(needed);
+				size_t size = std::min(needed - s->headerSize, size_t(inEnd - in));
+				if (size != 0)
+					memcpy(s->header.data() + s->headerSize, in, size);
+				in += size;
+				s->headerSize += size;
+				if (s->headerSize < needed)
+					break; // need more input
+				continue;
+			}
+			s->headerDone = true;
+			s->decodedSize = GetDecodedBufferSize(s->header.data(), s->headerSize);
+			s->pendingOutput.resize(20);
+			uint8_t* spirvHeader = s->pendingOutput.data();
+			if (s->decodedSize < 20 || !smolv_DecodeHeader(s->header.data(), s->headerSize, s->flags, s->dictionary, spirvHeader, s->state))
+			{
+				s->failed = true;
+				return false;
+			}
+			s->decodedSoFar = 20;
+			if ((s->flags & kDecodeFlagVerifyHash) && !smolv_GetStoredHash(s->header.data(), s->storedHash))
+			{
+				s->failed = true;
+				return false;
+			}
+			s->restartCount = smolv_GetRestartPoints(s->header.data(), s->restartPoints);
+			if (!smolv_CheckRestartPoints(s->restartPoints, s->restartCount, ~size_t(0), s->decodedSize))
+			{
+				s->failed = true;
+				return false;
+			}
+			uint32_t entropyCodedSize = 0;
+			s->entropyCoded = smolv_IsEntropyCoded(s->header.data(), s->headerSize, s->entropyDecodedSize, entropyCodedSize);
+			s->splitStreams = smolv_IsSplitStreams(s->header.data(), s->headerSize, s->streamSizes);
+			s->gatherInput = s->entropyCoded || s->splitStreams;
+			if (s->entropyCoded)
+				s->gatherSize = entropyCodedSize;
+			else
+			{
+				for (int i = 0; i < kSmolvStreamCount; ++i)
+					s->gatherSize += s->streamSizes[i];
+			}
+			continue;
+		}
+
+		if (s->decodedSoFar == s->decodedSize)
+			break; // all done
 
-				// write SPIR-V op+length (unless it's first member decoration, in which case it was written before)
-				if (m != 0)
+		smolv_DecodeResult res;
+		if (s->gatherInput)
+		{
+			if (!s->gatherDone)
+			{
+				// still gathering the input
+				size_t size = std::min(s->gatherSize - s->gathered.size(), size_t(inEnd - in));
+				s->gathered.insert(s->gathered.end(), in, in + size);
+				in += size;
+				if (s->gathered.size() < s->gatherSize)
+					break; // need more input
+				if (s->entropyCoded)
 				{
-					smolv_Write4(outSpirv, (memberLen << 16) | op);
-					smolv_Write4(outSpirv, prevDecorate);
+					std::vector<uint8_t> decoded(s->entropyDecodedSize);
+					if (s->entropyDecodedSize / 8 > s->gatherSize || !smolv_EntropyDecode(s->gathered.data(), s->gatherSize, decoded.data(), decoded.size()))
+					{
+						s->failed = true;
+						return false;
+					}
+					s->gathered.swap(decoded);
 				}
-				smolv_Write4(outSpirv, memberIndex);
-				smolv_Write4(outSpirv, memberDec);
-				// Special case for Offset decorations
-				if (memberDec == 35) // Offset
+				const uint8_t* bytes = s->gathered.data();
+				const uint8_t* bytesEnd = bytes + s->gathered.size();
+				s->gatheredInput.bytes = bytes;
+				s->gatheredInput.bytesEnd = bytesEnd;
+				if (s->splitStreams && !smolv_SplitStreams(s->streamSizes, bytes, bytesEnd, s->gatheredSplitInput))
 				{
-					if (memberLen != 5)
-						return false;
-					if (!smolv_ReadVarint(bytes, bytesEnd, val)) return false;
-					val += prevOffset;
-					smolv_Write4(outSpirv, val);
-					prevOffset = val;
+					s->failed = true;
+					return false;
+				}
+				s->gatherDone = true;
+			}
+			// decode instructions out of the gathered data; all of it is there already
+			if (s->splitStreams)
+				res = smolv_DecodeStreamInstruction(s, s->gatheredSplitInput, out, outEnd);
+			else
+				res = smolv_DecodeStreamInstruction(s, s->gatheredInput, out, outEnd);
+			if (res == kSmolvDecodeNeedInput)
+				res = kSmolvDecodeError;
+		}
+		else if (in == inEnd)
+			break; // need more input
+		else if (s->pendingInput.empty())
+		{
+			// decode straight from the input: whole instructions in one go, then the one that did
+			// not fully arrive or fit
+			smolv_DecodeInput input = { in, inEnd };
+			res = kSmolvDecodeOk;
+			if (!s->state.beforeZeroVersion && !(s->state.dictionary ? smolv_DecodeStreamRun<true>(s, input, out, outEnd) : smolv_DecodeStreamRun<false>(s, input, out, outEnd)))
+				res = kSmolvDecodeError;
+			else if (!input.AtEnd() && s->decodedSoFar != s->decodedSize)
+				res = smolv_DecodeStreamInstruction(s, input, out, outEnd);
+			in = input.bytes;
+			if (res == kSmolvDecodeNeedInput)
+			{
+				// keep the partial instruction around until more input arrives
+				s->pendingInput.assign(in, inEnd);
+				in = inEnd;
+			}
+		}
+		else
+		{
+			// we have part of an instruction already; append more input to it (growing the amount
+			// each time, so that large instructions don't get quadratic cost) and try again
+			const size_t prevSize = s->pendingInput.size();
+			const size_t size = std::min(std::max(prevSize, size_t(64)), size_t(inEnd - in));
+			s->pendingInput.insert(s->pendingInput.end(), in, in + size);
+			smolv_DecodeInput input = { s->pendingInput.data(), s->pendingInput.data() + s->pendingInput.size() };
+			res = smolv_DecodeStreamInstruction(s, input, out, outEnd);
+			if (res == kSmolvDecodeNeedInput)
+				in += size;
+			else if (res == kSmolvDecodeOk)
+			{
+				const size_t used = input.bytes - s->pendingInput.data();
+				if (used >= prevSize)
+				{
+					// consumed all of the previous partial data, and some of the new input
+					in += used - prevSize;
+					s->pendingInput.clear();
 				}
 				else
 				{
-					for (uint32_t i = 4; i < memberLen; ++i)
-					{
-						if (!smolv_ReadVarint(bytes, bytesEnd, val)) return false;
-						smolv_Write4(outSpirv, val);
-					}
+					s->pendingInput.resize(prevSize);
+					s->pendingInput.erase(s->pendingInput.begin(), s->pendingInput.begin() + used);
 				}
 			}
-			continue;
 		}
+		if (res == kSmolvDecodeError)
+		{
+			s->failed = true;
+			return false;
+		}
+	}
+
+	if (s->flags & kDecodeFlagVerifyHash)
+	{
+		const size_t written = out - (uint8_t*)output;
+		if (written != 0)
+		{
+			smolv_HashUpdate(s->hash, output, written);
+			if (DecodeStreamIsDone(s) && smolv_HashFinal(s->hash) != s->storedHash)
+			{
+				s->failed = true;
+				return false;
+			}
+		}
+	}
+
+	if (outInputUsed)
+		*outInputUsed = in - (const uint8_t*)input;
+	if (outOutputWritten)
+		*outOutputWritten = out - (uint8_t*)output;
+	return true;
+}
+
+
+// --------------------------------------------------------------------------------------------
+// Decoding from an input function (e.g. straight out of a decompressor)
+
+// Pulls input pieces out of inputFunc and decodes them into the output. When outArray is given,
+// it gets sized to the decoded program as soon as the header arrives, and decoded into.
+static bool smolv_DecodeFromInput(smolv::DecodeStream* s, smolv::DecodeInputFunc inputFunc, void* inputUserData, uint8_t* out, size_t outSize, smolv::ByteArray* outArray, size_t& outWritten, size_t& outInputLeft)
+{
+	const uint8_t* in = NULL;
+	size_t inSize = 0;
+	outWritten = 0;
+	while (!smolv::DecodeStreamIsDone(s))
+	{
+		if (outArray && outArray->empty() && smolv::DecodeStreamGetDecodedSize(s) != 0)
+		{
+			outArray->resize(smolv::DecodeStreamGetDecodedSize(s));
+			out = outArray->data();
+			outSize = outArray->size();
+		}
+		size_t used = 0, written = 0;
+		if (!smolv::DecodeStreamProcess(s, in, inSize, &used, out + outWritten, outSize - outWritten, &written))
+			return false;
+		in += used;
+		inSize -= used;
+		outWritten += written;
+		if (used == 0 && written == 0)
+		{
+			if (inSize != 0)
+				return false; // output buffer is full
+			const void* data = NULL;
+			if (!inputFunc(inputUserData, &data, &inSize))
+				return false;
+			if (inSize == 0 || !data)
+				return false; // input is over before the whole program was decoded
+			in = (const uint8_t*)data;
+		}
+	}
+	outInputLeft = inSize;
+	return true;
+}
+
+bool smolv::DecodeFromInput(DecodeInputFunc inputFunc, void* inputUserData, void* spirvOutputBuffer, size_t spirvOutputBufferSize, size_t* outSpirvWritten, size_t* outInputLeft, uint32_t flags, const Dictionary* dictionary)
+{
+	if (outSpirvWritten)
+		*outSpirvWritten = 0;
+	if (outInputLeft)
+		*outInputLeft = 0;
+	if (!inputFunc || (!spirvOutputBuffer && spirvOutputBufferSize))
+		return false;
+
+	DecodeStream s;
+	smolv_DecodeStreamInit(&s, flags, dictionary);
+	size_t written = 0, left = 0;
+	if (!smolv_DecodeFromInput(&s, inputFunc, inputUserData, (uint8_t*)spirvOutputBuffer, spirvOutputBufferSize, NULL, written, left))
+		return false;
+	if (outSpirvWritten)
+		*outSpirvWritten = written;
+	if (outInputLeft)
+		*outInputLeft = left;
+	return true;
+}
+
+bool smolv::DecodeFromInput(DecodeInputFunc inputFunc, void* inputUserData, ByteArray& outSpirv, size_t* outInputLeft, uint32_t flags, const Dictionary* dictionary)
+{
+	outSpirv.clear();
+	if (outInputLeft)
+		*outInputLeft = 0;
+	if (!inputFunc)
+		return false;
+
+	DecodeStream s;
+	smolv_DecodeStreamInit(&s, flags, dictionary);
+	size_t written = 0, left = 0;
+	if (!smolv_DecodeFromInput(&s, inputFunc, inputUserData, NULL, 0, &outSpirv, written, left))
+		return false;
+	if (outInputLeft)
+		*outInputLeft = left;
+	return true;
+}
+
+
+
+// --------------------------------------------------------------------------------------------
+// Simple built-in thread pool: run task for each index in 0..count-1. Threads grab
+// the next index from a shared counter, so uneven task sizes get balanced out.
+
+struct smolv_ParallelForData
+{
+	std::atomic<size_t> next;
+	size_t count;
+	smolv::ParallelTaskFunc task;
+	void* taskData;
+};
+
+static void smolv_ParallelForWorker(smolv_ParallelForData* data)
+{
+	while (true)
+	{
+		size_t index = data->next.fetch_add(1);
+		if (index >= data->count)
+			break;
+		data->task(data->taskData, index);
+	}
+}
+
+static void smolv_ParallelFor(size_t count, int threadCount, smolv::ParallelTaskFunc task, void* taskData)
+{
+	if (threadCount <= 0)
+		threadCount = (int)std::thread::hardware_concurrency();
+	if (threadCount <= 0)
+		threadCount = 1;
+	if ((size_t)threadCount > count)
+		threadCount = (int)count;
+
+	smolv_ParallelForData data;
+	data.next = 0;
+	data.count = count;
+	data.task = task;
+	data.taskData = taskData;
+
+	// calling thread does work too
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount > 1 ? threadCount - 1 : 0);
+	for (int i = 1; i < threadCount; ++i)
+		threads.push_back(std::thread(smolv_ParallelForWorker, &data));
+	smolv_ParallelForWorker(&data);
+	for (size_t i = 0; i < threads.size(); ++i)
+		threads[i].join();
+}
+
+// Runs on user provided parallelFor if there is one, on the built-in thread pool otherwise
+static void smolv_RunParallel(size_t count, smolv::ParallelTaskFunc task, void* taskData, int threadCount, smolv::ParallelForFunc parallelFor, void* parallelForUserData)
+{
+	if (parallelFor)
+		parallelFor(parallelForUserData, count, task, taskData);
+	else
+		smolv_ParallelFor(count, threadCount, task, taskData);
+}
+
+
+struct smolv_DecodeBatchData
+{
+	smolv::DecodeJob* jobs;
+	const size_t* order;
+	uint32_t flags;
+	const smolv::Dictionary* dictionary;
+};
+
+static void smolv_DecodeBatchTask(void* taskData, size_t index)
+{
+	const smolv_DecodeBatchData* data = (const smolv_DecodeBatchData*)taskData;
+	smolv::DecodeJob& job = data->jobs[data->order[index]];
+	job.result = smolv::Decode(job.smolvData, job.smolvSize, job.spirvOutputBuffer, job.spirvOutputBufferSize, data->flags, data->dictionary);
+}
+
+struct smolv_CompareJobSizes
+{
+	const smolv::DecodeJob* jobs;
+	bool operator()(size_t a, size_t b) const { return jobs[a].smolvSize > jobs[b].smolvSize; }
+};
+
+bool smolv::DecodeBatch(DecodeJob* jobs, size_t jobCount, uint32_t flags, int threadCount, ParallelForFunc parallelFor, void* parallelForUserData, const Dictionary* dictionary)
+{
+	if (jobCount == 0)
+		return true;
+	if (!jobs)
+		return false;
+
+	// start the largest jobs first, so that the small ones fill in the gaps at the end
+	std::vector<size_t> order(jobCount);
+	for (size_t i = 0; i < jobCount; ++i)
+	{
+		order[i] = i;
+		jobs[i].result = false;
+	}
+	smolv_CompareJobSizes cmp = { jobs };
+	std::stable_sort(order.begin(), order.end(), cmp);
+
+	smolv_DecodeBatchData data;
+	data.jobs = jobs;
+	data.order = order.data();
+	data.flags = flags;
+	data.dictionary = dictionary;
+	smolv_RunParallel(jobCount, smolv_DecodeBatchTask, &data, threadCount, parallelFor, parallelForUserData);
+
+	bool ok = true;
+	for (size_t i = 0; i < jobCount; ++i)
+		ok &= jobs[i].result;
+	return ok;
+}
+
+
+bool smolv::DecodeParallel(const void* smolvData, size_t smolvSize, void* spirvOutputBuffer, size_t spirvOutputBufferSize, uint32_t flags, int threadCount, ParallelForFunc parallelFor, void* parallelForUserData, const Dictionary* dictionary)
+{
+	return smolv_Decode(smolvData, smolvSize, spirvOutputBuffer, spirvOutputBufferSize, flags, dictionary, true, threadCount, parallelFor, parallelForUserData);
+}
+
+
+
+// --------------------------------------------------------------------------------------------
+// Training dictionaries
+//
+// - Find instructions that are in at least two programs,
+// - Find runs of such instructions, and which runs are in at least two programs,
+// - Pick runs and single instructions that would save most, until size budget is used up.
+
+
+static uint64_t smolv_HashWords64(const uint32_t* words, size_t count, uint64_t h = 14695981039346656037ull)
+{
+	// FNV-1a 64 bit, on whole words
+	for (size_t i = 0; i < count; ++i)
+	{
+		h ^= words[i];
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+// Occurrence of an instruction or a run of them in some program
+struct smolv_TrainItem
+{
+	uint64_t hash;
+	uint32_t program;
+	uint32_t start; // instruction index in the program
+	uint32_t count; // instruction count
+	uint32_t wordCount;
+	bool operator<(const smolv_TrainItem& o) const
+	{
+		if (hash != o.hash) return hash < o.hash;
+		if (program != o.program) return program < o.program;
+		return start < o.start;
+	}
+};
+
+struct smolv_TrainProgram
+{
+	const uint32_t* words;
+	std::vector<uint32_t> canonicalWords; // program with canonical IDs, if those are used
+	std::vector<uint32_t> offsets; // word offset of each instruction that can go into dictionary
+	std::vector<uint64_t> hashes; // hash of each instruction
+	std::vector<uint8_t> runBreaks; // whether an instruction follows stripped ones (so can't be in same run as previous one)
+	std::vector<smolv_TrainItem> items; // unique instructions; later, runs of common instructions
+	bool ok;
+};
+
+struct smolv_TrainData
+{
+	const void* const* spirvDatas;
+	const size_t* spirvSizes;
+	bool stripDebugInfo;
+	bool canonicalizeIds;
+	std::vector<smolv_TrainProgram> programs;
+	std::vector<uint64_t> commonHashes; // sorted hashes of instructions present in at least two programs
+};
+
+static void smolv_TrainScanTask(void* taskData, size_t index)
+{
+	smolv_TrainData& data = *(smolv_TrainData*)taskData;
+	smolv_TrainProgram& prog = data.programs[index];
+	prog.ok = false;
+	const size_t wordCount = data.spirvSizes[index] / 4;
+	const uint32_t* words = (const uint32_t*)data.spirvDatas[index];
+	if (wordCount * 4 != data.spirvSizes[index] || !smolv_CheckSpirVHeader(words, wordCount))
+		return;
+	// train on the same instructions that encoding would see
+	if (data.canonicalizeIds && smolv_CanonicalizeIds(words, wordCount, data.stripDebugInfo, NULL, prog.canonicalWords))
+		words = prog.canonicalWords.data();
+	const uint32_t* wordsEnd = words + wordCount;
+	prog.words = words;
+	bool stripped = false;
+	smolv_StripState strip;
+	for (const uint32_t* w = words + 5; w < wordsEnd; )
+	{
+		const uint32_t len = w[0] >> 16;
+		if (len < 1 || w + len > wordsEnd)
+			return; // malformed instruction
+		const SpvOp op = (SpvOp)(w[0] & 0xFFFF);
+		if (op != SpvOpDictionaryRef && !(data.stripDebugInfo && smolv_IsStripped(strip, w, op, 0, NULL)))
+		{
+			smolv_TrainItem item;
+			item.hash = smolv_HashWords64(w, len);
+			item.program = (uint32_t)index;
+			item.start = (uint32_t)prog.offsets.size();
+			item.count = 1;
+			item.wordCount = len;
+			prog.offsets.push_back(uint32_t(w - words));
+			prog.hashes.push_back(item.hash);
+			prog.runBreaks.push_back(stripped);
+			prog.items.push_back(item);
+			stripped = false;
+		}
+		else
+			stripped = true;
+		w += len;
+	}
+	// unique instructions in this program, keeping first occurrence of each
+	std::sort(prog.items.begin(), prog.items.end());
+	size_t unique = 0;
+	for (size_t i = 0; i < prog.items.size(); ++i)
+	{
+		if (unique == 0 || prog.items[unique-1].hash != prog.items[i].hash)
+			prog.items[unique++] = prog.items[i];
+	}
+	prog.items.resize(unique);
+	prog.ok = true;
+}
 
-		// Read this many IDs, that are relative to result ID
-		int relativeCount = smolv_OpDeltaFromResult(op, knownOpsCount);
-		// "before zero" version only used zig encoding for IDs of several ops; after
-		// that ops got zig encoding for their IDs
-		bool zigDecodeVals = true;
-		if (beforeZeroVersion)
+static void smolv_TrainRunsTask(void* taskData, size_t index)
+{
+	smolv_TrainData& data = *(smolv_TrainData*)taskData;
+	smolv_TrainProgram& prog = data.programs[index];
+	prog.items.clear();
+	const size_t count = prog.hashes.size();
+	size_t i = 0;
+	while (i < count)
+	{
+		// find a run of common instructions
+		size_t end = i;
+		uint64_t hash = 14695981039346656037ull;
+		uint32_t wordCount = 0;
+		while (end < count && end - i < 0xFFFF && (end == i || !prog.runBreaks[end]) && std::binary_search(data.commonHashes.begin(), data.commonHashes.end(), prog.hashes[end]))
 		{
-			if (op != SpvOpControlBarrier && op != SpvOpMemoryBarrier && op != SpvOpLoopMerge && op != SpvOpSelectionMerge && op != SpvOpBranch && op != SpvOpBranchConditional && op != SpvOpMemoryNamedBarrier)
-				zigDecodeVals = false;
+			const uint32_t* w = prog.words + prog.offsets[end];
+			hash = smolv_HashWords64(w, w[0] >> 16, hash);
+			wordCount += w[0] >> 16;
+			++end;
 		}
-		for (int i = 0; i < relativeCount && ioffs < instrLen; ++i, ++ioffs)
+		if (end - i >= 2)
 		{
-			if (!smolv_ReadVarint(bytes, bytesEnd, val)) return false;
-			if (zigDecodeVals)
-				val = smolv_ZigDecode(val);
-			smolv_Write4(outSpirv, prevResult - val);
+			smolv_TrainItem item;
+			item.hash = hash;
+			item.program = (uint32_t)index;
+			item.start = (uint32_t)i;
+			item.count = uint32_t(end - i);
+			item.wordCount = wordCount;
+			prog.items.push_back(item);
 		}
+		i = end > i ? end : i + 1;
+	}
+}
 
-		if (wasSwizzle && instrLen <= 9)
+// Sorted occurrences -> candidates (first occurrence of each, that is in at least two programs), with their score
+static void smolv_TrainCountItems(std::vector<smolv_TrainItem>& items, std::vector<std::pair<uint64_t, smolv_TrainItem> >& candidates)
+{
+	std::sort(items.begin(), items.end());
+	for (size_t i = 0; i < items.size(); )
+	{
+		size_t end = i + 1;
+		uint32_t programCount = 1;
+		for (; end < items.size() && items[end].hash == items[i].hash; ++end)
 		{
-			uint32_t swizzle = *bytes++;
-			if (instrLen > 5) smolv_Write4(outSpirv, (swizzle >> 6) & 3);
-			if (instrLen > 6) smolv_Write4(outSpirv, (swizzle >> 4) & 3);
-			if (instrLen > 7) smolv_Write4(outSpirv, (swizzle >> 2) & 3);
-			if (instrLen > 8) smolv_Write4(outSpirv, swizzle & 3);
+			if (items[end].program != items[end-1].program)
+				++programCount;
 		}
-		else if (smolv_OpVarRest(op, knownOpsCount))
+		if (programCount >= 2)
+			candidates.push_back(std::make_pair(uint64_t(programCount - 1) * items[i].wordCount, items[i]));
+		i = end;
+	}
+}
+
+struct smolv_CompareTrainCandidates
+{
+	bool operator()(const std::pair<uint64_t, smolv_TrainItem>& a, const std::pair<uint64_t, smolv_TrainItem>& b) const
+	{
+		if (a.first != b.first)
+			return a.first > b.first;
+		return a.second < b.second;
+	}
+};
+
+struct smolv_CompareTrainPosition
+{
+	bool operator()(const smolv_TrainItem& a, const smolv_TrainItem& b) const
+	{
+		if (a.program != b.program)
+			return a.program < b.program;
+		return a.start < b.start;
+	}
+};
+
+bool smolv::DictionaryTrain(const void* const* spirvDatas, const size_t* spirvSizes, size_t spirvCount, size_t maxDictionarySize, ByteArray& outDictionary, uint32_t flags, int threadCount, ParallelForFunc parallelFor, void* parallelForUserData)
+{
+	if (spirvCount == 0 || !spirvDatas || !spirvSizes || spirvCount > 0xFFFFFFFF)
+		return false;
+
+	smolv_TrainData data;
+	data.spirvDatas = spirvDatas;
+	data.spirvSizes = spirvSizes;
+	data.stripDebugInfo = (flags & kEncodeFlagStripDebugInfo) != 0;
+	data.canonicalizeIds = (flags & kEncodeFlagCanonicalizeIds) != 0;
+	data.programs.resize(spirvCount);
+
+	// hash all instructions
+	smolv_RunParallel(spirvCount, smolv_TrainScanTask, &data, threadCount, parallelFor, parallelForUserData);
+	std::vector<smolv_TrainItem> items;
+	for (size_t i = 0; i < spirvCount; ++i)
+	{
+		if (!data.programs[i].ok)
+			return false;
+		items.insert(items.end(), data.programs[i].items.begin(), data.programs[i].items.end());
+	}
+
+	// common single instructions
+	std::vector<std::pair<uint64_t, smolv_TrainItem> > candidates;
+	smolv_TrainCountItems(items, candidates);
+	for (size_t i = 0; i < candidates.size(); ++i)
+		data.commonHashes.push_back(candidates[i].second.hash); // already sorted by hash
+	const size_t singleCount = candidates.size();
+
+	// common runs of instructions
+	smolv_RunParallel(spirvCount, smolv_TrainRunsTask, &data, threadCount, parallelFor, parallelForUserData);
+	items.clear();
+	for (size_t i = 0; i < spirvCount; ++i)
+		items.insert(items.end(), data.programs[i].items.begin(), data.programs[i].items.end());
+	smolv_TrainCountItems(items, candidates);
+
+	// pick best ones until we're out of budget; skip single instructions that are already in picked runs
+	std::vector<uint8_t> singleUsed(singleCount, 0);
+	std::vector<smolv_TrainItem> picked;
+	size_t dictSize = 0;
+	smolv_CompareTrainCandidates cmp;
+	std::sort(candidates.begin(), candidates.end(), cmp);
+	for (size_t i = 0; i < candidates.size(); ++i)
+	{
+		const smolv_TrainItem& item = candidates[i].second;
+		if (dictSize + item.wordCount * 4 > maxDictionarySize)
+			continue;
+		const smolv_TrainProgram& prog = data.programs[item.program];
+		if (item.count == 1)
 		{
-			// read rest of words with variable encoding
-			for (; ioffs < instrLen; ++ioffs)
-			{
-				if (!smolv_ReadVarint(bytes, bytesEnd, val)) return false;
-				smolv_Write4(outSpirv, val);
-			}
+			size_t single = std::lower_bound(data.commonHashes.begin(), data.commonHashes.end(), item.hash) - data.commonHashes.begin();
+			if (singleUsed[single])
+				continue;
+			singleUsed[single] = 1;
 		}
 		else
 		{
-			// read rest of words without any encoding
-			for (; ioffs < instrLen; ++ioffs)
+			for (uint32_t j = 0; j < item.count; ++j)
 			{
-				if (!smolv_Read4(bytes, bytesEnd, val)) return false;
-				smolv_Write4(outSpirv, val);
+				size_t single = std::lower_bound(data.commonHashes.begin(), data.commonHashes.end(), prog.hashes[item.start + j]) - data.commonHashes.begin();
+				singleUsed[single] = 1;
 			}
 		}
+		picked.push_back(item);
+		dictSize += item.wordCount * 4;
 	}
 
-	if ((uint8_t*)spirvOutputBuffer + neededBufferSize != outSpirv)
-		return false; // something went wrong during decoding? we should have decoded to exact output size
-	
+	// put them into dictionary in the order they were in the programs, so that neighboring single
+	// instructions can be referenced as one run
+	smolv_CompareTrainPosition cmpPos;
+	std::sort(picked.begin(), picked.end(), cmpPos);
+	std::vector<uint32_t> dictSpirv(data.programs[0].words, data.programs[0].words + 5); // header of first program
+	for (size_t i = 0; i < picked.size(); ++i)
+	{
+		const smolv_TrainItem& item = picked[i];
+		const smolv_TrainProgram& prog = data.programs[item.program];
+		for (uint32_t j = 0; j < item.count; ++j)
+		{
+			const uint32_t* w = prog.words + prog.offsets[item.start + j];
+			dictSpirv.insert(dictSpirv.end(), w, w + (w[0] >> 16));
+		}
+	}
+	return Encode(dictSpirv.data(), dictSpirv.size() * 4, outDictionary);
+}
+
+
+
+// --------------------------------------------------------------------------------------------
+// Archives
+
+static const uint32_t kSmolArchiveMagic = 0x41564D53; // "SMVA"
+static const uint32_t kSmolArchiveVersion = 1;
+static const size_t kSmolArchiveHeaderSize = 16;
+static const size_t kSmolArchiveFanoutSize = 256 * 4;
+static const size_t kSmolArchiveEntrySize = 24;
+
+static uint32_t smolv_Get4(const uint8_t* data)
+{
+	uint32_t v;
+	memcpy(&v, data, 4);
+	return v;
+}
+
+static uint64_t smolv_Get8(const uint8_t* data)
+{
+	uint64_t v;
+	memcpy(&v, data, 8);
+	return v;
+}
+
+// Checks archive header & that fanout + index fit into the data; returns entry count (or zero on malformed data)
+static size_t smolv_CheckArchive(const void* archiveData, size_t archiveSize)
+{
+	const uint8_t* data = (const uint8_t*)archiveData;
+	if (!data || archiveSize < kSmolArchiveHeaderSize + kSmolArchiveFanoutSize)
+		return 0;
+	if (smolv_Get4(data) != kSmolArchiveMagic || smolv_Get4(data + 4) != kSmolArchiveVersion)
+		return 0;
+	const size_t count = smolv_Get4(data + 8);
+	if (count > (archiveSize - kSmolArchiveHeaderSize - kSmolArchiveFanoutSize) / kSmolArchiveEntrySize)
+		return 0;
+	if (smolv_Get4(data + kSmolArchiveHeaderSize + 255 * 4) != count)
+		return 0;
+	return count;
+}
+
+static const uint8_t* smolv_ArchiveIndexEntry(const void* archiveData, size_t index)
+{
+	return (const uint8_t*)archiveData + kSmolArchiveHeaderSize + kSmolArchiveFanoutSize + index * kSmolArchiveEntrySize;
+}
+
+struct smolv_CompareArchiveKeys
+{
+	const smolv::ArchiveEntry* entries;
+	bool operator()(size_t a, size_t b) const { return entries[a].key < entries[b].key; }
+};
+
+bool smolv::ArchiveBuild(const ArchiveEntry* entries, size_t entryCount, ByteArray& outArchive)
+{
+	if (entryCount > 0xFFFFFFFF || (entryCount && !entries))
+		return false;
+
+	std::vector<size_t> order(entryCount);
+	for (size_t i = 0; i < entryCount; ++i)
+	{
+		order[i] = i;
+		if (GetDecodedBufferSize(entries[i].smolvData, entries[i].smolvSize) == 0)
+			return false; // not a SMOL-V program
+	}
+	smolv_CompareArchiveKeys cmp = { entries };
+	std::sort(order.begin(), order.end(), cmp);
+	for (size_t i = 1; i < entryCount; ++i)
+	{
+		if (entries[order[i]].key == entries[order[i-1]].key)
+			return false; // duplicate keys
+	}
+
+	size_t totalSize = kSmolArchiveHeaderSize + kSmolArchiveFanoutSize + entryCount * kSmolArchiveEntrySize;
+	const size_t indexEnd = totalSize;
+	for (size_t i = 0; i < entryCount; ++i)
+		totalSize += (entries[i].smolvSize + 3) & ~size_t(3);
+	if (totalSize > 0xFFFFFFFF)
+		return false; // offsets are 32 bit
+
+	const size_t archiveStart = outArchive.size();
+	outArchive.resize(archiveStart + totalSize, 0);
+	uint8_t* base = outArchive.data() + archiveStart;
+	uint8_t* out = base;
+
+	// header
+	smolv_Write4(out, kSmolArchiveMagic);
+	smolv_Write4(out, kSmolArchiveVersion);
+	smolv_Write4(out, (uint32_t)entryCount);
+	smolv_Write4(out, 0); // reserved
+
+	// fanout
+	size_t counted = 0;
+	for (int b = 0; b < 256; ++b)
+	{
+		while (counted < entryCount && (entries[order[counted]].key >> 56) == (uint64_t)b)
+			++counted;
+		smolv_Write4(out, (uint32_t)counted);
+	}
+
+	// index, and the programs themselves
+	size_t offset = indexEnd;
+	for (size_t i = 0; i < entryCount; ++i)
+	{
+		const ArchiveEntry& e = entries[order[i]];
+		const uint64_t key = e.key;
+		memcpy(out, &key, 8); out += 8;
+		smolv_Write4(out, (uint32_t)offset);
+		smolv_Write4(out, (uint32_t)e.smolvSize);
+		smolv_Write4(out, (uint32_t)GetDecodedBufferSize(e.smolvData, e.smolvSize));
+		smolv_Write4(out, 0); // reserved
+		memcpy(base + offset, e.smolvData, e.smolvSize);
+		offset += (e.smolvSize + 3) & ~size_t(3);
+	}
+	return true;
+}
+
+size_t smolv::ArchiveGetCount(const void* archiveData, size_t archiveSize)
+{
+	return smolv_CheckArchive(archiveData, archiveSize);
+}
+
+bool smolv::ArchiveFind(const void* archiveData, size_t archiveSize, uint64_t key, size_t* outIndex)
+{
+	const size_t count = smolv_CheckArchive(archiveData, archiveSize);
+	if (count == 0)
+		return false;
+
+	// fanout table gives the range of entries that have the same highest key byte;
+	// binary search within that
+	const uint8_t* fanout = (const uint8_t*)archiveData + kSmolArchiveHeaderSize;
+	const uint32_t keyByte = uint32_t(key >> 56);
+	size_t lo = keyByte ? smolv_Get4(fanout + (keyByte - 1) * 4) : 0;
+	size_t hi = smolv_Get4(fanout + keyByte * 4);
+	if (hi > count || lo > hi)
+		return false;
+	while (lo < hi)
+	{
+		const size_t mid = lo + (hi - lo) / 2;
+		const uint64_t midKey = smolv_Get8(smolv_ArchiveIndexEntry(archiveData, mid));
+		if (midKey == key)
+		{
+			if (outIndex)
+				*outIndex = mid;
+			return true;
+		}
+		if (midKey < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return false;
+}
+
+bool smolv::ArchiveGetEntry(const void* archiveData, size_t archiveSize, size_t index, uint64_t* outKey, const void** outSmolvData, size_t* outSmolvSize, size_t* outDecodedSize)
+{
+	const size_t count = smolv_CheckArchive(archiveData, archiveSize);
+	if (index >= count)
+		return false;
+	const uint8_t* entry = smolv_ArchiveIndexEntry(archiveData, index);
+	const size_t offset = smolv_Get4(entry + 8);
+	const size_t size = smolv_Get4(entry + 12);
+	if (offset > archiveSize || size > archiveSize - offset)
+		return false; // program goes past end of archive
+	if (outKey)
+		*outKey = smolv_Get8(entry);
+	if (outSmolvData)
+		*outSmolvData = (const uint8_t*)archiveData + offset;
+	if (outSmolvSize)
+		*outSmolvSize = size;
+	if (outDecodedSize)
+		*outDecodedSize = smolv_Get4(entry + 16);
 	return true;
 }
 
+bool smolv::ArchiveDecode(const void* archiveData, size_t archiveSize, size_t index, void* spirvOutputBuffer, size_t spirvOutputBufferSize, uint32_t flags, const Dictionary* dictionary)
+{
+	const void* smolvData;
+	size_t smolvSize;
+	if (!ArchiveGetEntry(archiveData, archiveSize, index, NULL, &smolvData, &smolvSize, NULL))
+		return false;
+	return Decode(smolvData, smolvSize, spirvOutputBuffer, spirvOutputBufferSize, flags, dictionary);
+}
+
 
 
 // --------------------------------------------------------------------------------------------
 // Calculating instruction count / space stats on SPIR-V and SMOL-V
 
 
+// Which part of the SMOL-V encoding bytes come from
+enum smolv_StatsByteClass
+{
+	kSmolvStatsLengthOp = 0, // length + op token
+	kSmolvStatsType, // type ID
+	kSmolvStatsResult, // result ID delta
+	kSmolvStatsRelativeIds, // other IDs, relative to the result (or to previous decoration target)
+	kSmolvStatsMemberDecorate, // runs of MemberDecorate, after the target ID
+	kSmolvStatsVarRest, // other varint encoded operands (literals, enums, constant values, ExtInst numbers etc.)
+	kSmolvStatsLiterals, // raw literal words
+	kSmolvStatsSwizzle, // compact VectorShuffle swizzle byte
+	kSmolvStatsByteClassCount
+};
+
+static const char* kSmolvStatsByteClassNames[kSmolvStatsByteClassCount] =
+{
+	"lengthOp", "type", "result", "relativeIds", "memberDecorate", "varRest", "literals", "swizzle",
+};
+
+// Stats have a row for each known op, then each sparse op, then one for all the other (unknown) ops
+static const int kSmolvStatsOpRowCount = kKnownOpsCount + kSparseOpsCount + 1;
+
+static int smolv_StatsOpRow(uint32_t op)
+{
+	if (op < (uint32_t)kKnownOpsCount)
+		return op;
+	int lo = 0, hi = kSparseOpsCount;
+	while (lo < hi)
+	{
+		const int mid = (lo + hi) / 2;
+		if (kSpirvOpDataSparse[mid].op < op)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < kSparseOpsCount && kSpirvOpDataSparse[lo].op == op)
+		return kKnownOpsCount + lo;
+	return kSmolvStatsOpRowCount - 1;
+}
+
+// SPIR-V op value of a stats row; -1 for the row of unknown ops
+static int smolv_StatsRowOp(int row)
+{
+	if (row < kKnownOpsCount)
+		return row;
+	if (row < kKnownOpsCount + kSparseOpsCount)
+		return kSpirvOpDataSparse[row - kKnownOpsCount].op;
+	return -1;
+}
+
+static const char* smolv_StatsOpName(int row)
+{
+	if (row == SpvOpDictionaryRef)
+		return "DictionaryRef";
+	if (row < kKnownOpsCount)
+		return kSpirvOpNames[row];
+	if (row < kKnownOpsCount + kSparseOpsCount)
+		return kSpirvOpDataSparse[row - kKnownOpsCount].name;
+	return "Other";
+}
+
 struct smolv::Stats
 {
 	Stats() { memset(this, 0, sizeof(*this)); }
-	size_t opCounts[kKnownOpsCount];
-	size_t opSizes[kKnownOpsCount];
-	size_t smolOpSizes[kKnownOpsCount];
+	// only counters (size_t) in here, see StatsMerge
+	// per op row, see smolv_StatsOpRow
+	size_t opCounts[kSmolvStatsOpRowCount];
+	size_t opSizes[kSmolvStatsOpRowCount];
+	size_t smolOpCounts[kSmolvStatsOpRowCount]; // a run of MemberDecorate is one
+	size_t smolOpSizes[kSmolvStatsOpRowCount];
+	size_t smolOpClassSizes[kSmolvStatsOpRowCount][kSmolvStatsByteClassCount];
 	size_t varintCountsOp[6];
 	size_t varintCountsType[6];
 	size_t varintCountsRes[6];
@@ -1849,11 +6386,9 @@ bool smolv::StatsCalculate(smolv::Stats* stats, const void* spirvData, size_t sp
 	{
 		_SMOLV_READ_OP(instrLen, words, op);
 
-		if (op < kKnownOpsCount)
-		{
-			stats->opCounts[op]++;
-			stats->opSizes[op] += instrLen;
-		}
+		const int row = smolv_StatsOpRow(op);
+		stats->opCounts[row]++;
+		stats->opSizes[row] += instrLen;
 		words += instrLen;
 		stats->totalOps++;
 	}
@@ -1862,145 +6397,315 @@ bool smolv::StatsCalculate(smolv::Stats* stats, const void* spirvData, size_t sp
 }
 
 
-bool smolv::StatsCalculateSmol(smolv::Stats* stats, const void* smolvData, size_t smolvSize)
+// Reads a varint from the given stream of instructions, counts its length (if counts is not null), and
+// adds it to the byte class sizes
+template<typename Input>
+static bool smolv_StatsReadVarint(Input& in, int stream, size_t* counts, size_t& classSize)
 {
-	if (!stats)
+	const uint8_t* varBegin = in.Get(stream);
+	uint32_t val;
+	if (!in.ReadVarint(stream, val))
 		return false;
+	const size_t len = in.Get(stream) - varBegin;
+	if (len > 5)
+		return false; // malformed, too long varint
+	if (counts)
+		counts[len]++;
+	classSize += len;
+	return true;
+}
+
+static void smolv_StatsAddInstruction(smolv::Stats* stats, SpvOp op, const size_t classSizes[kSmolvStatsByteClassCount])
+{
+	const int row = smolv_StatsOpRow(op);
+	stats->smolOpCounts[row]++;
+	for (int c = 0; c < kSmolvStatsByteClassCount; ++c)
+	{
+		stats->smolOpSizes[row] += classSizes[c];
+		stats->smolOpClassSizes[row][c] += classSizes[c];
+	}
+}
 
-	// debugging helper to dump all encoded bytes to stdout, keep at "if 0"
+template<typename Input>
+static bool smolv_StatsCalculateInstructions(smolv::Stats* stats, Input& in, const smolv_OpTable* opTable, bool usesDictionary)
+{
+	// debugging helper to dump encoded instruction sizes to stdout, keep at "if 0"
 #	if 0
 #		define _SMOLV_DEBUG_PRINT_ENCODED_BYTES() { \
-			printf("Op %-22s ", op < kKnownOpsCount ? kSpirvOpNames[op] : "???"); \
-			for (const uint8_t* b = instrBegin; b < bytes; ++b) \
-				printf("%02x ", *b); \
-			printf("\n"); \
+			printf("Op %-22s %i bytes\n", smolv_StatsOpName(smolv_StatsOpRow(op)), int(in.Position() - instrBegin)); \
 		}
 #	else
 #		define _SMOLV_DEBUG_PRINT_ENCODED_BYTES() {}
 #	endif
-	
-	const uint8_t* bytes = (const uint8_t*)smolvData;
-	const uint8_t* bytesEnd = bytes + smolvSize;
-	if (!smolv_CheckSmolHeader(bytes, smolvSize))
-		return false;
 
 	uint32_t val;
-	int smolVersion;
-	bytes += 4;
-	smolv_Read4(bytes, bytesEnd, val); smolVersion = val >> 24;
-	const int knownOpsCount = smolv_GetKnownOpsCount(smolVersion);
-	bytes += 16;
-	
-	stats->totalSizeSmol += smolvSize;
-	
-	while (bytes < bytesEnd)
+	while (!in.AtEnd())
 	{
-		const uint8_t* instrBegin = bytes;
-		const uint8_t* varBegin;
+		const size_t instrBegin = in.Position();
+		(void)instrBegin;
+		size_t sizes[kSmolvStatsByteClassCount] = {};
 
 		// read length + opcode
 		uint32_t instrLen;
 		SpvOp op;
-		varBegin = bytes;
-		if (!smolv_ReadLengthOp(bytes, bytesEnd, instrLen, op))
+		smolv_OpDesc desc;
+		const uint8_t* varBegin = in.Get(kSmolvStreamOps);
+		if (!smolv_ReadLengthOp(in.Get(kSmolvStreamOps), in.End(kSmolvStreamOps), opTable, instrLen, op, desc))
 			return false;
 		const bool wasSwizzle = (op == SpvOpVectorShuffleCompact);
 		if (wasSwizzle)
 			op = SpvOpVectorShuffle;
-		stats->varintCountsOp[bytes-varBegin]++;
+		sizes[kSmolvStatsLengthOp] = in.Get(kSmolvStreamOps) - varBegin;
+		if (sizes[kSmolvStatsLengthOp] > 5)
+			return false; // malformed, too long varint
+		stats->varintCountsOp[sizes[kSmolvStatsLengthOp]]++;
+		if (desc.flags & kSmolvOpExtInst)
+		{
+			if (!smolv_StatsReadVarint(in, kSmolvStreamOps, stats->varintCountsType, sizes[kSmolvStatsType])) return false;
+			if (!smolv_StatsReadVarint(in, kSmolvStreamIds, stats->varintCountsRes, sizes[kSmolvStatsResult])) return false;
+			if (op == SpvOpExtInstWithSet)
+			{
+				if (!smolv_StatsReadVarint(in, kSmolvStreamVarRest, NULL, sizes[kSmolvStatsVarRest])) return false;
+				op = SpvOpExtInst;
+			}
+			if (!smolv_StatsReadVarint(in, kSmolvStreamVarRest, stats->varintCountsOther, sizes[kSmolvStatsVarRest])) return false;
+			for (uint32_t i = 5; i < instrLen; ++i)
+			{
+				if (!smolv_StatsReadVarint(in, kSmolvStreamIds, stats->varintCountsOther, sizes[kSmolvStatsRelativeIds])) return false;
+			}
+			smolv_StatsAddInstruction(stats, op, sizes);
+			_SMOLV_DEBUG_PRINT_ENCODED_BYTES();
+			continue;
+		}
+		if (desc.flags & kSmolvOpConstant)
+		{
+			// one varint per literal word, whatever the type is
+			if (!smolv_StatsReadVarint(in, kSmolvStreamOps, stats->varintCountsType, sizes[kSmolvStatsType])) return false;
+			if (!smolv_StatsReadVarint(in, kSmolvStreamIds, stats->varintCountsRes, sizes[kSmolvStatsResult])) return false;
+			for (uint32_t i = 3; i < instrLen; ++i)
+			{
+				if (!smolv_StatsReadVarint(in, kSmolvStreamVarRest, stats->varintCountsOther, sizes[kSmolvStatsVarRest])) return false;
+			}
+			smolv_StatsAddInstruction(stats, op, sizes);
+			_SMOLV_DEBUG_PRINT_ENCODED_BYTES();
+			continue;
+		}
+
+		// dictionary reference: just the starting instruction index
+		if (op == SpvOpDictionaryRef && usesDictionary)
+		{
+			if (!smolv_StatsReadVarint(in, kSmolvStreamVarRest, NULL, sizes[kSmolvStatsVarRest])) return false;
+			smolv_StatsAddInstruction(stats, op, sizes);
+			_SMOLV_DEBUG_PRINT_ENCODED_BYTES();
+			continue;
+		}
 		
 		size_t ioffs = 1;
-		if (smolv_OpHasType(op, knownOpsCount))
+		if (desc.flags & kSmolvOpHasType)
 		{
-			varBegin = bytes;
-			if (!smolv_ReadVarint(bytes, bytesEnd, val)) return false;
-			stats->varintCountsType[bytes-varBegin]++;
+			if (!smolv_StatsReadVarint(in, kSmolvStreamOps, stats->varintCountsType, sizes[kSmolvStatsType])) return false;
 			ioffs++;
 		}
-		if (smolv_OpHasResult(op, knownOpsCount))
+		if (desc.flags & kSmolvOpHasResult)
 		{
-			varBegin = bytes;
-			if (!smolv_ReadVarint(bytes, bytesEnd, val)) return false;
-			stats->varintCountsRes[bytes-varBegin]++;
+			if (!smolv_StatsReadVarint(in, kSmolvStreamIds, stats->varintCountsRes, sizes[kSmolvStatsResult])) return false;
 			ioffs++;
 		}
 		
-		if (op == SpvOpDecorate || op == SpvOpMemberDecorate)
+		if (desc.flags & kSmolvOpRelativeToDecorate)
 		{
-			if (!smolv_ReadVarint(bytes, bytesEnd, val)) return false;
+			if (!smolv_StatsReadVarint(in, kSmolvStreamIds, NULL, sizes[kSmolvStatsRelativeIds])) return false;
 			ioffs++;
 		}
 		// MemberDecorate special decoding
 		if (op == SpvOpMemberDecorate)
 		{
-			if (bytes >= bytesEnd)
+			const size_t runBegin = in.Position();
+			uint32_t count;
+			if (!in.ReadByte(kSmolvStreamOps, count))
 				return false; // broken input
-			int count = *bytes++;
-			for (int m = 0; m < count; ++m)
+			for (uint32_t m = 0; m < count; ++m)
 			{
 				uint32_t memberIndex;
-				if (!smolv_ReadVarint(bytes, bytesEnd, memberIndex)) return false;
+				if (!in.ReadVarint(kSmolvStreamVarRest, memberIndex)) return false;
 				uint32_t memberDec;
-				if (!smolv_ReadVarint(bytes, bytesEnd, memberDec)) return false;
+				if (!in.ReadVarint(kSmolvStreamVarRest, memberDec)) return false;
 				const int knownExtraOps = smolv_DecorationExtraOps(memberDec);
 				uint32_t memberLen;
 				if (knownExtraOps == -1)
 				{
-					if (!smolv_ReadVarint(bytes, bytesEnd, memberLen)) return false;
+					if (!in.ReadVarint(kSmolvStreamVarRest, memberLen)) return false;
 					memberLen += 4;
 				}
 				else
 					memberLen = 4 + knownExtraOps;
 				for (uint32_t i = 4; i < memberLen; ++i)
 				{
-					if (!smolv_ReadVarint(bytes, bytesEnd, val)) return false;
+					if (!in.ReadVarint(kSmolvStreamVarRest, val)) return false;
 				}
 			}
-			stats->smolOpSizes[op] += bytes - instrBegin;
+			sizes[kSmolvStatsMemberDecorate] = in.Position() - runBegin;
+			smolv_StatsAddInstruction(stats, op, sizes);
 			_SMOLV_DEBUG_PRINT_ENCODED_BYTES();
 			continue;
 		}
 
-		int relativeCount = smolv_OpDeltaFromResult(op, knownOpsCount);
+		int relativeCount = desc.deltaFromResult;
 		for (int i = 0; i < relativeCount && ioffs < instrLen; ++i, ++ioffs)
 		{
-			varBegin = bytes;
-			if (!smolv_ReadVarint(bytes, bytesEnd, val)) return false;
-			stats->varintCountsRes[bytes-varBegin]++;
+			if (!smolv_StatsReadVarint(in, kSmolvStreamIds, stats->varintCountsRes, sizes[kSmolvStatsRelativeIds])) return false;
 		}
 
 		if (wasSwizzle && instrLen <= 9)
 		{
-			bytes++;
+			if (!in.ReadByte(kSmolvStreamOps, val)) return false;
+			sizes[kSmolvStatsSwizzle] = 1;
 		}
-		else if (smolv_OpVarRest(op, knownOpsCount))
+		else if (desc.flags & kSmolvOpVarRest)
 		{
 			for (; ioffs < instrLen; ++ioffs)
 			{
-				varBegin = bytes;
-				if (!smolv_ReadVarint(bytes, bytesEnd, val)) return false;
-				stats->varintCountsOther[bytes-varBegin]++;
+				if (!smolv_StatsReadVarint(in, kSmolvStreamVarRest, stats->varintCountsOther, sizes[kSmolvStatsVarRest])) return false;
 			}
 		}
 		else
 		{
 			for (; ioffs < instrLen; ++ioffs)
 			{
-				if (!smolv_Read4(bytes, bytesEnd, val)) return false;
+				if (!in.Read4(kSmolvStreamLiterals, val)) return false;
+				sizes[kSmolvStatsLiterals] += 4;
 			}
 		}
 		
-		if (op < kKnownOpsCount)
-		{
-			stats->smolOpSizes[op] += bytes - instrBegin;
-		}
+		smolv_StatsAddInstruction(stats, op, sizes);
 		_SMOLV_DEBUG_PRINT_ENCODED_BYTES();
 	}
-	
+#	undef _SMOLV_DEBUG_PRINT_ENCODED_BYTES
 	return true;
 }
 
-static bool CompareOpCounters (std::pair<SpvOp,size_t> a, std::pair<SpvOp,size_t> b)
+bool smolv::StatsCalculateSmol(smolv::Stats* stats, const void* smolvData, size_t smolvSize)
+{
+	if (!stats)
+		return false;
+
+	const uint8_t* bytes = (const uint8_t*)smolvData;
+	const uint8_t* bytesEnd = bytes + smolvSize;
+	if (!smolv_CheckSmolHeader(bytes, smolvSize))
+		return false;
+
+	const int smolVersion = ((const uint32_t*)smolvData)[1] >> 24;
+	const smolv_OpTable* opTable = &smolv_GetOpTables(smolVersion).decode;
+	const bool usesDictionary = smolVersion >= kSmolFeaturesEncodingVersion && (((const uint32_t*)smolvData)[6] & kSmolFeatureDictionary);
+	const size_t headerSize = smolv_GetSmolHeaderSize(bytes, smolvSize);
+	bytes += headerSize;
+	// per-instruction sizes are counted before entropy coding
+	ByteArray entropyDecoded;
+	if (!smolv_EntropyDecodeInstructions((const uint8_t*)smolvData, bytes, bytesEnd, entropyDecoded))
+		return false;
+	
+	stats->totalSizeSmol += smolvSize;
+
+	uint32_t streamSizes[kSmolvStreamCount];
+	if (smolv_IsSplitStreams((const uint8_t*)smolvData, headerSize, streamSizes))
+	{
+		smolv_SplitDecodeInput in;
+		return smolv_SplitStreams(streamSizes, bytes, bytesEnd, in) && smolv_StatsCalculateInstructions(stats, in, opTable, usesDictionary);
+	}
+	smolv_DecodeInput in = { bytes, bytesEnd };
+	return smolv_StatsCalculateInstructions(stats, in, opTable, usesDictionary);
+}
+
+void smolv::StatsMerge(smolv::Stats* stats, const smolv::Stats* other)
+{
+	if (!stats || !other)
+		return;
+	// all the fields are counters
+	size_t* dst = (size_t*)stats;
+	const size_t* src = (const size_t*)other;
+	for (size_t i = 0; i < sizeof(Stats) / sizeof(size_t); ++i)
+		dst[i] += src[i];
+}
+
+
+// Programs are split into chunks (not per thread: a user provided parallelFor does not say which thread
+// a task runs on), each collected into its own Stats and merged at the end.
+static const size_t kSmolvStatsChunkCount = 64;
+
+struct smolv_StatsBatchData
+{
+	const void* const* datas;
+	const size_t* sizes;
+	size_t count;
+	bool smol;
+	size_t chunkCount;
+	smolv::Stats* chunkStats[kSmolvStatsChunkCount];
+	std::atomic<bool> failed;
+};
+
+static void smolv_StatsBatchTask(void* taskData, size_t index)
+{
+	smolv_StatsBatchData* data = (smolv_StatsBatchData*)taskData;
+	smolv::Stats* stats = data->chunkStats[index];
+	bool ok = true;
+	for (size_t i = index; i < data->count; i += data->chunkCount)
+	{
+		if (data->smol)
+			ok &= smolv::StatsCalculateSmol(stats, data->datas[i], data->sizes[i]);
+		else
+			ok &= smolv::StatsCalculate(stats, data->datas[i], data->sizes[i]);
+	}
+	if (!ok)
+		data->failed = true;
+}
+
+static bool smolv_StatsCalculateBatch(smolv::Stats* stats, const void* const* datas, const size_t* sizes, size_t count, bool smol, int threadCount, smolv::ParallelForFunc parallelFor, void* parallelForUserData)
+{
+	if (!stats)
+		return false;
+	if (count == 0)
+		return true;
+	if (!datas || !sizes)
+		return false;
+
+	smolv_StatsBatchData data;
+	data.datas = datas;
+	data.sizes = sizes;
+	data.count = count;
+	data.smol = smol;
+	data.failed = false;
+	// a few chunks per thread on the built-in thread pool, for load balancing
+	size_t chunkCount = kSmolvStatsChunkCount;
+	if (!parallelFor)
+	{
+		if (threadCount <= 0)
+			threadCount = (int)std::thread::hardware_concurrency();
+		chunkCount = std::min(chunkCount, std::max<size_t>(threadCount, 1) * 4);
+	}
+	chunkCount = std::min(chunkCount, count);
+	data.chunkCount = chunkCount;
+	for (size_t i = 0; i < chunkCount; ++i)
+		data.chunkStats[i] = smolv::StatsCreate();
+	smolv_RunParallel(chunkCount, smolv_StatsBatchTask, &data, threadCount, parallelFor, parallelForUserData);
+	for (size_t i = 0; i < chunkCount; ++i)
+	{
+		smolv::StatsMerge(stats, data.chunkStats[i]);
+		smolv::StatsDelete(data.chunkStats[i]);
+	}
+	return !data.failed;
+}
+
+bool smolv::StatsCalculateBatch(Stats* stats, const void* const* spirvDatas, const size_t* spirvSizes, size_t spirvCount, int threadCount, ParallelForFunc parallelFor, void* parallelForUserData)
+{
+	return smolv_StatsCalculateBatch(stats, spirvDatas, spirvSizes, spirvCount, false, threadCount, parallelFor, parallelForUserData);
+}
+
+bool smolv::StatsCalculateSmolBatch(Stats* stats, const void* const* smolvDatas, const size_t* smolvSizes, size_t smolvCount, int threadCount, ParallelForFunc parallelFor, void* parallelForUserData)
+{
+	return smolv_StatsCalculateBatch(stats, smolvDatas, smolvSizes, smolvCount, true, threadCount, parallelFor, parallelForUserData);
+}
+
+static bool CompareOpCounters (std::pair<int,size_t> a, std::pair<int,size_t> b)
 {
 	return a.second > b.second;
 }
@@ -2010,37 +6715,37 @@ void smolv::StatsPrint(const Stats* stats)
 	if (!stats)
 		return;
 
-	typedef std::pair<SpvOp,size_t> OpCounter;
-	OpCounter counts[kKnownOpsCount];
-	OpCounter sizes[kKnownOpsCount];
-	OpCounter sizesSmol[kKnownOpsCount];
-	for (int i = 0; i < kKnownOpsCount; ++i)
+	typedef std::pair<int,size_t> OpCounter;
+	OpCounter counts[kSmolvStatsOpRowCount];
+	OpCounter sizes[kSmolvStatsOpRowCount];
+	OpCounter sizesSmol[kSmolvStatsOpRowCount];
+	for (int i = 0; i < kSmolvStatsOpRowCount; ++i)
 	{
-		counts[i].first = (SpvOp)i;
+		counts[i].first = i;
 		counts[i].second = stats->opCounts[i];
-		sizes[i].first = (SpvOp)i;
+		sizes[i].first = i;
 		sizes[i].second = stats->opSizes[i];
-		sizesSmol[i].first = (SpvOp)i;
+		sizesSmol[i].first = i;
 		sizesSmol[i].second = stats->smolOpSizes[i];
 	}
-	std::sort(counts, counts + kKnownOpsCount, CompareOpCounters);
-	std::sort(sizes, sizes + kKnownOpsCount, CompareOpCounters);
-	std::sort(sizesSmol, sizesSmol + kKnownOpsCount, CompareOpCounters);
+	std::sort(counts, counts + kSmolvStatsOpRowCount, CompareOpCounters);
+	std::sort(sizes, sizes + kSmolvStatsOpRowCount, CompareOpCounters);
+	std::sort(sizesSmol, sizesSmol + kSmolvStatsOpRowCount, CompareOpCounters);
 	
 	printf("Stats for %i SPIR-V inputs, total size %i words (%.1fKB):\n", (int)stats->inputCount, (int)stats->totalSize, stats->totalSize * 4.0f / 1024.0f);
 	printf("Most occuring ops:\n");
 	for (int i = 0; i < 30; ++i)
 	{
-		SpvOp op = counts[i].first;
-		printf(" #%2i: %4i %-20s %4i (%4.1f%%)\n", i, op, kSpirvOpNames[op], (int)counts[i].second, (float)counts[i].second / (float)stats->totalOps * 100.0f);
+		const int op = counts[i].first;
+		printf(" #%2i: %4i %-20s %4i (%4.1f%%)\n", i, smolv_StatsRowOp(op), smolv_StatsOpName(op), (int)counts[i].second, (float)counts[i].second / (float)stats->totalOps * 100.0f);
 	}
 	printf("Largest total size of ops:\n");
 	for (int i = 0; i < 30; ++i)
 	{
-		SpvOp op = sizes[i].first;
+		const int op = sizes[i].first;
 		printf(" #%2i: %-22s %6i (%4.1f%%) avg len %.1f\n",
 			   i,
-			   kSpirvOpNames[op],
+			   smolv_StatsOpName(op),
 			   (int)sizes[i].second*4,
 			   (float)sizes[i].second / (float)stats->totalSize * 100.0f,
 			   (float)sizes[i].second*4 / (float)stats->opCounts[op]
@@ -2055,10 +6760,10 @@ void smolv::StatsPrint(const Stats* stats)
 	printf("Largest total size of ops in SMOL:\n");
 	for (int i = 0; i < 30; ++i)
 	{
-		SpvOp op = sizesSmol[i].first;
+		const int op = sizesSmol[i].first;
 		printf(" #%2i: %-22s %6i (%4.1f%%) avg len %.1f\n",
 			   i,
-			   kSpirvOpNames[op],
+			   smolv_StatsOpName(op),
 			   (int)sizesSmol[i].second,
 			   (float)sizesSmol[i].second / (float)stats->totalSizeSmol * 100.0f,
 			   (float)sizesSmol[i].second / (float)stats->opCounts[op]
@@ -2067,6 +6772,82 @@ void smolv::StatsPrint(const Stats* stats)
 }
 
 
+static void smolv_AppendText(smolv::ByteArray& out, const char* format, ...)
+{
+	char buffer[256];
+	va_list args;
+	va_start(args, format);
+	int len = vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	if (len > 0)
+		out.insert(out.end(), buffer, buffer + std::min<size_t>(len, sizeof(buffer) - 1));
+}
+
+void smolv::StatsExportJson(const Stats* stats, ByteArray& outText)
+{
+	if (!stats)
+		return;
+	smolv_AppendText(outText, "{\n\t\"inputs\": %zu,\n\t\"instructions\": %zu,\n\t\"spirvBytes\": %zu,\n\t\"smolvBytes\": %zu,\n",
+		stats->inputCount, stats->totalOps, stats->totalSize * 4, stats->totalSizeSmol);
+
+	// SMOL-V instruction bytes, per kind of encoded field
+	smolv_AppendText(outText, "\t\"smolvClassBytes\": {");
+	for (int c = 0; c < kSmolvStatsByteClassCount; ++c)
+	{
+		size_t size = 0;
+		for (int op = 0; op < kSmolvStatsOpRowCount; ++op)
+			size += stats->smolOpClassSizes[op][c];
+		smolv_AppendText(outText, "%s\"%s\": %zu", c ? ", " : " ", kSmolvStatsByteClassNames[c], size);
+	}
+	smolv_AppendText(outText, " },\n");
+
+	// varint counts per byte length (1-5)
+	const char* varintNames[] = { "op", "type", "result", "other" };
+	const size_t* varintCounts[] = { stats->varintCountsOp, stats->varintCountsType, stats->varintCountsRes, stats->varintCountsOther };
+	smolv_AppendText(outText, "\t\"varintLengths\": {");
+	for (int v = 0; v < 4; ++v)
+	{
+		smolv_AppendText(outText, "%s\"%s\": [%zu, %zu, %zu, %zu, %zu]", v ? ", " : " ", varintNames[v],
+			varintCounts[v][1], varintCounts[v][2], varintCounts[v][3], varintCounts[v][4], varintCounts[v][5]);
+	}
+	smolv_AppendText(outText, " },\n");
+
+	// per op, only the ones that were seen
+	smolv_AppendText(outText, "\t\"ops\": [");
+	bool first = true;
+	for (int op = 0; op < kSmolvStatsOpRowCount; ++op)
+	{
+		if (stats->opCounts[op] == 0 && stats->smolOpCounts[op] == 0)
+			continue;
+		smolv_AppendText(outText, "%s\n\t\t{ \"op\": \"%s\", \"value\": %i, \"count\": %zu, \"spirvBytes\": %zu, \"smolvCount\": %zu, \"smolvBytes\": %zu",
+			first ? "" : ",", smolv_StatsOpName(op), smolv_StatsRowOp(op), stats->opCounts[op], stats->opSizes[op] * 4, stats->smolOpCounts[op], stats->smolOpSizes[op]);
+		for (int c = 0; c < kSmolvStatsByteClassCount; ++c)
+			smolv_AppendText(outText, ", \"%s\": %zu", kSmolvStatsByteClassNames[c], stats->smolOpClassSizes[op][c]);
+		smolv_AppendText(outText, " }");
+		first = false;
+	}
+	smolv_AppendText(outText, "\n\t]\n}\n");
+}
+
+void smolv::StatsExportCsv(const Stats* stats, ByteArray& outText)
+{
+	if (!stats)
+		return;
+	smolv_AppendText(outText, "op,value,count,spirvBytes,smolvCount,smolvBytes");
+	for (int c = 0; c < kSmolvStatsByteClassCount; ++c)
+		smolv_AppendText(outText, ",%s", kSmolvStatsByteClassNames[c]);
+	smolv_AppendText(outText, "\n");
+	for (int op = 0; op < kSmolvStatsOpRowCount; ++op)
+	{
+		if (stats->opCounts[op] == 0 && stats->smolOpCounts[op] == 0)
+			continue;
+		smolv_AppendText(outText, "%s,%i,%zu,%zu,%zu,%zu", smolv_StatsOpName(op), smolv_StatsRowOp(op), stats->opCounts[op], stats->opSizes[op] * 4, stats->smolOpCounts[op], stats->smolOpSizes[op]);
+		for (int c = 0; c < kSmolvStatsByteClassCount; ++c)
+			smolv_AppendText(outText, ",%zu", stats->smolOpClassSizes[op][c]);
+		smolv_AppendText(outText, "\n");
+	}
+}
+
 // ------------------------------------------------------------------------------
 // This software is available under 2 licenses -- choose whichever you prefer.
 // ------------------------------------------------------------------------------
@@ -65,12 +65,18 @@ namespace smolv
 	enum EncodeFlags
 	{
 		kEncodeFlagNone = 0,
-		kEncodeFlagStripDebugInfo = (1<<0), // Strip all optional SPIR-V instructions (debug names etc.)
+		kEncodeFlagStripDebugInfo = (1<<0), // Strip all optional SPIR-V instructions (debug names etc., and NonSemantic.Shader.DebugInfo.100 instructions)
+		kEncodeFlagEntropyCode = (1<<1), // Entropy code the result (Huffman); about 25% smaller, if not compressing the data further anyway
+		kEncodeFlagSplitStreams = (1<<2), // Write each kind of instruction fields (ops, IDs, literals etc.) into a separate stream; compresses better
+		kEncodeFlagContentHash = (1<<3), // Store a 64 bit hash of the (possibly stripped) SPIR-V in the header, see GetContentHash
+		kEncodeFlagCanonicalizeIds = (1<<4), // Renumber IDs in the order they are defined in; smaller, and same programs with different ID numbering encode the same
 	};
 	enum DecodeFlags
 	{
 		kDecodeFlagNone = 0,
 		kDecodeFlagUse20160831AsZeroVersion = (1 << 0), // For "version zero" of SMOL-V encoding, use 2016 08 31 code path (this is what happens to be used by Unity 2017-2020)
+		kDecodeFlagVerifyHash = (1 << 1), // Check decoded SPIR-V against the hash stored with kEncodeFlagContentHash; fail if it does not match or there is none
+		kDecodeFlagTrusted = (1 << 2), // Input was checked with Validate before; skip end-of-data checks while decoding. Never use on untrusted data!
 	};
 
 	// Preserve *some* OpName debug names.
@@ -78,6 +84,9 @@ namespace smolv
 	// This is really only used to implement a workaround for problems with some Vulkan drivers.
 	typedef bool(*StripOpNameFilterFunc)(const char* name);
 
+	// Shared dictionary of instructions that are common to many programs; see "Dictionaries" below.
+	struct Dictionary;
+
 	// -------------------------------------------------------------------
 	// Encoding / Decoding
 
@@ -87,9 +96,52 @@ namespace smolv
 	//
 	// flags is bitset of EncodeFlags values.
 	//
+	// If dictionary is passed, instructions that match ones in the dictionary are encoded as
+	// references into it; the same dictionary is then needed to decode the data.
+	//
+	// With kEncodeFlagEntropyCode, the encoded instructions are further entropy coded (only if that
+	// makes the data smaller). Decoding such data needs no flags, but Decode has to allocate a
+	// temporary buffer for it. If you are going to compress the SMOL-V data with a general purpose
+	// compressor (zstd, LZ4 etc.) anyway, don't use this flag.
+	//
+	// With kEncodeFlagSplitStreams, instead of interleaving all the encoded fields of each instruction,
+	// fields of the same kind (op codes and type IDs, result and operand IDs, other small values and raw
+	// literal words) are written one after another, each kind into its own part of the data. The size
+	// is about the same, but general purpose compressors do better on such data (e.g. about 7% smaller
+	// with zlib). Decoding such data needs no flags.
+	//
+	// If restartInterval is not zero, restart points are placed into the program, about every restartInterval
+	// bytes of SPIR-V (at least 1KB apart). Blocks of instructions between them can be decoded independently,
+	// see DecodeParallel; useful for large programs where decoding latency of a single one matters. Each
+	// restart point costs 8 bytes in the header, plus a few bytes of encoding that gets worse right after it.
+	// Restart points are not used with kEncodeFlagSplitStreams.
+	//
+	// With kEncodeFlagContentHash, ContentHash of the SPIR-V program that decoding will produce (i.e. without
+	// the stripped instructions) is stored in the header; 8 bytes. GetContentHash gets it without
+	// decoding anything, e.g. to look up a pipeline cache first and only decode on a miss.
+	//
+	// With kEncodeFlagCanonicalizeIds, result IDs are renumbered in the order they are defined in (and the ID
+	// bound made as small as possible), so decoding produces the same program, but with different ID values.
+	// Deltas between IDs get smaller, so the result is smaller, and programs that only differ in ID numbering
+	// (e.g. from different compiler versions) encode into the same data. IDs are not renumbered in programs
+	// with ops (or extended instruction sets other than GLSL.std.450 and NonSemantic.*) that SMOL-V does not
+	// know the operands of. When using a dictionary, pass this flag to DictionaryTrain too.
+	//
 	// Returns false on malformed SPIR-V input; if that happens the output array might get
 	// partial/broken SMOL-V program.
-	bool Encode(const void* spirvData, size_t spirvSize, ByteArray& outSmolv, uint32_t flags = kEncodeFlagNone, StripOpNameFilterFunc stripFilter = 0);
+	bool Encode(const void* spirvData, size_t spirvSize, ByteArray& outSmolv, uint32_t flags = kEncodeFlagNone, StripOpNameFilterFunc stripFilter = 0, const Dictionary* dictionary = 0, size_t restartInterval = 0);
+
+	// Encode SPIR-V into SMOL-V, into a caller-provided buffer.
+	//
+	// The buffer must be at least GetEncodeBoundSize(spirvSize) bytes; actual size of the
+	// encoded SMOL-V program is returned in outSmolvWritten. Encoding this way does no memory
+	// allocations, except with kEncodeFlagSplitStreams or restart points.
+	//
+	// Returns false on malformed SPIR-V input or too small output buffer.
+	bool Encode(const void* spirvData, size_t spirvSize, void* outSmolv, size_t outSmolvSize, size_t* outSmolvWritten, uint32_t flags = kEncodeFlagNone, StripOpNameFilterFunc stripFilter = 0, const Dictionary* dictionary = 0, size_t restartInterval = 0);
+
+	// Given a SPIR-V program size, get the worst case size of the encoded SMOL-V program.
+	size_t GetEncodeBoundSize(size_t spirvSize);
 
 
 	// Decode SMOL-V into SPIR-V.
@@ -98,14 +150,44 @@ namespace smolv
 	// GetDecodeBufferSize; this is the size of decoded SPIR-V program.
 	//
 	// flags is bitset of DecodeFlags values.
-
-	// Decoding does no memory allocations.
+	//
+	// If the program was encoded with a dictionary, the same dictionary has to be passed.
+	//
+	// Decoding does no memory allocations, except for entropy coded (kEncodeFlagEntropyCode) programs.
+	//
+	// With kDecodeFlagVerifyHash, the decoded program is hashed right after decoding (while it is still in
+	// the cache) and checked against the hash stored in the header. This applies to all functions that decode
+	// whole programs (DecodeStream hashes the output as it goes); partial decoding ignores it.
+	//
+	// With kDecodeFlagTrusted, most of the checks against malformed input are skipped (reading past the end
+	// of data, mostly). Only use it for data that passed Validate before (with the same flags and dictionary),
+	// e.g. when it was checked at download/install time and is now loaded from your own signed archive;
+	// otherwise malformed data can make decoding read out of bounds. The flag is ignored when decoding split
+	// streams (kEncodeFlagSplitStreams) data, by DecodeStream, and by partial decoding.
 	//
 	// Returns false on malformed input; if that happens the output buffer might be only partially
 	// written to.
-	bool Decode(const void* smolvData, size_t smolvSize, void* spirvOutputBuffer, size_t spirvOutputBufferSize, uint32_t flags = kDecodeFlagNone);
+	bool Decode(const void* smolvData, size_t smolvSize, void* spirvOutputBuffer, size_t spirvOutputBufferSize, uint32_t flags = kDecodeFlagNone, const Dictionary* dictionary = 0);
 
 
+	// Check SMOL-V data fully, as if decoding it without kDecodeFlagTrusted (with kDecodeFlagVerifyHash too,
+	// if it has a content hash), and return whether it is valid. flags and dictionary should be the same as
+	// what will be used to decode it. Data that passes can be decoded with kDecodeFlagTrusted afterwards;
+	// remembering that it did (e.g. in your own archive/cache format) is up to you.
+	//
+	// Allocates a temporary buffer of the decoded program size.
+	bool Validate(const void* smolvData, size_t smolvSize, uint32_t flags = kDecodeFlagNone, const Dictionary* dictionary = 0);
+
+
+	// 64 bit hash of SPIR-V data: XXH64 with zero seed, so it matches what xxHash computes for it.
+	uint64_t ContentHash(const void* spirvData, size_t spirvSize);
+
+	// Get the hash stored in a SMOL-V program encoded with kEncodeFlagContentHash; same as ContentHash
+	// of the decoded program. Only looks at the header.
+	//
+	// Returns false on malformed input, or if the program has no hash stored.
+	bool GetContentHash(const void* smolvData, size_t smolvSize, uint64_t* outHash);
+
 	// Given a SMOL-V program, get size of the decoded SPIR-V program.
 	// This is the buffer size that Decode expects.
 	//
@@ -113,6 +195,297 @@ namespace smolv
 	size_t GetDecodedBufferSize(const void* smolvData, size_t smolvSize);
 
 
+	// -------------------------------------------------------------------
+	// Partial decoding, e.g. for reflection
+
+	// Sections of a SPIR-V module, in the order they are laid out (see "Logical Layout of a Module"
+	// in the SPIR-V spec).
+	enum ModuleSection
+	{
+		kSectionCapabilities = 0, // OpCapability, OpExtension, OpExtInstImport, OpMemoryModel
+		kSectionEntryPoints, // OpEntryPoint, OpExecutionMode(Id)
+		kSectionDebug, // OpString, OpSource*, OpName, OpMemberName, OpModuleProcessed
+		kSectionAnnotations, // decorations
+		kSectionTypes, // types, constants, global variables; everything else before the first OpFunction
+		kSectionFunctions, // OpFunction and everything after it
+	};
+
+	// Called for each decoded instruction; words point to the whole instruction (including the
+	// opcode/length word). Return false to stop decoding.
+	typedef bool(*DecodeInstructionFunc)(void* userData, const uint32_t* words, size_t wordCount);
+
+	// Decode only the start of a SMOL-V program, up to and including lastSection. The default
+	// is everything before function bodies, which is all that reflection (entry points, bindings,
+	// decorations, types) needs; decoding stops at the first OpFunction, and the rest of the
+	// input is not even looked at (except for entropy coded programs, which are entropy-decoded
+	// in full first).
+	//
+	// Output array is cleared, and gets the SPIR-V header plus the decoded instructions; it is a
+	// valid SPIR-V module only when lastSection is kSectionFunctions.
+	//
+	// Returns false on malformed input.
+	bool DecodeSections(const void* smolvData, size_t smolvSize, ByteArray& outSpirv, int lastSection = kSectionTypes, uint32_t flags = kDecodeFlagNone, const Dictionary* dictionary = 0);
+
+	// Same as above, but instead of collecting them into an array, passes the decoded instructions
+	// (without the SPIR-V header) one by one to instructionFunc.
+	bool DecodeSections(const void* smolvData, size_t smolvSize, DecodeInstructionFunc instructionFunc, void* userData, int lastSection = kSectionTypes, uint32_t flags = kDecodeFlagNone, const Dictionary* dictionary = 0);
+
+
+	// -------------------------------------------------------------------
+	// Reflection
+
+	enum
+	{
+		kReflectMaxEntryPoints = 8,
+		kReflectMaxBindings = 64,
+		kReflectMaxLocations = 32,
+		kReflectMaxSpecConstants = 32,
+		kReflectMaxNameLength = 64,
+	};
+
+	struct ReflectEntryPoint
+	{
+		uint32_t executionModel; // SpvExecutionModel
+		uint32_t id; // ID of the entry point function
+		char name[kReflectMaxNameLength]; // null terminated; cut off if longer
+	};
+
+	// Something decorated with DescriptorSet and/or Binding
+	struct ReflectBinding
+	{
+		uint32_t id; // variable ID
+		uint32_t storageClass; // SpvStorageClass of the variable; ~0u if no such variable was found
+		uint32_t set; // zero if there is no DescriptorSet decoration
+		uint32_t binding; // zero if there is no Binding decoration
+	};
+
+	// Something decorated with Location, e.g. a vertex input or fragment output
+	struct ReflectLocation
+	{
+		uint32_t id; // variable ID
+		uint32_t storageClass; // SpvStorageClass of the variable; ~0u if no such variable was found
+		uint32_t location;
+	};
+
+	// Specialization constant, decorated with SpecId
+	struct ReflectSpecConstant
+	{
+		uint32_t id; // ID of the OpSpecConstant* instruction
+		uint32_t specId;
+	};
+
+	// Plain data, no pointers; arrays are in the order things appear in the program.
+	struct Reflection
+	{
+		uint32_t entryPointCount;
+		uint32_t bindingCount;
+		uint32_t locationCount;
+		uint32_t specConstantCount;
+		uint32_t pushConstantSize; // size of the largest push constant block; zero if there are none
+		bool truncated; // program had more of something than fits into the arrays below, and these were left out
+		ReflectEntryPoint entryPoints[kReflectMaxEntryPoints];
+		ReflectBinding bindings[kReflectMaxBindings];
+		ReflectLocation locations[kReflectMaxLocations];
+		ReflectSpecConstant specConstants[kReflectMaxSpecConstants];
+	};
+
+	// Get reflection information out of a SMOL-V program without decoding it into SPIR-V, e.g. to set up
+	// pipeline layouts at load time without running SPIRV-Reflect or SPIRV-Cross over the decoded program.
+	// Only looks at the start of the program, up to function bodies (see DecodeSections).
+	//
+	// Push constant block size is the highest member Offset plus size of that member, no trailing
+	// padding; for matrix members their MatrixStride is used.
+	//
+	// Does not allocate memory (uses about 40KB of stack), except for entropy coded programs,
+	// and instructions larger than 4KB (e.g. debug info with embedded shader source).
+	//
+	// Returns false on malformed input.
+	bool Reflect(const void* smolvData, size_t smolvSize, Reflection* outReflection, uint32_t flags = kDecodeFlagNone, const Dictionary* dictionary = 0);
+
+
+	// -------------------------------------------------------------------
+	// Streaming decoding
+
+	// Decodes SMOL-V incrementally, for when the input arrives in pieces (e.g. read from disk or
+	// out of a decompressor), and the output should go out in pieces too, without having the
+	// full input or the full output in memory at once.
+	//
+	// Only keeps around an instruction that did not fully arrive yet, or did not fit into the
+	// output yet; these are usually tiny. Entropy coded and split stream (kEncodeFlagEntropyCode,
+	// kEncodeFlagSplitStreams) programs are an exception: all of their input is gathered before
+	// anything gets decoded.
+	struct DecodeStream;
+
+	// flags is bitset of DecodeFlags values.
+	DecodeStream* DecodeStreamCreate(uint32_t flags = kDecodeFlagNone, const Dictionary* dictionary = 0);
+	void DecodeStreamDelete(DecodeStream* s);
+
+	// Feed more SMOL-V input, and get more decoded SPIR-V output.
+	//
+	// Consumes as much of the input as possible, and writes as much of the output as fits. Amounts
+	// of input consumed and output written are returned in outInputUsed and outOutputWritten. When
+	// output buffer is full, some input might be left unconsumed; call again with the rest of the input
+	// once there's more space. Input is never consumed past the end of the SMOL-V program.
+	//
+	// Returns false on malformed input; the stream can not be used after that.
+	bool DecodeStreamProcess(DecodeStream* s, const void* input, size_t inputSize, size_t* outInputUsed, void* output, size_t outputSize, size_t* outOutputWritten);
+
+	// Whether the whole SPIR-V program was decoded and returned.
+	// If input is over, yet this is not true, then input was truncated.
+	bool DecodeStreamIsDone(const DecodeStream* s);
+
+	// Size of the whole decoded SPIR-V program; zero until the SMOL-V header was fed.
+	size_t DecodeStreamGetDecodedSize(const DecodeStream* s);
+
+
+	// -------------------------------------------------------------------
+	// Decoding straight out of a decompressor
+
+	// Provides the next piece of SMOL-V input, e.g. the output window of a zstd/LZ4/zlib streaming
+	// decompressor. Point *outData to the data and set *outSize to its size; the data has to stay valid
+	// until the next call. Set *outSize to zero when there is no more input.
+	//
+	// Return false on errors (e.g. corrupted compressed data); decoding fails then.
+	typedef bool(*DecodeInputFunc)(void* userData, const void** outData, size_t* outSize);
+
+	// Decode SMOL-V program that comes in pieces out of inputFunc, directly into the SPIR-V output buffer.
+	// Unlike decompressing into a temporary buffer and then calling Decode on it, there is no
+	// intermediate buffer of the whole SMOL-V program; input pieces are decoded from as they arrive.
+	//
+	// The buffer must be large enough for the decoded program (e.g. if you stored its size somewhere);
+	// size of the decoded program is returned in outSpirvWritten. The last input piece might extend past
+	// the end of the SMOL-V program (e.g. when many programs are compressed together); the amount of
+	// bytes at the end of it that were not used is returned in outInputLeft.
+	//
+	// Only does small memory allocations (like DecodeStream), except for entropy coded or split stream
+	// (kEncodeFlagEntropyCode, kEncodeFlagSplitStreams) programs, which are gathered in full before decoding.
+	//
+	// Returns false on malformed or truncated input, too small output buffer, or inputFunc failure.
+	bool DecodeFromInput(DecodeInputFunc inputFunc, void* inputUserData, void* spirvOutputBuffer, size_t spirvOutputBufferSize, size_t* outSpirvWritten, size_t* outInputLeft = 0, uint32_t flags = kDecodeFlagNone, const Dictionary* dictionary = 0);
+
+	// Same as above, but the output array gets resized to the decoded program size (once, as soon as
+	// the SMOL-V header arrives).
+	bool DecodeFromInput(DecodeInputFunc inputFunc, void* inputUserData, ByteArray& outSpirv, size_t* outInputLeft = 0, uint32_t flags = kDecodeFlagNone, const Dictionary* dictionary = 0);
+
+
+	// -------------------------------------------------------------------
+	// Parallel decoding: of many programs at once, or of a single large program
+
+	struct DecodeJob
+	{
+		const void* smolvData;
+		size_t smolvSize;
+		void* spirvOutputBuffer;
+		size_t spirvOutputBufferSize;
+		bool result; // filled by DecodeBatch: whether this job decoded successfully
+	};
+
+	// Hook to run batch work on your own job system. Needs to call task(taskData, i) for
+	// each i in 0..count-1 (in any order, from any threads), and return once all of them are done.
+	typedef void(*ParallelTaskFunc)(void* taskData, size_t index);
+	typedef void(*ParallelForFunc)(void* userData, size_t count, ParallelTaskFunc task, void* taskData);
+
+	// Decode a bunch of SMOL-V programs, spreading the work over multiple threads.
+	//
+	// Each job is the same as a Decode call, and gets its own result written into it.
+	// Jobs are started largest-first, and threads pick up the next job as soon as they are
+	// done with the previous one, so that a few large programs do not leave threads idle at the end.
+	//
+	// threadCount is the number of threads for the built-in thread pool (zero: use hardware
+	// thread count). If parallelFor is passed, it is used instead of the built-in thread pool.
+	//
+	// Returns true if all jobs decoded successfully.
+	bool DecodeBatch(DecodeJob* jobs, size_t jobCount, uint32_t flags = kDecodeFlagNone, int threadCount = 0, ParallelForFunc parallelFor = 0, void* parallelForUserData = 0, const Dictionary* dictionary = 0);
+
+	// Decode a single SMOL-V program, spreading the work over multiple threads.
+	//
+	// Only programs encoded with restart points (see Encode restartInterval) can be decoded in parallel:
+	// blocks of instructions between restart points get decoded at once. Other programs are decoded
+	// the same as with Decode, on the calling thread. See DecodeBatch for threadCount/parallelFor meaning.
+	//
+	// Returns false on malformed input; if that happens the output buffer might be only partially
+	// written to.
+	bool DecodeParallel(const void* smolvData, size_t smolvSize, void* spirvOutputBuffer, size_t spirvOutputBufferSize, uint32_t flags = kDecodeFlagNone, int threadCount = 0, ParallelForFunc parallelFor = 0, void* parallelForUserData = 0, const Dictionary* dictionary = 0);
+
+
+	// -------------------------------------------------------------------
+	// Archives of many SMOL-V programs
+
+	// An archive is a single blob with a small header, an index sorted by 64 bit key (e.g. a hash
+	// of the shader), and SMOL-V programs following that. It is meant to be used directly from
+	// memory, e.g. from a memory-mapped file: nothing needs to be parsed or allocated up front,
+	// a lookup only touches a few index entries, and decoding reads the SMOL-V program right out
+	// of the archive memory (so with memory-mapped files only used programs get paged in).
+	//
+	// Archive data should be at least 8 byte aligned. Layout is little-endian:
+	// - header: magic "SMVA", archive version, entry count, reserved (4 x uint32)
+	// - fanout table: 256 x uint32; entry N is count of keys with highest byte <= N
+	// - index: entryCount x { uint64 key, uint32 offset, uint32 size, uint32 decoded size, uint32 reserved }
+	// - SMOL-V programs, each starting at 4 byte aligned offset from archive start
+
+	struct ArchiveEntry
+	{
+		uint64_t key;
+		const void* smolvData;
+		size_t smolvSize;
+	};
+
+	// Build an archive out of SMOL-V programs. Entries can be in any order.
+	//
+	// Resulting data is appended to outArchive array (the array is not cleared).
+	//
+	// Returns false on malformed SMOL-V inputs, or if there are duplicate keys.
+	bool ArchiveBuild(const ArchiveEntry* entries, size_t entryCount, ByteArray& outArchive);
+
+	// Get number of programs in the archive; returns zero on malformed archive.
+	size_t ArchiveGetCount(const void* archiveData, size_t archiveSize);
+
+	// Find program index by key; returns false if not found (or malformed archive).
+	//
+	// Not a constant time hash lookup: the fanout table narrows it down to keys with the same highest
+	// byte, then it is a binary search within those, so O(log(n/256)). For hash keys and a few thousand
+	// programs that is a handful of index entries; keeping the index sorted keeps the format simple
+	// (and index order is the order programs are stored in).
+	bool ArchiveFind(const void* archiveData, size_t archiveSize, uint64_t key, size_t* outIndex);
+
+	// Get information about a program at given index. Output pointers can be null.
+	// outSmolvData points into the archive data itself.
+	bool ArchiveGetEntry(const void* archiveData, size_t archiveSize, size_t index, uint64_t* outKey, const void** outSmolvData, size_t* outSmolvSize, size_t* outDecodedSize);
+
+	// Decode program at given index, see Decode. Output buffer needs to be at least
+	// outDecodedSize as returned by ArchiveGetEntry.
+	bool ArchiveDecode(const void* archiveData, size_t archiveSize, size_t index, void* spirvOutputBuffer, size_t spirvOutputBufferSize, uint32_t flags = kDecodeFlagNone, const Dictionary* dictionary = 0);
+
+
+	// -------------------------------------------------------------------
+	// Dictionaries
+
+	// Many programs share a lot of the same instructions (capabilities, imports, memory model, common
+	// types, decorations etc.). A dictionary holds a set of such instructions; encoding with it turns
+	// runs of instructions that exactly match runs in the dictionary into short references. For libraries
+	// of many small shader variants this makes data smaller, and decoding faster (mostly just copies
+	// from the dictionary).
+	//
+	// Dictionary data is a SMOL-V program (of SPIR-V instructions that are common, it does not need
+	// to be a valid SPIR-V program otherwise); usually made with DictionaryTrain.
+	//
+	// Returns null on malformed input.
+	Dictionary* DictionaryCreate(const void* smolvData, size_t smolvSize);
+	void DictionaryDelete(Dictionary* d);
+
+	// Make dictionary data out of a bunch of SPIR-V programs (e.g. all shaders of a project). Finds
+	// instructions and runs of instructions that are present in several programs, and picks the ones
+	// that would save the most, until maxDictionarySize bytes (of SPIR-V instructions) are used.
+	// Work is spread over multiple threads, see DecodeBatch for threadCount/parallelFor meaning.
+	//
+	// flags is bitset of EncodeFlags values that programs are going to be encoded with.
+	//
+	// Resulting dictionary data (to pass to DictionaryCreate) is appended to outDictionary array.
+	//
+	// Returns false on malformed SPIR-V input.
+	bool DictionaryTrain(const void* const* spirvDatas, const size_t* spirvSizes, size_t spirvCount, size_t maxDictionarySize, ByteArray& outDictionary, uint32_t flags = kEncodeFlagNone, int threadCount = 0, ParallelForFunc parallelFor = 0, void* parallelForUserData = 0);
+
+
 	// -------------------------------------------------------------------
 	// Computing instruction statistics on SPIR-V/SMOL-V programs
 
@@ -125,6 +498,31 @@ namespace smolv
 	bool StatsCalculateSmol(Stats* stats, const void* smolvData, size_t smolvSize);
 	void StatsPrint(const Stats* stats);
 
+	// Write statistics out as text (appended to outText), for further processing/dashboards.
+	//
+	// Per op: SPIR-V instruction count and size (from StatsCalculate), SMOL-V instruction count and size
+	// (from StatsCalculateSmol; sizes before entropy coding), and SMOL-V size split by which part of the
+	// encoding it comes from: lengthOp (length + op token), type (type ID), result (result ID delta),
+	// relativeIds (other IDs), memberDecorate (runs of MemberDecorate), varRest (other varint operands),
+	// literals (raw literal words), swizzle (compact VectorShuffle swizzle byte).
+	//
+	// Ops past GroupNonUniformQuadSwap that SMOL-V knows (ray tracing, mesh shading etc.) have rows of
+	// their own; all other unknown ops go into one "Other" row (op value -1).
+	//
+	// JSON also has totals and varint length counts; CSV has one row per op, with a header row.
+	void StatsExportJson(const Stats* stats, ByteArray& outText);
+	void StatsExportCsv(const Stats* stats, ByteArray& outText);
+
+	// Add statistics collected in other to stats. A Stats object must not be used from several threads
+	// at once, but separate ones can; merging them gives the same result as collecting into one.
+	void StatsMerge(Stats* stats, const Stats* other);
+
+	// Calculate statistics of many programs, spreading the work over multiple threads (see DecodeBatch
+	// for threadCount/parallelFor meaning); results are added to stats. Returns false if any of the
+	// programs were malformed.
+	bool StatsCalculateBatch(Stats* stats, const void* const* spirvDatas, const size_t* spirvSizes, size_t spirvCount, int threadCount = 0, ParallelForFunc parallelFor = 0, void* parallelForUserData = 0);
+	bool StatsCalculateSmolBatch(Stats* stats, const void* const* smolvDatas, const size_t* smolvSizes, size_t smolvCount, int threadCount = 0, ParallelForFunc parallelFor = 0, void* parallelForUserData = 0);
+
 } // namespace smolv
 
 
@@ -0,0 +1,497 @@
+// smol-v - benchmark code - public domain - https://github.com/aras-p/smol-v
+// authored on 2016-2024 by Aras Pranckevicius
+// no warranty implied; use at your own risk
+//
+// Throughput benchmark of SMOL-V encoding, decoding (also of entropy coded data, of validated data without checks,
+// in parallel of data with restart points, and only up to function bodies), validation, reflection and stats
+// calculation (also on multiple threads), for each test corpus under tests/spirv-dumps. For comparison, also
+// measures LZ4 and zlib decompression of the same data, and decoding of zlib compressed SMOL-V (with and without
+// a temporary buffer for the decompressed data).
+//
+// Usage: smol-v-bench [--runs N] [--warmup N] [--csv file] [--json file]
+// (run from the repository root, so that test files are found)
+
+#include "../source/smolv.h"
+#include "external/lz4/lz4.h"
+#include "external/lz4/lz4hc.h"
+#include "external/miniz/miniz.h"
+#include "testfiles.h"
+
+#define SOKOL_IMPL
+#include "external/sokol_time.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+#include <algorithm>
+
+
+typedef std::vector<uint8_t> ByteArray;
+
+
+static void ReadFile(const char* fileName, ByteArray& output)
+{
+	FILE* f = fopen(fileName, "rb");
+	if (f)
+	{
+		fseek(f, 0, SEEK_END);
+		size_t size = ftell(f);
+		fseek(f, 0, SEEK_SET);
+		size_t pos = output.size();
+		output.resize(pos + size);
+		fread(output.data() + pos, size, 1, f);
+		fclose(f);
+	}
+}
+
+static size_t CountSpirvInstructions(const ByteArray& spirv)
+{
+	const uint32_t* words = (const uint32_t*)spirv.data();
+	const size_t wordCount = spirv.size() / 4;
+	size_t count = 0;
+	for (size_t pos = 5; pos < wordCount; pos += std::max(words[pos] >> 16, 1u))
+		++count;
+	return count;
+}
+
+struct Corpus
+{
+	std::string name;
+	std::vector<ByteArray> spirvs;
+	std::vector<ByteArray> smolvs;
+	std::vector<ByteArray> smolvsEntropy; // encoded with kEncodeFlagEntropyCode
+	std::vector<ByteArray> smolvsRestarts; // encoded with restart points every 16KB
+	size_t spirvSize;
+	size_t instrCount;
+	// whole corpus as one blob, compressed with general purpose compressors
+	ByteArray spirvAll;
+	ByteArray spirvLZ4;
+	ByteArray spirvZlib;
+	ByteArray smolvAll;
+	ByteArray smolvLZ4;
+	ByteArray smolvZlib;
+};
+
+struct Result
+{
+	std::string corpus;
+	std::string test;
+	double minMs, medianMs, p99Ms;
+	double mbPerSec; // of SPIR-V data, based on median time
+	double instrPerSec; // of SPIR-V instructions, based on median time
+};
+
+static void CompressCorpus(Corpus& c)
+{
+	for (size_t i = 0; i < c.spirvs.size(); ++i)
+	{
+		c.spirvAll.insert(c.spirvAll.end(), c.spirvs[i].begin(), c.spirvs[i].end());
+		c.smolvAll.insert(c.smolvAll.end(), c.smolvs[i].begin(), c.smolvs[i].end());
+	}
+
+	c.spirvLZ4.resize(LZ4_compressBound((int)c.spirvAll.size()));
+	c.spirvLZ4.resize(LZ4_compress_HC((const char*)c.spirvAll.data(), (char*)c.spirvLZ4.data(), (int)c.spirvAll.size(), (int)c.spirvLZ4.size(), 0));
+	c.smolvLZ4.resize(LZ4_compressBound((int)c.smolvAll.size()));
+	c.smolvLZ4.resize(LZ4_compress_HC((const char*)c.smolvAll.data(), (char*)c.smolvLZ4.data(), (int)c.smolvAll.size(), (int)c.smolvLZ4.size(), 0));
+
+	mz_ulong zlibSize = mz_compressBound((mz_ulong)c.spirvAll.size());
+	c.spirvZlib.resize(zlibSize);
+	mz_compress2(c.spirvZlib.data(), &zlibSize, c.spirvAll.data(), (mz_ulong)c.spirvAll.size(), MZ_DEFAULT_LEVEL);
+	c.spirvZlib.resize(zlibSize);
+	zlibSize = mz_compressBound((mz_ulong)c.smolvAll.size());
+	c.smolvZlib.resize(zlibSize);
+	mz_compress2(c.smolvZlib.data(), &zlibSize, c.smolvAll.data(), (mz_ulong)c.smolvAll.size(), MZ_DEFAULT_LEVEL);
+	c.smolvZlib.resize(zlibSize);
+}
+
+// zlib decompressor (miniz) handing out its output window to smolv::DecodeFromInput
+struct InflateInput
+{
+	mz_stream stream;
+	uint8_t window[16 * 1024];
+	size_t pos, size; // part of the window that was not handed out yet
+};
+
+static bool InflateInputFunc(void* userData, const void** outData, size_t* outSize)
+{
+	InflateInput* in = (InflateInput*)userData;
+	if (in->pos == in->size)
+	{
+		in->stream.next_out = in->window;
+		in->stream.avail_out = sizeof(in->window);
+		int res = mz_inflate(&in->stream, MZ_NO_FLUSH);
+		if (res != MZ_OK && res != MZ_STREAM_END && res != MZ_BUF_ERROR)
+			return false;
+		in->pos = 0;
+		in->size = sizeof(in->window) - in->stream.avail_out;
+	}
+	*outData = in->window + in->pos;
+	*outSize = in->size - in->pos;
+	in->pos = in->size;
+	return true;
+}
+
+// Runs func warmup+runs times, returns time of each non-warmup run in milliseconds
+template<typename F>
+static void Measure(F func, int warmup, int runs, std::vector<double>& outTimes)
+{
+	outTimes.clear();
+	for (int i = 0; i < warmup; ++i)
+		func();
+	for (int i = 0; i < runs; ++i)
+	{
+		uint64_t timeStart = stm_now();
+		func();
+		outTimes.push_back(stm_ms(stm_since(timeStart)));
+	}
+}
+
+static Result MakeResult(const Corpus& c, const char* test, std::vector<double>& times)
+{
+	std::sort(times.begin(), times.end());
+	Result r;
+	r.corpus = c.name;
+	r.test = test;
+	r.minMs = times.front();
+	r.medianMs = times[times.size() / 2];
+	size_t p99 = (times.size() * 99 + 99) / 100;
+	r.p99Ms = times[std::min(p99, times.size()) - 1];
+	const double seconds = std::max(r.medianMs, 1.0e-6) / 1000.0;
+	r.mbPerSec = c.spirvSize / (1024.0 * 1024.0) / seconds;
+	r.instrPerSec = c.instrCount / seconds;
+	return r;
+}
+
+static bool BenchmarkCorpus(const Corpus& c, int warmup, int runs, std::vector<Result>& results)
+{
+	std::vector<double> times;
+	bool ok = true;
+
+	// SMOL-V encoding (into a preallocated buffer, big enough for worst case of each program)
+	size_t encodedBound = 0;
+	for (size_t i = 0; i < c.spirvs.size(); ++i)
+		encodedBound += smolv::GetEncodeBoundSize(c.spirvs[i].size());
+	ByteArray encoded(encodedBound);
+	Measure([&]()
+	{
+		uint8_t* out = encoded.data();
+		for (size_t i = 0; i < c.spirvs.size(); ++i)
+		{
+			size_t written = 0;
+			ok &= smolv::Encode(c.spirvs[i].data(), c.spirvs[i].size(), out, encoded.size() - (out - encoded.data()), &written);
+			out += written;
+		}
+	}, warmup, runs, times);
+	results.push_back(MakeResult(c, "encode", times));
+
+	// SMOL-V decoding
+	ByteArray decoded(c.spirvSize);
+	Measure([&]()
+	{
+		uint8_t* out = decoded.data();
+		for (size_t i = 0; i < c.smolvs.size(); ++i)
+		{
+			ok &= smolv::Decode(c.smolvs[i].data(), c.smolvs[i].size(), out, c.spirvs[i].size());
+			out += c.spirvs[i].size();
+		}
+	}, warmup, runs, times);
+	results.push_back(MakeResult(c, "decode", times));
+	ok &= decoded == c.spirvAll;
+
+	// Decoding of already validated SMOL-V, without end-of-data checks
+	Measure([&]()
+	{
+		uint8_t* out = decoded.data();
+		for (size_t i = 0; i < c.smolvs.size(); ++i)
+		{
+			ok &= smolv::Decode(c.smolvs[i].data(), c.smolvs[i].size(), out, c.spirvs[i].size(), smolv::kDecodeFlagTrusted);
+			out += c.spirvs[i].size();
+		}
+	}, warmup, runs, times);
+	results.push_back(MakeResult(c, "decode-trusted", times));
+	ok &= decoded == c.spirvAll;
+
+	// Validation, e.g. at download/install time
+	Measure([&]()
+	{
+		for (size_t i = 0; i < c.smolvs.size(); ++i)
+			ok &= smolv::Validate(c.smolvs[i].data(), c.smolvs[i].size());
+	}, warmup, runs, times);
+	results.push_back(MakeResult(c, "validate", times));
+
+	// Decoding of entropy coded SMOL-V
+	Measure([&]()
+	{
+		uint8_t* out = decoded.data();
+		for (size_t i = 0; i < c.smolvsEntropy.size(); ++i)
+		{
+			ok &= smolv::Decode(c.smolvsEntropy[i].data(), c.smolvsEntropy[i].size(), out, c.spirvs[i].size());
+			out += c.spirvs[i].size();
+		}
+	}, warmup, runs, times);
+	results.push_back(MakeResult(c, "decode-entropy", times));
+	ok &= decoded == c.spirvAll;
+
+	// Decoding of SMOL-V with restart points, one program at a time, each on multiple threads
+	Measure([&]()
+	{
+		uint8_t* out = decoded.data();
+		for (size_t i = 0; i < c.smolvsRestarts.size(); ++i)
+		{
+			ok &= smolv::DecodeParallel(c.smolvsRestarts[i].data(), c.smolvsRestarts[i].size(), out, c.spirvs[i].size());
+			out += c.spirvs[i].size();
+		}
+	}, warmup, runs, times);
+	results.push_back(MakeResult(c, "decode-parallel", times));
+	ok &= decoded == c.spirvAll;
+
+	// Decoding only up to function bodies, e.g. for reflection (throughput is relative to whole programs)
+	ByteArray sections;
+	Measure([&]()
+	{
+		for (size_t i = 0; i < c.smolvs.size(); ++i)
+			ok &= smolv::DecodeSections(c.smolvs[i].data(), c.smolvs[i].size(), sections);
+	}, warmup, runs, times);
+	results.push_back(MakeResult(c, "decode-sections", times));
+
+	// Reflection straight out of SMOL-V
+	Measure([&]()
+	{
+		smolv::Reflection refl;
+		for (size_t i = 0; i < c.smolvs.size(); ++i)
+			ok &= smolv::Reflect(c.smolvs[i].data(), c.smolvs[i].size(), &refl);
+	}, warmup, runs, times);
+	results.push_back(MakeResult(c, "reflect", times));
+
+	// Instruction stats on SPIR-V
+	Measure([&]()
+	{
+		smolv::Stats* stats = smolv::StatsCreate();
+		for (size_t i = 0; i < c.spirvs.size(); ++i)
+			ok &= smolv::StatsCalculate(stats, c.spirvs[i].data(), c.spirvs[i].size());
+		smolv::StatsDelete(stats);
+	}, warmup, runs, times);
+	results.push_back(MakeResult(c, "stats", times));
+
+	// Same, on multiple threads
+	std::vector<const void*> spirvDatas;
+	std::vector<size_t> spirvSizes;
+	for (size_t i = 0; i < c.spirvs.size(); ++i)
+	{
+		spirvDatas.push_back(c.spirvs[i].data());
+		spirvSizes.push_back(c.spirvs[i].size());
+	}
+	Measure([&]()
+	{
+		smolv::Stats* stats = smolv::StatsCreate();
+		ok &= smolv::StatsCalculateBatch(stats, spirvDatas.data(), spirvSizes.data(), spirvDatas.size());
+		smolv::StatsDelete(stats);
+	}, warmup, runs, times);
+	results.push_back(MakeResult(c, "stats-batch", times));
+
+	// LZ4 decompression of SPIR-V, for comparison
+	Measure([&]()
+	{
+		int size = LZ4_decompress_safe((const char*)c.spirvLZ4.data(), (char*)decoded.data(), (int)c.spirvLZ4.size(), (int)decoded.size());
+		ok &= size == (int)c.spirvSize;
+	}, warmup, runs, times);
+	results.push_back(MakeResult(c, "lz4-decompress", times));
+
+	// zlib decompression of SPIR-V, for comparison
+	Measure([&]()
+	{
+		mz_ulong size = (mz_ulong)decoded.size();
+		ok &= mz_uncompress(decoded.data(), &size, c.spirvZlib.data(), (mz_ulong)c.spirvZlib.size()) == MZ_OK;
+	}, warmup, runs, times);
+	results.push_back(MakeResult(c, "zlib-decompress", times));
+
+	// LZ4 decompression of SMOL-V, and then SMOL-V decoding: typical way to store shaders
+	ByteArray smolvDecompressed(c.smolvAll.size());
+	Measure([&]()
+	{
+		int size = LZ4_decompress_safe((const char*)c.smolvLZ4.data(), (char*)smolvDecompressed.data(), (int)c.smolvLZ4.size(), (int)smolvDecompressed.size());
+		ok &= size == (int)c.smolvAll.size();
+		const uint8_t* in = smolvDecompressed.data();
+		uint8_t* out = decoded.data();
+		for (size_t i = 0; i < c.smolvs.size(); ++i)
+		{
+			ok &= smolv::Decode(in, c.smolvs[i].size(), out, c.spirvs[i].size());
+			in += c.smolvs[i].size();
+			out += c.spirvs[i].size();
+		}
+	}, warmup, runs, times);
+	results.push_back(MakeResult(c, "lz4-decompress+decode", times));
+	ok &= decoded == c.spirvAll;
+
+	// zlib decompression of SMOL-V into a temporary buffer, and then SMOL-V decoding
+	Measure([&]()
+	{
+		mz_ulong size = (mz_ulong)smolvDecompressed.size();
+		ok &= mz_uncompress(smolvDecompressed.data(), &size, c.smolvZlib.data(), (mz_ulong)c.smolvZlib.size()) == MZ_OK;
+		const uint8_t* in = smolvDecompressed.data();
+		uint8_t* out = decoded.data();
+		for (size_t i = 0; i < c.smolvs.size(); ++i)
+		{
+			ok &= smolv::Decode(in, c.smolvs[i].size(), out, c.spirvs[i].size());
+			in += c.smolvs[i].size();
+			out += c.spirvs[i].size();
+		}
+	}, warmup, runs, times);
+	results.push_back(MakeResult(c, "zlib-decompress+decode", times));
+	ok &= decoded == c.spirvAll;
+
+	// same, but decoding straight out of the zlib decompressor window, without the temporary buffer
+	InflateInput* input = new InflateInput();
+	Measure([&]()
+	{
+		memset(input, 0, sizeof(*input));
+		input->stream.next_in = c.smolvZlib.data();
+		input->stream.avail_in = (unsigned int)c.smolvZlib.size();
+		mz_inflateInit(&input->stream);
+		uint8_t* out = decoded.data();
+		for (size_t i = 0; i < c.smolvs.size(); ++i)
+		{
+			size_t left = 0;
+			ok &= smolv::DecodeFromInput(InflateInputFunc, input, out, c.spirvs[i].size(), NULL, &left);
+			input->pos -= left;
+			out += c.spirvs[i].size();
+		}
+		mz_inflateEnd(&input->stream);
+	}, warmup, runs, times);
+	delete input;
+	results.push_back(MakeResult(c, "zlib-decode-fused", times));
+	ok &= decoded == c.spirvAll;
+
+	return ok;
+}
+
+static void WriteCSV(const char* path, const std::vector<Result>& results)
+{
+	FILE* f = fopen(path, "wb");
+	if (!f)
+	{
+		printf("ERROR: failed to write %s\n", path);
+		return;
+	}
+	fprintf(f, "corpus,test,min_ms,median_ms,p99_ms,mb_per_sec,instr_per_sec\n");
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const Result& r = results[i];
+		fprintf(f, "%s,%s,%.4f,%.4f,%.4f,%.1f,%.0f\n", r.corpus.c_str(), r.test.c_str(), r.minMs, r.medianMs, r.p99Ms, r.mbPerSec, r.instrPerSec);
+	}
+	fclose(f);
+}
+
+static void WriteJSON(const char* path, const std::vector<Result>& results)
+{
+	FILE* f = fopen(path, "wb");
+	if (!f)
+	{
+		printf("ERROR: failed to write %s\n", path);
+		return;
+	}
+	fprintf(f, "[\n");
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const Result& r = results[i];
+		fprintf(f, "  {\"corpus\": \"%s\", \"test\": \"%s\", \"min_ms\": %.4f, \"median_ms\": %.4f, \"p99_ms\": %.4f, \"mb_per_sec\": %.1f, \"instr_per_sec\": %.0f}%s\n",
+			r.corpus.c_str(), r.test.c_str(), r.minMs, r.medianMs, r.p99Ms, r.mbPerSec, r.instrPerSec, i + 1 < results.size() ? "," : "");
+	}
+	fprintf(f, "]\n");
+	fclose(f);
+}
+
+int main(int argc, char** argv)
+{
+	int runs = 20;
+	int warmup = 2;
+	const char* csvPath = NULL;
+	const char* jsonPath = NULL;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--runs") && i + 1 < argc)
+			runs = std::max(atoi(argv[++i]), 1);
+		else if (!strcmp(argv[i], "--warmup") && i + 1 < argc)
+			warmup = std::max(atoi(argv[++i]), 0);
+		else if (!strcmp(argv[i], "--csv") && i + 1 < argc)
+			csvPath = argv[++i];
+		else if (!strcmp(argv[i], "--json") && i + 1 < argc)
+			jsonPath = argv[++i];
+		else
+		{
+			printf("Usage: %s [--runs N] [--warmup N] [--csv file] [--json file]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	stm_setup();
+
+	// read all files, grouped by corpus (directory name); last corpus is everything together
+	std::vector<Corpus> corpora;
+	Corpus all;
+	all.name = "all";
+	for (size_t i = 0; i < sizeof(kSpirvFiles)/sizeof(kSpirvFiles[0]); ++i)
+	{
+		if (strstr(kSpirvFiles[i], "invalid-") != NULL)
+			continue;
+		ByteArray spirv;
+		ReadFile((std::string("tests/spirv-dumps/") + kSpirvFiles[i]).c_str(), spirv);
+		ByteArray smolv, smolvEntropy, smolvRestarts;
+		if (spirv.empty() || !smolv::Encode(spirv.data(), spirv.size(), smolv) || !smolv::Encode(spirv.data(), spirv.size(), smolvEntropy, smolv::kEncodeFlagEntropyCode) ||
+			!smolv::Encode(spirv.data(), spirv.size(), smolvRestarts, smolv::kEncodeFlagNone, NULL, NULL, 16 * 1024))
+		{
+			printf("ERROR: failed to read or encode %s\n", kSpirvFiles[i]);
+			return 1;
+		}
+
+		const std::string path = kSpirvFiles[i];
+		const std::string name = path.substr(0, path.find('/'));
+		if (corpora.empty() || corpora.back().name != name)
+		{
+			corpora.push_back(Corpus());
+			corpora.back().name = name;
+		}
+		corpora.back().spirvs.push_back(spirv);
+		corpora.back().smolvs.push_back(smolv);
+		corpora.back().smolvsEntropy.push_back(smolvEntropy);
+		corpora.back().smolvsRestarts.push_back(smolvRestarts);
+		all.spirvs.push_back(spirv);
+		all.smolvs.push_back(smolv);
+		all.smolvsEntropy.push_back(smolvEntropy);
+		all.smolvsRestarts.push_back(smolvRestarts);
+	}
+	corpora.push_back(all);
+
+	std::vector<Result> results;
+	printf("%-10s %-22s %6s %8s %8s %8s %9s %10s\n", "corpus", "test", "files", "min ms", "med ms", "p99 ms", "MB/s", "Minstr/s");
+	for (size_t ci = 0; ci < corpora.size(); ++ci)
+	{
+		Corpus& c = corpora[ci];
+		c.spirvSize = 0;
+		c.instrCount = 0;
+		for (size_t i = 0; i < c.spirvs.size(); ++i)
+		{
+			c.spirvSize += c.spirvs[i].size();
+			c.instrCount += CountSpirvInstructions(c.spirvs[i]);
+		}
+		CompressCorpus(c);
+
+		const size_t firstResult = results.size();
+		if (!BenchmarkCorpus(c, warmup, runs, results))
+		{
+			printf("ERROR: benchmark of %s produced wrong results\n", c.name.c_str());
+			return 1;
+		}
+		for (size_t i = firstResult; i < results.size(); ++i)
+		{
+			const Result& r = results[i];
+			printf("%-10s %-22s %6i %8.3f %8.3f %8.3f %9.1f %10.1f\n", r.corpus.c_str(), r.test.c_str(), (int)c.spirvs.size(), r.minMs, r.medianMs, r.p99Ms, r.mbPerSec, r.instrPerSec / 1.0e6);
+		}
+	}
+
+	if (csvPath)
+		WriteCSV(csvPath, results);
+	if (jsonPath)
+		WriteJSON(jsonPath, results);
+	return 0;
+}
@@ -8,12 +8,14 @@
 #include "external/miniz/miniz.h"
 #include "external/zstd/zstd.h"
 #include "external/glslang/SPIRV/SPVRemapper.h"
+#include "testfiles.h"
 
 #define SOKOL_IMPL
 #include "external/sokol_time.h"
 #include <stdio.h>
 #include <string>
 #include <string.h>
+#include <algorithm>
 
 
 typedef std::vector<uint8_t> ByteArray;
@@ -34,6 +36,8 @@ static void ReadFile(const char* fileName, ByteArray& output)
 	}
 }
 
+static bool s_RemapFailed = false;
+
 static void RemapSPIRV(const void* data, size_t size, bool strip, ByteArray& output)
 {
 	const uint32_t* dataI = (const uint32_t*)data;
@@ -222,6 +226,15 @@ static bool TestDecodingExistingSmolvFiles()
 				continue;
 			}
 		}
+
+		// Partial decoding of the whole program should match too
+		ByteArray spirvSections;
+		if (!smolv::DecodeSections(smolv.data(), smolv.size(), spirvSections, smolv::kSectionFunctions, flags) || spirvSections != spirvDecoded)
+		{
+			printf("ERROR: partial decoding does not match for %s\n", kFiles[i]);
+			++errorCount;
+			continue;
+		}
 	}
 	
 	if (errorCount != 0)
@@ -232,449 +245,1120 @@ static bool TestDecodingExistingSmolvFiles()
 	return true;
 }
 
+static bool TestDecodeBatch(const std::vector<ByteArray>& spirvs, const std::vector<ByteArray>& smolvs, uint64_t& outTime)
+{
+	std::vector<ByteArray> decoded(smolvs.size());
+	std::vector<smolv::DecodeJob> jobs(smolvs.size());
+	for (size_t i = 0; i < smolvs.size(); ++i)
+	{
+		decoded[i].resize(smolv::GetDecodedBufferSize(smolvs[i].data(), smolvs[i].size()));
+		jobs[i].smolvData = smolvs[i].data();
+		jobs[i].smolvSize = smolvs[i].size();
+		jobs[i].spirvOutputBuffer = decoded[i].data();
+		jobs[i].spirvOutputBufferSize = decoded[i].size();
+	}
+
+	uint64_t timeStart = stm_now();
+	bool ok = smolv::DecodeBatch(jobs.data(), jobs.size());
+	outTime = stm_since(timeStart);
+
+	int errorCount = 0;
+	for (size_t i = 0; i < smolvs.size(); ++i)
+	{
+		if (!jobs[i].result || decoded[i] != spirvs[i])
+			++errorCount;
+	}
+	if (!ok || errorCount != 0)
+	{
+		printf("ERROR: batch decoding failed on %i programs\n", errorCount);
+		return false;
+	}
+	return true;
+}
+
+static bool TestDecodeStream(const std::vector<ByteArray>& spirvs, const std::vector<ByteArray>& smolvs)
+{
+	// feed input in small chunks of varying sizes, and drain output into a small buffer
+	const size_t kChunkSizes[] = { 1, 7, 64, 1000 };
+	int errorCount = 0;
+	for (size_t i = 0; i < smolvs.size(); ++i)
+	{
+		const size_t chunkSize = kChunkSizes[i % (sizeof(kChunkSizes)/sizeof(kChunkSizes[0]))];
+		smolv::DecodeStream* stream = smolv::DecodeStreamCreate();
+		ByteArray decoded;
+		uint8_t outBuffer[256];
+		size_t inPos = 0;
+		bool ok = true;
+		while (ok && !smolv::DecodeStreamIsDone(stream))
+		{
+			size_t inSize = std::min(chunkSize, smolvs[i].size() - inPos);
+			size_t inUsed = 0, outWritten = 0;
+			ok = smolv::DecodeStreamProcess(stream, smolvs[i].data() + inPos, inSize, &inUsed, outBuffer, sizeof(outBuffer), &outWritten);
+			inPos += inUsed;
+			decoded.insert(decoded.end(), outBuffer, outBuffer + outWritten);
+			if (inUsed == 0 && outWritten == 0)
+				break; // no progress, input must be over
+		}
+		if (!ok || !smolv::DecodeStreamIsDone(stream) || inPos != smolvs[i].size() || decoded != spirvs[i])
+			++errorCount;
+		smolv::DecodeStreamDelete(stream);
+	}
+	if (errorCount != 0)
+	{
+		printf("ERROR: streaming decoding failed on %i programs\n", errorCount);
+		return false;
+	}
+	return true;
+}
+
+// zlib decompressor (miniz) handing out its output to DecodeFromInput in small pieces
+struct InflateInput
+{
+	mz_stream stream;
+	uint8_t window[1000];
+	size_t pos, size; // part of the window that was not handed out yet
+};
+
+static bool InflateInputFunc(void* userData, const void** outData, size_t* outSize)
+{
+	InflateInput* in = (InflateInput*)userData;
+	if (in->pos == in->size)
+	{
+		in->stream.next_out = in->window;
+		in->stream.avail_out = sizeof(in->window);
+		int res = mz_inflate(&in->stream, MZ_NO_FLUSH);
+		if (res != MZ_OK && res != MZ_STREAM_END && res != MZ_BUF_ERROR)
+			return false;
+		in->pos = 0;
+		in->size = sizeof(in->window) - in->stream.avail_out;
+	}
+	*outData = in->window + in->pos;
+	*outSize = in->size - in->pos;
+	in->pos = in->size;
+	return true;
+}
+
+static bool TestDecodeFromInput(const std::vector<ByteArray>& spirvs, const std::vector<ByteArray>& smolvs)
+{
+	// all programs compressed together, and decoded one after another straight out of the decompressor
+	ByteArray smolvAll;
+	for (size_t i = 0; i < smolvs.size(); ++i)
+		smolvAll.insert(smolvAll.end(), smolvs[i].begin(), smolvs[i].end());
+	mz_ulong compressedSize = mz_compressBound((mz_ulong)smolvAll.size());
+	ByteArray compressed(compressedSize);
+	mz_compress2(compressed.data(), &compressedSize, smolvAll.data(), (mz_ulong)smolvAll.size(), MZ_DEFAULT_LEVEL);
+
+	InflateInput input;
+	memset(&input, 0, sizeof(input));
+	input.stream.next_in = compressed.data();
+	input.stream.avail_in = (unsigned int)compressedSize;
+	mz_inflateInit(&input.stream);
+
+	int errorCount = 0;
+	for (size_t i = 0; i < smolvs.size(); ++i)
+	{
+		ByteArray decoded;
+		size_t left = 0;
+		bool ok;
+		if (i & 1)
+		{
+			ok = smolv::DecodeFromInput(InflateInputFunc, &input, decoded, &left);
+		}
+		else
+		{
+			size_t written = 0;
+			decoded.resize(spirvs[i].size());
+			ok = smolv::DecodeFromInput(InflateInputFunc, &input, decoded.data(), decoded.size(), &written, &left) && written == decoded.size();
+		}
+		input.pos -= left; // rest of the piece belongs to the next program
+		if (!ok || decoded != spirvs[i])
+			++errorCount;
+	}
+	const void* data;
+	size_t size = 1;
+	if (!InflateInputFunc(&input, &data, &size) || size != 0)
+		++errorCount; // should have used up all the input
+	mz_inflateEnd(&input.stream);
+
+	// too small output buffer, and truncated input should fail
+	if (!smolvs.empty())
+	{
+		memset(&input, 0, sizeof(input));
+		input.stream.next_in = compressed.data();
+		input.stream.avail_in = (unsigned int)compressedSize;
+		mz_inflateInit(&input.stream);
+		ByteArray decoded(spirvs[0].size() - 4);
+		if (smolv::DecodeFromInput(InflateInputFunc, &input, decoded.data(), decoded.size(), NULL))
+			++errorCount;
+		mz_inflateEnd(&input.stream);
+
+		memset(&input, 0, sizeof(input));
+		input.stream.next_in = compressed.data();
+		input.stream.avail_in = 20;
+		mz_inflateInit(&input.stream);
+		if (smolv::DecodeFromInput(InflateInputFunc, &input, decoded))
+			++errorCount;
+		mz_inflateEnd(&input.stream);
+	}
+
+	if (errorCount != 0)
+	{
+		printf("ERROR: decoding from input function failed on %i programs\n", errorCount);
+		return false;
+	}
+	return true;
+}
+
+static uint64_t TestArchiveKey(size_t index)
+{
+	// spread keys over whole 64 bit range (splitmix64 finalizer)
+	uint64_t z = index * 0x9E3779B97F4A7C15ull;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+static bool TestArchive(const std::vector<ByteArray>& spirvs, const std::vector<ByteArray>& smolvs)
+{
+	std::vector<smolv::ArchiveEntry> entries(smolvs.size());
+	for (size_t i = 0; i < smolvs.size(); ++i)
+	{
+		entries[i].key = TestArchiveKey(i);
+		entries[i].smolvData = smolvs[i].data();
+		entries[i].smolvSize = smolvs[i].size();
+	}
+	ByteArray archive;
+	if (!smolv::ArchiveBuild(entries.data(), entries.size(), archive) || smolv::ArchiveGetCount(archive.data(), archive.size()) != smolvs.size())
+	{
+		printf("ERROR: failed to build SMOL-V archive\n");
+		return false;
+	}
+
+	int errorCount = 0;
+	for (size_t i = 0; i < smolvs.size(); ++i)
+	{
+		size_t index = 0, decodedSize = 0;
+		if (!smolv::ArchiveFind(archive.data(), archive.size(), entries[i].key, &index) ||
+			!smolv::ArchiveGetEntry(archive.data(), archive.size(), index, NULL, NULL, NULL, &decodedSize))
+		{
+			++errorCount;
+			continue;
+		}
+		ByteArray decoded(decodedSize);
+		if (!smolv::ArchiveDecode(archive.data(), archive.size(), index, decoded.data(), decoded.size()) || decoded != spirvs[i])
+			++errorCount;
+	}
+	if (smolv::ArchiveFind(archive.data(), archive.size(), TestArchiveKey(smolvs.size()), NULL))
+		++errorCount; // found a key that is not there
+	if (errorCount != 0)
+	{
+		printf("ERROR: archive lookup/decoding failed on %i programs\n", errorCount);
+		return false;
+	}
+
+	// duplicate keys are an error
+	if (entries.size() >= 2)
+	{
+		entries[1].key = entries[0].key;
+		ByteArray archiveDup;
+		if (smolv::ArchiveBuild(entries.data(), entries.size(), archiveDup))
+		{
+			printf("ERROR: archive with duplicate keys should fail to build\n");
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool TestDictionary(const std::vector<ByteArray>& spirvs, size_t& outSizeNoDict, size_t& outSizeDict, size_t& outDictSize, uint64_t& outTrainTime)
+{
+	// train a dictionary on every other program; sizes are only measured on the other half,
+	// so that the saving is not on the same data the dictionary was made from
+	std::vector<const void*> datas;
+	std::vector<size_t> sizes;
+	for (size_t i = 0; i < spirvs.size(); i += 2)
+	{
+		datas.push_back(spirvs[i].data());
+		sizes.push_back(spirvs[i].size());
+	}
+	ByteArray dictSmolv;
+	smolv::Dictionary* dict = NULL;
+	uint64_t timeStart = stm_now();
+	bool trained = smolv::DictionaryTrain(datas.data(), sizes.data(), datas.size(), 64 * 1024, dictSmolv, smolv::kEncodeFlagStripDebugInfo);
+	outTrainTime = stm_since(timeStart);
+	if (!trained || (dict = smolv::DictionaryCreate(dictSmolv.data(), dictSmolv.size())) == NULL)
+	{
+		printf("ERROR: failed to create SMOL-V dictionary\n");
+		return false;
+	}
+	outDictSize = dictSmolv.size();
+
+	outSizeNoDict = outSizeDict = 0;
+	int errorCount = 0;
+	for (size_t i = 0; i < spirvs.size(); ++i)
+	{
+		ByteArray smolvNoDict, smolvDict;
+		if (!smolv::Encode(spirvs[i].data(), spirvs[i].size(), smolvNoDict, smolv::kEncodeFlagStripDebugInfo) ||
+			!smolv::Encode(spirvs[i].data(), spirvs[i].size(), smolvDict, smolv::kEncodeFlagStripDebugInfo, 0, dict))
+		{
+			++errorCount;
+			continue;
+		}
+		if (i % 2 == 1)
+		{
+			outSizeNoDict += smolvNoDict.size();
+			outSizeDict += smolvDict.size();
+		}
+
+		// should decode into same thing as without the dictionary; and should fail to decode without the dictionary
+		ByteArray decodedNoDict(smolv::GetDecodedBufferSize(smolvNoDict.data(), smolvNoDict.size()));
+		ByteArray decodedDict(smolv::GetDecodedBufferSize(smolvDict.data(), smolvDict.size()));
+		if (!smolv::Decode(smolvNoDict.data(), smolvNoDict.size(), decodedNoDict.data(), decodedNoDict.size()) ||
+			!smolv::Decode(smolvDict.data(), smolvDict.size(), decodedDict.data(), decodedDict.size(), 0, dict) ||
+			decodedDict != decodedNoDict ||
+			smolv::Decode(smolvDict.data(), smolvDict.size(), decodedDict.data(), decodedDict.size()))
+			++errorCount;
+
+		// same with split streams
+		ByteArray smolvDictSplit;
+		if (!smolv::Encode(spirvs[i].data(), spirvs[i].size(), smolvDictSplit, smolv::kEncodeFlagStripDebugInfo | smolv::kEncodeFlagSplitStreams, 0, dict) ||
+			!smolv::Decode(smolvDictSplit.data(), smolvDictSplit.size(), decodedDict.data(), decodedDict.size(), 0, dict) ||
+			decodedDict != decodedNoDict)
+			++errorCount;
+
+		// full programs, with streaming decoder
+		ByteArray smolvFull;
+		smolv::Encode(spirvs[i].data(), spirvs[i].size(), smolvFull, 0, 0, dict);
+		smolv::DecodeStream* stream = smolv::DecodeStreamCreate(0, dict);
+		ByteArray decoded(spirvs[i].size());
+		size_t inUsed = 0, outWritten = 0;
+		if (!smolv::DecodeStreamProcess(stream, smolvFull.data(), smolvFull.size(), &inUsed, decoded.data(), decoded.size(), &outWritten) ||
+			!smolv::DecodeStreamIsDone(stream) || decoded != spirvs[i])
+			++errorCount;
+		smolv::DecodeStreamDelete(stream);
+	}
+	smolv::DictionaryDelete(dict);
+	if (errorCount != 0)
+	{
+		printf("ERROR: encoding/decoding with dictionary failed on %i programs\n", errorCount);
+		return false;
+	}
+	return true;
+}
+
+static bool TestEntropyCoding(const std::vector<ByteArray>& spirvs, size_t& outSize, uint64_t& outDecodeTime)
+{
+	outSize = 0;
+	outDecodeTime = 0;
+	int errorCount = 0;
+	smolv::Stats* stats = smolv::StatsCreate();
+	for (size_t i = 0; i < spirvs.size(); ++i)
+	{
+		ByteArray smolvPlain, smolvCoded;
+		if (!smolv::Encode(spirvs[i].data(), spirvs[i].size(), smolvPlain, smolv::kEncodeFlagStripDebugInfo) ||
+			!smolv::Encode(spirvs[i].data(), spirvs[i].size(), smolvCoded, smolv::kEncodeFlagStripDebugInfo | smolv::kEncodeFlagEntropyCode) ||
+			smolvCoded.size() > smolvPlain.size())
+		{
+			++errorCount;
+			continue;
+		}
+		outSize += smolvCoded.size();
+
+		// should decode into same thing as without entropy coding
+		ByteArray decodedPlain(smolv::GetDecodedBufferSize(smolvPlain.data(), smolvPlain.size()));
+		ByteArray decodedCoded(smolv::GetDecodedBufferSize(smolvCoded.data(), smolvCoded.size()));
+		smolv::Decode(smolvPlain.data(), smolvPlain.size(), decodedPlain.data(), decodedPlain.size());
+		uint64_t timeStart = stm_now();
+		bool ok = smolv::Decode(smolvCoded.data(), smolvCoded.size(), decodedCoded.data(), decodedCoded.size());
+		outDecodeTime += stm_since(timeStart);
+		if (!ok || decodedCoded != decodedPlain || !smolv::StatsCalculateSmol(stats, smolvCoded.data(), smolvCoded.size()))
+			++errorCount;
+
+		// truncated data should fail to decode
+		if (smolvCoded.size() != smolvPlain.size() && smolv::Decode(smolvCoded.data(), smolvCoded.size() - 1, decodedCoded.data(), decodedCoded.size()))
+			++errorCount;
+
+		// full programs, with streaming decoder
+		ByteArray smolvFull;
+		smolv::Encode(spirvs[i].data(), spirvs[i].size(), smolvFull, smolv::kEncodeFlagEntropyCode);
+		smolv::DecodeStream* stream = smolv::DecodeStreamCreate();
+		ByteArray decoded;
+		uint8_t outBuffer[1000];
+		size_t inPos = 0;
+		while (ok && !smolv::DecodeStreamIsDone(stream))
+		{
+			size_t inSize = std::min(size_t(777), smolvFull.size() - inPos);
+			size_t inUsed = 0, outWritten = 0;
+			ok = smolv::DecodeStreamProcess(stream, smolvFull.data() + inPos, inSize, &inUsed, outBuffer, sizeof(outBuffer), &outWritten);
+			inPos += inUsed;
+			decoded.insert(decoded.end(), outBuffer, outBuffer + outWritten);
+			if (inUsed == 0 && outWritten == 0)
+				break;
+		}
+		if (!ok || inPos != smolvFull.size() || decoded != spirvs[i])
+			++errorCount;
+		smolv::DecodeStreamDelete(stream);
+	}
+	smolv::StatsDelete(stats);
+	if (errorCount != 0)
+	{
+		printf("ERROR: entropy coding failed on %i programs\n", errorCount);
+		return false;
+	}
+	return true;
+}
+
+// Split streams: should decode into the same thing as the regular encoding, also when entropy coded or
+// with the streaming decoder. outSmolvAll gets all the programs (without and with stripping), for
+// checking how well that compresses.
+static bool TestSplitStreams(const std::vector<ByteArray>& spirvs, ByteArray outSmolvAll[2], uint64_t& outDecodeTime)
+{
+	outDecodeTime = 0;
+	int errorCount = 0;
+	smolv::Stats* stats = smolv::StatsCreate();
+	std::vector<ByteArray> smolvsFull;
+	for (size_t i = 0; i < spirvs.size(); ++i)
+	{
+		for (int striptype = 0; striptype < 2; ++striptype)
+		{
+			const uint32_t flags = striptype == 0 ? 0 : smolv::kEncodeFlagStripDebugInfo;
+			ByteArray smolvPlain, smolvSplit, smolvSplitCoded;
+			if (!smolv::Encode(spirvs[i].data(), spirvs[i].size(), smolvPlain, flags) ||
+				!smolv::Encode(spirvs[i].data(), spirvs[i].size(), smolvSplit, flags | smolv::kEncodeFlagSplitStreams) ||
+				!smolv::Encode(spirvs[i].data(), spirvs[i].size(), smolvSplitCoded, flags | smolv::kEncodeFlagSplitStreams | smolv::kEncodeFlagEntropyCode))
+			{
+				++errorCount;
+				continue;
+			}
+			outSmolvAll[striptype].insert(outSmolvAll[striptype].end(), smolvSplit.begin(), smolvSplit.end());
+			if (striptype == 0)
+				smolvsFull.push_back(smolvSplit);
+
+			ByteArray decodedPlain(smolv::GetDecodedBufferSize(smolvPlain.data(), smolvPlain.size()));
+			ByteArray decodedSplit(smolv::GetDecodedBufferSize(smolvSplit.data(), smolvSplit.size()));
+			ByteArray decodedSplitCoded(smolv::GetDecodedBufferSize(smolvSplitCoded.data(), smolvSplitCoded.size()));
+			smolv::Decode(smolvPlain.data(), smolvPlain.size(), decodedPlain.data(), decodedPlain.size());
+			uint64_t timeStart = stm_now();
+			bool ok = smolv::Decode(smolvSplit.data(), smolvSplit.size(), decodedSplit.data(), decodedSplit.size());
+			if (striptype == 0)
+				outDecodeTime += stm_since(timeStart);
+			ok &= smolv::Decode(smolvSplitCoded.data(), smolvSplitCoded.size(), decodedSplitCoded.data(), decodedSplitCoded.size());
+			if (!ok || decodedSplit != decodedPlain || decodedSplitCoded != decodedPlain ||
+				!smolv::StatsCalculateSmol(stats, smolvSplit.data(), smolvSplit.size()) ||
+				!smolv::StatsCalculateSmol(stats, smolvSplitCoded.data(), smolvSplitCoded.size()))
+				++errorCount;
+
+			// truncated data should fail to decode
+			if (smolv::Decode(smolvSplit.data(), smolvSplit.size() - 1, decodedSplit.data(), decodedSplit.size()))
+				++errorCount;
+		}
+	}
+	smolv::StatsDelete(stats);
+	if (errorCount != 0)
+	{
+		printf("ERROR: split streams encoding/decoding failed on %i programs\n", errorCount);
+		return false;
+	}
+	return TestDecodeStream(spirvs, smolvsFull);
+}
+
+// Restart points: should decode into the same thing as the regular encoding, with Decode, DecodeParallel
+// and streaming decoding, also when stripped or entropy coded. Split streams do not use restart points.
+static bool TestRestartPoints(const std::vector<ByteArray>& spirvs, size_t& outSizeNoRestarts, size_t& outSizeRestarts, uint64_t& outDecodeTime, uint64_t& outDecodeParallelTime)
+{
+	const size_t kRestartInterval = 4096;
+	const uint32_t kFlags[] = { 0, smolv::kEncodeFlagStripDebugInfo, smolv::kEncodeFlagEntropyCode, smolv::kEncodeFlagSplitStreams };
+	outSizeNoRestarts = outSizeRestarts = 0;
+	outDecodeTime = outDecodeParallelTime = 0;
+	int errorCount = 0;
+	smolv::Stats* stats = smolv::StatsCreate();
+	std::vector<ByteArray> spirvsDecoded, smolvsRestarts;
+	for (size_t i = 0; i < spirvs.size(); ++i)
+	{
+		for (size_t f = 0; f < sizeof(kFlags)/sizeof(kFlags[0]); ++f)
+		{
+			ByteArray smolvPlain, smolvRestarts;
+			if (!smolv::Encode(spirvs[i].data(), spirvs[i].size(), smolvPlain, kFlags[f]) ||
+				!smolv::Encode(spirvs[i].data(), spirvs[i].size(), smolvRestarts, kFlags[f], NULL, NULL, kRestartInterval))
+			{
+				++errorCount;
+				continue;
+			}
+			if (kFlags[f] == 0)
+			{
+				outSizeNoRestarts += smolvPlain.size();
+				outSizeRestarts += smolvRestarts.size();
+			}
+			if ((kFlags[f] == smolv::kEncodeFlagSplitStreams) != (smolvRestarts == smolvPlain) && spirvs[i].size() > kRestartInterval * 2)
+				++errorCount; // should have restart points, except with split streams
+
+			ByteArray decodedPlain(smolv::GetDecodedBufferSize(smolvPlain.data(), smolvPlain.size()));
+			ByteArray decoded(smolv::GetDecodedBufferSize(smolvRestarts.data(), smolvRestarts.size()));
+			ByteArray decodedParallel(decoded.size());
+			bool ok = smolv::Decode(smolvPlain.data(), smolvPlain.size(), decodedPlain.data(), decodedPlain.size());
+			uint64_t timeStart = stm_now();
+			ok &= smolv::Decode(smolvRestarts.data(), smolvRestarts.size(), decoded.data(), decoded.size());
+			if (kFlags[f] == 0)
+				outDecodeTime += stm_since(timeStart);
+			timeStart = stm_now();
+			ok &= smolv::DecodeParallel(smolvRestarts.data(), smolvRestarts.size(), decodedParallel.data(), decodedParallel.size(), 0, 4);
+			if (kFlags[f] == 0)
+				outDecodeParallelTime += stm_since(timeStart);
+			if (!ok || decoded != decodedPlain || decodedParallel != decodedPlain || !smolv::StatsCalculateSmol(stats, smolvRestarts.data(), smolvRestarts.size()))
+				++errorCount;
+			spirvsDecoded.push_back(decodedPlain);
+			smolvsRestarts.push_back(smolvRestarts);
+
+			// truncated data should fail to decode
+			if (smolv::Decode(smolvRestarts.data(), smolvRestarts.size() - 1, decoded.data(), decoded.size()) ||
+				smolv::DecodeParallel(smolvRestarts.data(), smolvRestarts.size() - 1, decoded.data(), decoded.size()))
+				++errorCount;
+		}
+	}
+	smolv::StatsDelete(stats);
+	if (errorCount != 0)
+	{
+		printf("ERROR: restart points encoding/decoding failed on %i programs\n", errorCount);
+		return false;
+	}
+	return TestDecodeStream(spirvsDecoded, smolvsRestarts);
+}
+
+struct CollectInstructions
+{
+	ByteArray words;
+	size_t count, maxCount;
+};
+
+static bool CollectInstructionsFunc(void* userData, const uint32_t* words, size_t wordCount)
+{
+	CollectInstructions* c = (CollectInstructions*)userData;
+	c->words.insert(c->words.end(), (const uint8_t*)words, (const uint8_t*)(words + wordCount));
+	return ++c->count < c->maxCount;
+}
+
+// Partial decoding: up to the first OpFunction it should be the same as the start of the fully decoded
+// program, for all section choices, kinds of encoding, and the callback variant.
+static bool TestDecodeSections(const std::vector<ByteArray>& spirvs, uint64_t& outDecodeTime)
+{
+	const uint32_t kFlags[] = { 0, smolv::kEncodeFlagStripDebugInfo, smolv::kEncodeFlagEntropyCode, smolv::kEncodeFlagSplitStreams };
+	outDecodeTime = 0;
+	int errorCount = 0;
+	for (size_t i = 0; i < spirvs.size(); ++i)
+	{
+		for (size_t f = 0; f < sizeof(kFlags)/sizeof(kFlags[0]); ++f)
+		{
+			ByteArray smolv;
+			if (!smolv::Encode(spirvs[i].data(), spirvs[i].size(), smolv, kFlags[f], NULL, NULL, f == 0 ? 0 : 1024))
+			{
+				++errorCount;
+				continue;
+			}
+			ByteArray decoded(smolv::GetDecodedBufferSize(smolv.data(), smolv.size()));
+			if (!smolv::Decode(smolv.data(), smolv.size(), decoded.data(), decoded.size()))
+			{
+				++errorCount;
+				continue;
+			}
+			// find the first OpFunction
+			const uint32_t* words = (const uint32_t*)decoded.data();
+			size_t prefixSize = 20;
+			while (prefixSize < decoded.size() && (words[prefixSize / 4] & 0xFFFF) != 54)
+				prefixSize += (words[prefixSize / 4] >> 16) * 4;
+			const ByteArray prefix(decoded.begin(), decoded.begin() + prefixSize);
+
+			ByteArray sections[smolv::kSectionFunctions + 1];
+			for (int s = smolv::kSectionCapabilities; s <= smolv::kSectionFunctions; ++s)
+			{
+				uint64_t timeStart = stm_now();
+				if (!smolv::DecodeSections(smolv.data(), smolv.size(), sections[s], s))
+					++errorCount;
+				if (f == 0 && s == smolv::kSectionTypes)
+					outDecodeTime += stm_since(timeStart);
+				// each section choice decodes into the start of the next one
+				if (s > 0 && (sections[s].size() < sections[s-1].size() || !std::equal(sections[s-1].begin(), sections[s-1].end(), sections[s].begin())))
+					++errorCount;
+			}
+			if (sections[smolv::kSectionTypes] != prefix || sections[smolv::kSectionFunctions] != decoded)
+				++errorCount;
+
+			// callback gets the same instructions, and can stop early
+			CollectInstructions collect;
+			collect.count = 0;
+			collect.maxCount = ~size_t(0);
+			if (!smolv::DecodeSections(smolv.data(), smolv.size(), CollectInstructionsFunc, &collect) ||
+				!std::equal(collect.words.begin(), collect.words.end(), prefix.begin() + 20) || collect.words.size() != prefix.size() - 20)
+				++errorCount;
+			collect.words.clear();
+			collect.count = 0;
+			collect.maxCount = 3;
+			if (!smolv::DecodeSections(smolv.data(), smolv.size(), CollectInstructionsFunc, &collect, smolv::kSectionFunctions) || collect.count != 3 ||
+				!std::equal(collect.words.begin(), collect.words.end(), decoded.begin() + 20))
+				++errorCount;
+
+			// truncated data should fail when decoding all of it
+			ByteArray partial;
+			if (smolv::DecodeSections(smolv.data(), smolv.size() - 1, partial, smolv::kSectionFunctions))
+				++errorCount;
+		}
+	}
+	if (errorCount != 0)
+	{
+		printf("ERROR: partial decoding failed on %i programs\n", errorCount);
+		return false;
+	}
+	return true;
+}
+
+// Reflection: same results for all kinds of encoding, matching what is in the SPIR-V; plus a small
+// hand-made program with known push constant block size.
+static bool TestReflect(const std::vector<ByteArray>& spirvs)
+{
+	const uint32_t kFlags[] = { smolv::kEncodeFlagStripDebugInfo, smolv::kEncodeFlagEntropyCode, smolv::kEncodeFlagSplitStreams };
+	int errorCount = 0;
+	for (size_t i = 0; i < spirvs.size(); ++i)
+	{
+		ByteArray smolv;
+		smolv::Reflection refl;
+		if (!smolv::Encode(spirvs[i].data(), spirvs[i].size(), smolv) || !smolv::Reflect(smolv.data(), smolv.size(), &refl))
+		{
+			++errorCount;
+			continue;
+		}
+		for (size_t f = 0; f < sizeof(kFlags)/sizeof(kFlags[0]); ++f)
+		{
+			smolv::Reflection other;
+			if (!smolv::Encode(spirvs[i].data(), spirvs[i].size(), smolv, kFlags[f], NULL, NULL, 1024) || !smolv::Reflect(smolv.data(), smolv.size(), &other) || memcmp(&refl, &other, sizeof(refl)) != 0)
+				++errorCount;
+		}
+
+		// count things in SPIR-V directly
+		const uint32_t* words = (const uint32_t*)spirvs[i].data();
+		const size_t wordCount = spirvs[i].size() / 4;
+		size_t entryPoints = 0, locations = 0, specConstants = 0;
+		std::vector<uint32_t> bindingIds;
+		for (size_t pos = 5; pos < wordCount; pos += words[pos] >> 16)
+		{
+			const uint32_t op = words[pos] & 0xFFFF;
+			if (op == 54) // Function
+				break;
+			if (op == 15) // EntryPoint
+				++entryPoints;
+			if (op == 71 && words[pos + 2] == 30) // Decorate Location
+				++locations;
+			if (op == 71 && words[pos + 2] == 1) // Decorate SpecId
+				++specConstants;
+			if (op == 71 && (words[pos + 2] == 33 || words[pos + 2] == 34) && std::find(bindingIds.begin(), bindingIds.end(), words[pos + 1]) == bindingIds.end()) // Binding, DescriptorSet
+				bindingIds.push_back(words[pos + 1]);
+		}
+		const bool truncated = entryPoints > smolv::kReflectMaxEntryPoints || bindingIds.size() > smolv::kReflectMaxBindings ||
+			locations > smolv::kReflectMaxLocations || specConstants > smolv::kReflectMaxSpecConstants;
+		if (refl.truncated != truncated ||
+			refl.entryPointCount != std::min<size_t>(entryPoints, smolv::kReflectMaxEntryPoints) ||
+			refl.bindingCount != std::min<size_t>(bindingIds.size(), smolv::kReflectMaxBindings) ||
+			refl.locationCount != std::min<size_t>(locations, smolv::kReflectMaxLocations) ||
+			refl.specConstantCount != std::min<size_t>(specConstants, smolv::kReflectMaxSpecConstants))
+			++errorCount;
+	}
+
+	// struct { float; mat4 (stride 16); vec3[2] (stride 16) } push constant block is 112 bytes
+	const uint32_t program[] =
+	{
+		0x07230203, 0x00010000, 0, 30, 0,
+		(2 << 16) | 17, 1, // Capability Shader
+		(3 << 16) | 14, 0, 1, // MemoryModel
+		(5 << 16) | 15, 0, 1, 0x6E69616D, 0, // EntryPoint Vertex %1 "main"
+		(4 << 16) | 71, 20, 33, 3, // Decorate %20 Binding 3
+		(4 << 16) | 71, 20, 34, 1, // Decorate %20 DescriptorSet 1
+		(4 << 16) | 71, 21, 30, 2, // Decorate %21 Location 2
+		(4 << 16) | 71, 22, 1, 7, // Decorate %22 SpecId 7
+		(4 << 16) | 71, 8, 6, 16, // Decorate %8 ArrayStride 16
+		(5 << 16) | 72, 10, 0, 35, 0, // MemberDecorate %10 0 Offset 0
+		(5 << 16) | 72, 10, 1, 35, 16, // MemberDecorate %10 1 Offset 16
+		(4 << 16) | 72, 10, 1, 5, // MemberDecorate %10 1 ColMajor
+		(5 << 16) | 72, 10, 1, 7, 16, // MemberDecorate %10 1 MatrixStride 16
+		(5 << 16) | 72, 10, 2, 35, 80, // MemberDecorate %10 2 Offset 80
+		(3 << 16) | 71, 10, 2, // Decorate %10 Block
+		(3 << 16) | 22, 3, 32, // %3 = TypeFloat 32
+		(4 << 16) | 23, 4, 3, 3, // %4 = TypeVector %3 3
+		(4 << 16) | 23, 5, 3, 4, // %5 = TypeVector %3 4
+		(4 << 16) | 24, 6, 5, 4, // %6 = TypeMatrix %5 4
+		(4 << 16) | 21, 11, 32, 0, // %11 = TypeInt 32 0
+		(4 << 16) | 43, 11, 12, 2, // %12 = Constant %11 2
+		(4 << 16) | 28, 8, 4, 12, // %8 = TypeArray %4 %12
+		(5 << 16) | 30, 10, 3, 6, 8, // %10 = TypeStruct %3 %6 %8
+		(4 << 16) | 32, 13, 9, 10, // %13 = TypePointer PushConstant %10
+		(4 << 16) | 59, 13, 14, 9, // %14 = Variable %13 PushConstant
+		(4 << 16) | 32, 15, 2, 10, // %15 = TypePointer Uniform %10
+		(4 << 16) | 59, 15, 20, 2, // %20 = Variable %15 Uniform
+		(4 << 16) | 32, 16, 1, 5, // %16 = TypePointer Input %5
+		(4 << 16) | 59, 16, 21, 1, // %21 = Variable %16 Input
+		(4 << 16) | 50, 11, 22, 5, // %22 = SpecConstant %11 5
+		(2 << 16) | 19, 2, // %2 = TypeVoid
+		(3 << 16) | 33, 17, 2, // %17 = TypeFunction %2
+		(5 << 16) | 54, 2, 1, 0, 17, // %1 = Function %2 None %17
+		(2 << 16) | 248, 18, // Label
+		(1 << 16) | 253, // Return
+		(1 << 16) | 56, // FunctionEnd
+	};
+	ByteArray smolv;
+	smolv::Reflection refl;
+	if (!smolv::Encode(program, sizeof(program), smolv) || !smolv::Reflect(smolv.data(), smolv.size(), &refl) ||
+		refl.truncated || refl.pushConstantSize != 112 ||
+		refl.entryPointCount != 1 || refl.entryPoints[0].executionModel != 0 || refl.entryPoints[0].id != 1 || strcmp(refl.entryPoints[0].name, "main") != 0 ||
+		refl.bindingCount != 1 || refl.bindings[0].id != 20 || refl.bindings[0].storageClass != 2 || refl.bindings[0].set != 1 || refl.bindings[0].binding != 3 ||
+		refl.locationCount != 1 || refl.locations[0].id != 21 || refl.locations[0].storageClass != 1 || refl.locations[0].location != 2 ||
+		refl.specConstantCount != 1 || refl.specConstants[0].id != 22 || refl.specConstants[0].specId != 7)
+		++errorCount;
+
+	// struct { float; layout(row_major) mat3x4 (stride 16) } push constant block is 80 bytes; with
+	// glslang decoration order (RowMajor before Offset)
+	const uint32_t programRowMajor[] =
+	{
+		0x07230203, 0x00010000, 0, 20, 0,
+		(2 << 16) | 17, 1, // Capability Shader
+		(3 << 16) | 14, 0, 1, // MemoryModel
+		(5 << 16) | 15, 0, 1, 0x6E69616D, 0, // EntryPoint Vertex %1 "main"
+		(5 << 16) | 72, 10, 0, 35, 0, // MemberDecorate %10 0 Offset 0
+		(4 << 16) | 72, 10, 1, 4, // MemberDecorate %10 1 RowMajor
+		(5 << 16) | 72, 10, 1, 35, 16, // MemberDecorate %10 1 Offset 16
+		(5 << 16) | 72, 10, 1, 7, 16, // MemberDecorate %10 1 MatrixStride 16
+		(3 << 16) | 71, 10, 2, // Decorate %10 Block
+		(3 << 16) | 22, 3, 32, // %3 = TypeFloat 32
+		(4 << 16) | 23, 5, 3, 4, // %5 = TypeVector %3 4
+		(4 << 16) | 24, 6, 5, 3, // %6 = TypeMatrix %5 3
+		(4 << 16) | 30, 10, 3, 6, // %10 = TypeStruct %3 %6
+		(4 << 16) | 32, 13, 9, 10, // %13 = TypePointer PushConstant %10
+		(4 << 16) | 59, 13, 14, 9, // %14 = Variable %13 PushConstant
+		(2 << 16) | 19, 2, // %2 = TypeVoid
+		(3 << 16) | 33, 17, 2, // %17 = TypeFunction %2
+		(5 << 16) | 54, 2, 1, 0, 17, // %1 = Function %2 None %17
+		(2 << 16) | 248, 18, // Label
+		(1 << 16) | 253, // Return
+		(1 << 16) | 56, // FunctionEnd
+	};
+	smolv.clear();
+	if (!smolv::Encode(programRowMajor, sizeof(programRowMajor), smolv) || !smolv::Reflect(smolv.data(), smolv.size(), &refl) ||
+		refl.truncated || refl.pushConstantSize != 80)
+		++errorCount;
+
+	if (errorCount != 0)
+	{
+		printf("ERROR: reflection failed on %i programs\n", errorCount);
+		return false;
+	}
+	return true;
+}
+
+// Content hash: stored hash matches the decoded program (also stripped, entropy coded etc.), and is
+// verified by decoding functions; a wrong hash makes them fail.
+static bool TestContentHash(const std::vector<ByteArray>& spirvs)
+{
+	const uint32_t kFlags[] = { 0, smolv::kEncodeFlagStripDebugInfo, smolv::kEncodeFlagEntropyCode, smolv::kEncodeFlagSplitStreams };
+	int errorCount = 0;
+	// XXH64 reference values
+	if (smolv::ContentHash("", 0) != 0xEF46DB3751D8E999ull || smolv::ContentHash("abc", 3) != 0x44BC2CF5AD770999ull ||
+		smolv::ContentHash("Nobody inspects the spammish repetition", 39) != 0xFBCEA83C8A378BF1ull)
+		++errorCount;
+	for (size_t i = 0; i < spirvs.size(); ++i)
+	{
+		for (size_t f = 0; f < sizeof(kFlags)/sizeof(kFlags[0]); ++f)
+		{
+			ByteArray smolvPlain, smolv;
+			uint64_t hash = 0;
+			if (!smolv::Encode(spirvs[i].data(), spirvs[i].size(), smolvPlain, kFlags[f]) ||
+				!smolv::Encode(spirvs[i].data(), spirvs[i].size(), smolv, kFlags[f] | smolv::kEncodeFlagContentHash, NULL, NULL, f == 0 ? 4096 : 0) ||
+				smolv::GetContentHash(smolvPlain.data(), smolvPlain.size(), &hash) ||
+				!smolv::GetContentHash(smolv.data(), smolv.size(), &hash))
+			{
+				++errorCount;
+				continue;
+			}
+			ByteArray decoded(smolv::GetDecodedBufferSize(smolv.data(), smolv.size()));
+			bool ok = smolv::Decode(smolv.data(), smolv.size(), decoded.data(), decoded.size(), smolv::kDecodeFlagVerifyHash);
+			ok &= smolv::ContentHash(decoded.data(), decoded.size()) == hash;
+			ok &= smolv::DecodeParallel(smolv.data(), smolv.size(), decoded.data(), decoded.size(), smolv::kDecodeFlagVerifyHash, 2);
+			ok &= !smolv::Decode(smolvPlain.data(), smolvPlain.size(), decoded.data(), decoded.size(), smolv::kDecodeFlagVerifyHash); // no hash to verify
+			if (kFlags[f] == 0)
+				ok &= hash == smolv::ContentHash(spirvs[i].data(), spirvs[i].size());
+
+			// streaming decoding, output in small pieces
+			smolv::DecodeStream* stream = smolv::DecodeStreamCreate(smolv::kDecodeFlagVerifyHash);
+			size_t inPos = 0;
+			uint8_t outBuffer[100];
+			while (ok && !smolv::DecodeStreamIsDone(stream))
+			{
+				size_t inUsed = 0, outWritten = 0;
+				ok = smolv::DecodeStreamProcess(stream, smolv.data() + inPos, smolv.size() - inPos, &inUsed, outBuffer, sizeof(outBuffer), &outWritten);
+				inPos += inUsed;
+			}
+			smolv::DecodeStreamDelete(stream);
+
+			// wrong hash should fail to verify, but decode fine otherwise
+			smolv[28] ^= 1;
+			ok &= smolv::Decode(smolv.data(), smolv.size(), decoded.data(), decoded.size());
+			ok &= !smolv::Decode(smolv.data(), smolv.size(), decoded.data(), decoded.size(), smolv::kDecodeFlagVerifyHash);
+			stream = smolv::DecodeStreamCreate(smolv::kDecodeFlagVerifyHash);
+			size_t inUsed = 0, outWritten = 0;
+			ok &= !smolv::DecodeStreamProcess(stream, smolv.data(), smolv.size(), &inUsed, decoded.data(), decoded.size(), &outWritten);
+			smolv::DecodeStreamDelete(stream);
+			if (!ok)
+				++errorCount;
+		}
+	}
+	if (errorCount != 0)
+	{
+		printf("ERROR: content hash failed on %i programs\n", errorCount);
+		return false;
+	}
+	return true;
+}
+
+static bool TestValidate(const std::vector<ByteArray>& spirvs, const std::vector<ByteArray>& smolvs)
+{
+	int errorCount = 0;
+	for (size_t i = 0; i < spirvs.size(); ++i)
+	{
+		ByteArray smolvRestarts, smolvHash;
+		smolv::Encode(spirvs[i].data(), spirvs[i].size(), smolvRestarts, smolv::kEncodeFlagStripDebugInfo, NULL, NULL, 4096);
+		smolv::Encode(spirvs[i].data(), spirvs[i].size(), smolvHash, smolv::kEncodeFlagEntropyCode | smolv::kEncodeFlagContentHash);
+		const ByteArray* datas[] = { &smolvs[i], &smolvRestarts, &smolvHash };
+		for (size_t d = 0; d < sizeof(datas)/sizeof(datas[0]); ++d)
+		{
+			ByteArray smolv = *datas[d];
+			ByteArray decoded(smolv::GetDecodedBufferSize(smolv.data(), smolv.size()));
+			ByteArray decodedTrusted(decoded.size());
+			bool ok = smolv::Validate(smolv.data(), smolv.size());
+			ok &= smolv::Decode(smolv.data(), smolv.size(), decoded.data(), decoded.size());
+			ok &= smolv::Decode(smolv.data(), smolv.size(), decodedTrusted.data(), decodedTrusted.size(), smolv::kDecodeFlagTrusted);
+			ok &= decoded == decodedTrusted;
+			ok &= smolv::DecodeParallel(smolv.data(), smolv.size(), decodedTrusted.data(), decodedTrusted.size(), smolv::kDecodeFlagTrusted, 2);
+			ok &= decoded == decodedTrusted;
+			// truncated data does not validate
+			ok &= !smolv::Validate(smolv.data(), smolv.size() - 1);
+
+			// corrupted data: whatever passes validation has to decode the same when trusted
+			uint32_t rng = uint32_t(i * 3 + d + 1);
+			for (int c = 0; c < 16; ++c)
+			{
+				smolv = *datas[d];
+				rng = rng * 1103515245u + 12345u;
+				smolv[24 + (rng >> 8) % (smolv.size() - 24)] ^= uint8_t(1 << ((rng >> 4) & 7));
+				if (!smolv::Validate(smolv.data(), smolv.size()))
+					continue;
+				decoded.resize(smolv::GetDecodedBufferSize(smolv.data(), smolv.size()));
+				decodedTrusted.resize(decoded.size());
+				ok &= smolv::Decode(smolv.data(), smolv.size(), decoded.data(), decoded.size());
+				ok &= smolv::Decode(smolv.data(), smolv.size(), decodedTrusted.data(), decodedTrusted.size(), smolv::kDecodeFlagTrusted);
+				ok &= decoded == decodedTrusted;
+			}
+			if (!ok)
+				++errorCount;
+		}
+	}
+
+	// overlong varints (first instruction length+opcode at byte 28) do not validate, even when they
+	// would otherwise decode to the same value: 6 bytes long, or 5 bytes with payload above bit 31
+	if (!smolvs.empty())
+	{
+		const ByteArray& smolv = smolvs[0];
+		size_t len = 1;
+		while (smolv[28 + len - 1] & 0x80)
+			++len;
+		ByteArray overlong6(smolv.begin(), smolv.begin() + 28);
+		for (size_t b = 0; b < 5; ++b)
+			overlong6.push_back(b < len ? (smolv[28 + b] | 0x80) : 0x80);
+		overlong6.push_back(0);
+		overlong6.insert(overlong6.end(), smolv.begin() + 28 + len, smolv.end());
+		ByteArray overlong5 = overlong6;
+		overlong5[28 + 4] = 0x10;
+		overlong5.erase(overlong5.begin() + 28 + 5);
+		if (smolv::Validate(overlong6.data(), overlong6.size()) || smolv::Validate(overlong5.data(), overlong5.size()))
+			++errorCount;
+	}
+	if (errorCount != 0)
+	{
+		printf("ERROR: validate/trusted decoding failed on %i programs\n", errorCount);
+		return false;
+	}
+	return true;
+}
+
+static bool TestStatsBatch(const std::vector<ByteArray>& spirvs, const std::vector<ByteArray>& smolvs)
+{
+	std::vector<const void*> spirvDatas, smolvDatas;
+	std::vector<size_t> spirvSizes, smolvSizes;
+	for (size_t i = 0; i < spirvs.size(); ++i)
+	{
+		spirvDatas.push_back(spirvs[i].data());
+		spirvSizes.push_back(spirvs[i].size());
+		smolvDatas.push_back(smolvs[i].data());
+		smolvSizes.push_back(smolvs[i].size());
+	}
+	smolv::Stats* stats = smolv::StatsCreate();
+	smolv::Stats* statsOther = smolv::StatsCreate();
+	bool ok = smolv::StatsCalculateBatch(stats, spirvDatas.data(), spirvSizes.data(), spirvDatas.size(), 4);
+	ok &= smolv::StatsCalculateSmolBatch(statsOther, smolvDatas.data(), smolvSizes.data(), smolvDatas.size(), 4);
+	smolv::StatsMerge(stats, statsOther);
+	ok &= smolv::StatsCalculateBatch(stats, NULL, NULL, 0);
+
+	// same as collecting everything on one thread
+	smolv::Stats* statsSingle = smolv::StatsCreate();
+	for (size_t i = 0; i < spirvs.size(); ++i)
+	{
+		ok &= smolv::StatsCalculate(statsSingle, spirvs[i].data(), spirvs[i].size());
+		ok &= smolv::StatsCalculateSmol(statsSingle, smolvs[i].data(), smolvs[i].size());
+	}
+	ByteArray json, jsonSingle, csv;
+	smolv::StatsExportJson(stats, json);
+	smolv::StatsExportJson(statsSingle, jsonSingle);
+	ok &= json == jsonSingle && !json.empty();
+	smolv::StatsDelete(statsSingle);
+
+	// per op SMOL-V size is the sum of sizes of the encoded parts
+	smolv::StatsExportCsv(stats, csv);
+	csv.push_back(0);
+	const char* line = strchr((const char*)csv.data(), '\n');
+	int rows = 0, sparseRows = 0;
+	size_t totalCount = 0;
+	while (line && line[1])
+	{
+		++line;
+		char name[64];
+		int op;
+		size_t count, spirvBytes, smolvCount, smolvBytes, parts[8];
+		if (sscanf(line, "%63[^,],%i,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu", name, &op, &count, &spirvBytes, &smolvCount, &smolvBytes,
+			&parts[0], &parts[1], &parts[2], &parts[3], &parts[4], &parts[5], &parts[6], &parts[7]) != 14)
+		{
+			ok = false;
+			break;
+		}
+		size_t sum = 0;
+		for (int p = 0; p < 8; ++p)
+			sum += parts[p];
+		ok &= sum == smolvBytes;
+		totalCount += count;
+		sparseRows += op >= 400; // ops past GroupNonUniformQuadSwap have their own rows too
+		++rows;
+		line = strchr(line, '\n');
+	}
+	ok &= rows > 100 && sparseRows > 0;
+	// all instructions are in some row
+	const char* instructions = strstr((const char*)json.data(), "\"instructions\": ");
+	ok &= instructions && strtoull(instructions + 16, NULL, 10) == totalCount;
+	// too long varints in malformed data fail
+	ByteArray broken = smolvs[0];
+	std::fill(broken.begin() + 28, broken.end(), 0xFF);
+	ok &= !smolv::StatsCalculateSmol(statsOther, broken.data(), broken.size());
+	// malformed program fails the whole batch
+	smolvSizes[smolvSizes.size() / 2] = 10;
+	ok &= !smolv::StatsCalculateSmolBatch(statsOther, smolvDatas.data(), smolvSizes.data(), smolvDatas.size(), 4);
+	smolv::StatsDelete(statsOther);
+	smolv::StatsDelete(stats);
+	if (!ok)
+	{
+		printf("ERROR: batch stats calculation failed\n");
+		return false;
+	}
+	return true;
+}
+
+static bool TestCanonicalizeIds(const std::vector<ByteArray>& spirvs, size_t& outSize)
+{
+	const uint32_t kFlags = smolv::kEncodeFlagStripDebugInfo | smolv::kEncodeFlagCanonicalizeIds;
+	int errorCount = 0;
+	outSize = 0;
+	for (size_t i = 0; i < spirvs.size(); ++i)
+	{
+		ByteArray smolv, smolvAgain, smolvRemapped;
+		if (!smolv::Encode(spirvs[i].data(), spirvs[i].size(), smolv, kFlags))
+		{
+			++errorCount;
+			continue;
+		}
+		outSize += smolv.size();
+		ByteArray decoded(smolv::GetDecodedBufferSize(smolv.data(), smolv.size()));
+		bool ok = smolv::Decode(smolv.data(), smolv.size(), decoded.data(), decoded.size());
+		// canonical program stays the same
+		ok &= smolv::Encode(decoded.data(), decoded.size(), smolvAgain, kFlags) && smolvAgain == smolv;
+		// same program with different ID numbering (by glslang remapper) encodes the same;
+		// except when remapper fails, or there is ExecutionModeId (remapper does not renumber its operands)
+		std::vector<uint32_t> remapped((const uint32_t*)spirvs[i].data(), (const uint32_t*)spirvs[i].data() + spirvs[i].size() / 4);
+		bool hasExecutionModeId = false;
+		for (size_t pos = 5; pos < remapped.size() && (remapped[pos] >> 16) != 0; pos += remapped[pos] >> 16)
+			hasExecutionModeId |= (remapped[pos] & 0xFFFF) == 331; // OpExecutionModeId
+		spv::spirvbin_t remapper;
+		s_RemapFailed = false;
+		remapper.remap(remapped, spv::spirvbin_t::MAP_TYPES | spv::spirvbin_t::MAP_NAMES);
+		if (!s_RemapFailed && !hasExecutionModeId)
+			ok &= smolv::Encode(remapped.data(), remapped.size() * 4, smolvRemapped, kFlags) && smolvRemapped == smolv;
+		if (!ok)
+			++errorCount;
+	}
+	if (errorCount != 0)
+	{
+		printf("ERROR: ID canonicalization failed on %i programs\n", errorCount);
+		return false;
+	}
+	return true;
+}
+
+// Program with every op value from 300 up, including ones that SMOL-V remaps (sparse ray tracing,
+// mesh shading etc. ops) and ones that are not valid SPIR-V; all should go through unchanged.
+static bool TestSparseOps()
+{
+	std::vector<uint32_t> words = { 0x07230203, 0x00010600, 0, 100, 0 };
+	for (uint32_t op = 300; op <= 0xFFFF; ++op)
+	{
+		const uint32_t instr[] = { (5u << 16) | op, 1, 2, op & 7, 4 };
+		words.insert(words.end(), instr, instr + 5);
+	}
+	ByteArray smolv;
+	if (!smolv::Encode(words.data(), words.size() * 4, smolv))
+	{
+		printf("ERROR: failed to encode program with sparse ops\n");
+		return false;
+	}
+	std::vector<uint32_t> decoded(words.size());
+	if (smolv::GetDecodedBufferSize(smolv.data(), smolv.size()) != words.size() * 4
+		|| !smolv::Decode(smolv.data(), smolv.size(), decoded.data(), decoded.size() * 4)
+		|| decoded != words)
+	{
+		printf("ERROR: failed to decode program with sparse ops\n");
+		return false;
+	}
+	return true;
+}
+
+// Constants of all the numeric types, with "nice" and not so nice values (NaNs, denormals, wrong
+// literal sizes for the type, more types than SMOL-V remembers); all should go through unchanged.
+static bool TestConstants()
+{
+	std::vector<uint32_t> words = { 0x07230203, 0x00010600, 0, 1000, 0 };
+	const uint32_t kTypes[][4] = {
+		{ (4u << 16) | 21, 1, 32, 1 }, // TypeInt 32 signed
+		{ (4u << 16) | 21, 2, 64, 0 }, // TypeInt 64 unsigned
+		{ (3u << 16) | 22, 3, 32, 0 }, // TypeFloat 32
+		{ (3u << 16) | 22, 4, 64, 0 }, // TypeFloat 64
+		{ (4u << 16) | 21, 5, 16, 1 }, // TypeInt 16 signed
+	};
+	for (size_t i = 0; i < sizeof(kTypes) / sizeof(kTypes[0]); ++i)
+		words.insert(words.end(), kTypes[i], kTypes[i] + (kTypes[i][0] >> 16));
+	for (uint32_t id = 6; id < 30; ++id)
+	{
+		const uint32_t instr[] = { (4u << 16) | 21, id, 32, 0 };
+		words.insert(words.end(), instr, instr + 4);
+	}
+	const uint32_t kValues[] = { 0, 1, 0xFFFFFFFF, 0x7FFFFFFF, 0x80000000, 12345, 0x3F800000, 0xBF000000, 0x7F800000, 0x7FC00000, 0x00000001, 0x3DCCCCCD, 0x3FF00000, 0x9999999A, 0xFFF00000 };
+	const size_t kValueCount = sizeof(kValues) / sizeof(kValues[0]);
+	uint32_t result = 100;
+	for (uint32_t type = 1; type < 30; ++type)
+	{
+		for (size_t i = 0; i < kValueCount; ++i)
+		{
+			const uint32_t instr[] = { (4u << 16) | 43, type, result++, kValues[i] };
+			words.insert(words.end(), instr, instr + 4);
+			const uint32_t instr64[] = { (5u << 16) | 43, type, result++, kValues[i], kValues[(i * 7 + 3) % kValueCount] };
+			words.insert(words.end(), instr64, instr64 + 5);
+		}
+		const uint32_t empty[] = { (3u << 16) | 43, type, result++ };
+		words.insert(words.end(), empty, empty + 3);
+	}
+	ByteArray smolv;
+	if (!smolv::Encode(words.data(), words.size() * 4, smolv))
+	{
+		printf("ERROR: failed to encode program with constants\n");
+		return false;
+	}
+	std::vector<uint32_t> decoded(words.size());
+	if (smolv::GetDecodedBufferSize(smolv.data(), smolv.size()) != words.size() * 4
+		|| !smolv::Decode(smolv.data(), smolv.size(), decoded.data(), decoded.size() * 4)
+		|| decoded != words)
+	{
+		printf("ERROR: failed to decode program with constants\n");
+		return false;
+	}
+	return true;
+}
+
+// Program with NonSemantic.Shader.DebugInfo.100 debug info; stripping should remove its ExtInstImport,
+// all its ExtInst instructions and the OpStrings they use, and leave the rest (incl. other ExtInsts) as is.
+static bool TestStripNonSemanticDebugInfo()
+{
+	std::vector<uint32_t> words = { 0x07230203, 0x00010600, 0, 20, 0 };
+	std::vector<uint32_t> expected = words;
+	auto add = [&](bool kept, std::vector<uint32_t> instr, const char* str)
+	{
+		// string literal goes at the end, zero padded to whole words
+		const size_t strWords = str ? strlen(str) / 4 + 1 : 0;
+		const size_t strPos = instr.size();
+		instr.resize(instr.size() + strWords, 0);
+		if (str)
+			memcpy(&instr[strPos], str, strlen(str));
+		instr[0] |= uint32_t(instr.size()) << 16;
+		words.insert(words.end(), instr.begin(), instr.end());
+		if (kept)
+			expected.insert(expected.end(), instr.begin(), instr.end());
+	};
+	add(true, { 17, 1 }, NULL); // Capability Shader
+	add(true, { 10 }, "SPV_KHR_non_semantic_info"); // Extension
+	add(true, { 11, 1 }, "GLSL.std.450"); // ExtInstImport
+	add(false, { 11, 2 }, "NonSemantic.Shader.DebugInfo.100"); // ExtInstImport
+	add(true, { 14, 0, 1 }, NULL); // MemoryModel
+	add(false, { 7, 3 }, "shader.hlsl"); // String
+	const size_t voidPos = expected.size() + 1;
+	add(true, { 19, 4 }, NULL); // TypeVoid
+	add(true, { 22, 5, 32 }, NULL); // TypeFloat
+	add(true, { 33, 6, 4 }, NULL); // TypeFunction
+	add(true, { 43, 5, 7, 0x3F800000 }, NULL); // Constant 1.0
+	add(false, { 12, 4, 8, 2, 35, 3 }, NULL); // DebugSource
+	add(false, { 12, 4, 9, 2, 1, 7, 7, 8, 7 }, NULL); // DebugCompilationUnit
+	add(true, { 54, 4, 10, 0, 6 }, NULL); // Function
+	add(true, { 248, 11 }, NULL); // Label
+	add(false, { 12, 4, 12, 2, 23, 9 }, NULL); // DebugScope
+	add(true, { 12, 5, 13, 1, 4, 7 }, NULL); // GLSL.std.450 FAbs
+	add(false, { 12, 4, 14, 2, 24 }, NULL); // DebugNoScope
+	add(true, { 253 }, NULL); // Return
+	add(true, { 56 }, NULL); // FunctionEnd
+
+	ByteArray smolv;
+	if (!smolv::Encode(words.data(), words.size() * 4, smolv, smolv::kEncodeFlagStripDebugInfo))
+	{
+		printf("ERROR: failed to encode program with non-semantic debug info\n");
+		return false;
+	}
+	std::vector<uint32_t> decoded(expected.size());
+	if (smolv::GetDecodedBufferSize(smolv.data(), smolv.size()) != expected.size() * 4
+		|| !smolv::Decode(smolv.data(), smolv.size(), decoded.data(), decoded.size() * 4)
+		|| decoded != expected)
+	{
+		printf("ERROR: failed to strip non-semantic debug info\n");
+		return false;
+	}
+	// same with canonical IDs: stripped instructions do not affect the numbering
+	ByteArray smolvCanonical;
+	if (!smolv::Encode(words.data(), words.size() * 4, smolvCanonical, smolv::kEncodeFlagStripDebugInfo | smolv::kEncodeFlagCanonicalizeIds)
+		|| smolv::GetDecodedBufferSize(smolvCanonical.data(), smolvCanonical.size()) != expected.size() * 4
+		|| !smolv::Decode(smolvCanonical.data(), smolvCanonical.size(), decoded.data(), decoded.size() * 4)
+		|| decoded[voidPos] != 2) // TypeVoid right after GLSL.std.450 import
+	{
+		printf("ERROR: failed to strip non-semantic debug info with canonical IDs\n");
+		return false;
+	}
+	return true;
+}
+
 int main()
 {
 	spv::spirvbin_t::registerErrorHandler([](const std::string& msg)
 	{
 		printf("ERROR: SPIR-V Remapping failed %s\n", msg.c_str());
+		s_RemapFailed = true;
 	});
 
 	stm_setup();
 	smolv::Stats* stats = smolv::StatsCreate();
 
-	#define TEST_BLENDER 1
-	#define TEST_UNITY 1
-	#define TEST_TALOS 1
-	#define TEST_DOTA2 1
-	#define TEST_SHADERTOY 1
-	#define TEST_DXC 1
-	#define TEST_GLSLANG 1
-	#define TEST_SYNTHETIC 1
-
-	// files we're testing on
-	const char* kFiles[] =
-	{
-		#if TEST_BLENDER
-		// Some shaders used by Blender 4.3 alpha (SPV 1.5 and 1.6)
-		"blender/43_eevee_deferred_capture_eval_frag.spv",
-		"blender/43_eevee_deferred_light_triple_frag.spv",
-		"blender/43_eevee_deferred_thickness_amend_frag.spv",
-		"blender/43_eevee_film_comp_comp.spv",
-		"blender/43_eevee_ray_trace_screen_comp.spv",
-		"blender/43_eevee_surfel_light_comp.spv",
-		"blender/43_spv16_eevee_film_frag_frag.spv",
-		"blender/43_spv16_eevee_ray_denoise_bilateral_comp.spv",
-		"blender/43_spv16_overlay_edit_mesh_edge_next_vert.spv",
-		#endif
-		#if TEST_UNITY
-		// Shaders produced by Unity's pipeline (HLSL -> DX11 bytecode -> HLSLcc -> glslang):
-		// vertex shaders
-		"unity/s0-0001-32333750.spirv",
-		"unity/s0-0002-ca3af858.spirv",
-		"unity/s0-0003-6ccb7b5e.spirv",
-		"unity/s0-0004-9218583a.spirv",
-		"unity/s0-0004-d2ba7e35.spirv",
-		"unity/s0-0005-1eb77240.spirv",
-		"unity/s0-0006-c36e44b3.spirv",
-		"unity/s0-0007-3454fc86.spirv",
-		"unity/s0-0007-ca8748eb.spirv",
-		"unity/s0-0008-ecc6f669.spirv",
-		"unity/s0-0009-e4ff870b.spirv",
-		"unity/s0-0010-9379a08b.spirv",
-		"unity/s0-0011-19016092.spirv",
-		"unity/s0-0011-fe5ada8b.spirv",
-		"unity/s0-0012-fba002b2.spirv",
-		"unity/s0-0012-fc99d1e7.spirv",
-		"unity/s0-0013-2190e4b3.spirv",
-		"unity/s0-0013-aaccb753.spirv",
-		"unity/s0-0013-b945d8f9.spirv",
-		"unity/s0-0014-3ba60738.spirv",
-		"unity/s0-0014-42341ba0.spirv",
-		"unity/s0-0015-1b4af3ab.spirv",
-		"unity/s0-0016-cc22f312.spirv",
-		"unity/s0-0017-9d156c5b.spirv",
-		"unity/s0-0018-267005da.spirv",
-		"unity/s0-0019-68bab1cd.spirv",
-		"unity/s0-0020-cb89e824.spirv",
-		"unity/s0-0021-774ade5f.spirv",
-		"unity/s0-0023-e226aa8a.spirv",
-		"unity/s0-0024-9b5e5139.spirv",
-		"unity/s0-0025-e1567d6d.spirv",
-		"unity/s0-0026-717968d2.spirv",
-		"unity/s0-0027-223d615c.spirv",
-		"unity/s0-0028-290869cd.spirv",
-		"unity/s0-0029-fc9c1174.spirv",
-		"unity/s0-0031-1a0d9226.spirv",
-		"unity/s0-0032-9f4fab1d.spirv",
-		"unity/s0-0034-5c3d45dc.spirv",
-		"unity/s0-0045-f2078956.spirv",
-		"unity/s0-0046-0b926d9c.spirv",
-		"unity/runtime-src-13068-dst-3560-0.spirv",
-		"unity/runtime-src-17012-dst-4567-0.spirv",
-		"unity/runtime-src-19860-dst-5708-0.spirv",
-		// fragment shaders
-		"unity/s1-0000-5ca04fe4.spirv",
-		"unity/s1-0000-cf9fe2e0.spirv",
-		"unity/s1-0001-04d9d27b.spirv",
-		"unity/s1-0001-aa1ecaf0.spirv",
-		"unity/s1-0002-8d2ed6da.spirv",
-		"unity/s1-0003-c54216ae.spirv",
-		"unity/s1-0004-ac0f5549.spirv",
-		"unity/s1-0005-93ebd823.spirv",
-		"unity/s1-0006-85d79507.spirv",
-		"unity/s1-0007-aff64c99.spirv",
-		"unity/s1-0008-6e421249.spirv",
-		"unity/s1-0009-0c858280.spirv",
-		"unity/s1-0010-1b50ab90.spirv",
-		"unity/s1-0011-2fed16ab.spirv",
-		"unity/s1-0011-f3d46288.spirv",
-		"unity/s1-0012-21b778d5.spirv",
-		"unity/s1-0012-5428b42d.spirv",
-		"unity/s1-0013-241e9fc8.spirv",
-		"unity/s1-0013-35edd084.spirv",
-		"unity/s1-0014-2ea8dc83.spirv",
-		"unity/s1-0014-5c2d2a73.spirv",
-		"unity/s1-0015-3b3a60bf.spirv",
-		"unity/s1-0016-3c30e5e7.spirv",
-		"unity/s1-0016-40492bcb.spirv",
-		"unity/s1-0017-6c18345b.spirv",
-		"unity/s1-0017-884cc79d.spirv",
-		"unity/s1-0018-319798ba.spirv",
-		"unity/s1-0019-1e7cb4ff.spirv",
-		"unity/s1-0020-7363f5c5.spirv",
-		"unity/s1-0021-e914f581.spirv",
-		"unity/s1-0022-30eff697.spirv",
-		"unity/s1-0024-0ce8d0e7.spirv",
-		"unity/s1-0025-3c7f4035.spirv",
-		"unity/s1-0026-1db01998.spirv",
-		"unity/s1-0027-51fa0f15.spirv",
-		"unity/s1-0028-84042ffc.spirv",
-		"unity/s1-0029-8b7741ae.spirv",
-		"unity/s1-0030-b919e80f.spirv",
-		"unity/s1-0032-c069697f.spirv",
-		"unity/s1-0033-0b804090.spirv",
-		"unity/s1-0034-bad8bbff.spirv",
-		"unity/s1-0035-e2a55d77.spirv",
-		"unity/s1-0036-6bbcc1ac.spirv",
-		"unity/s1-0037-e09cedbe.spirv",
-		"unity/s1-0038-e85d5917.spirv",
-		"unity/s1-0039-09bb7e61.spirv",
-		"unity/s1-0041-834a25b0.spirv",
-		"unity/s1-0043-026e1b4a.spirv",
-		"unity/s1-0045-f49f5967.spirv",
-		"unity/s1-0047-9c22101b.spirv",
-		"unity/s1-0049-6dd06f97.spirv",
-		"unity/s1-0052-d2e4133a.spirv",
-		"unity/s1-0053-511daec1.spirv",
-		"unity/s1-0054-b2b7e6c0.spirv",
-		"unity/s1-0055-66f03021.spirv",
-		"unity/s1-0056-89c781a9.spirv",
-		"unity/s1-0057-87e01eae.spirv",
-		"unity/s1-0062-e52c10e6.spirv",
-		"unity/s1-0063-70e7171c.spirv",
-		"unity/s1-0070-7595e017.spirv",
-		"unity/s1-0074-e4935128.spirv",
-		"unity/s1-0084-ffb8278d.spirv",
-		"unity/runtime-src-8332-dst-2465-1.spirv",
-		"unity/runtime-src-12620-dst-3608-1.spirv",
-		"unity/runtime-src-17316-dst-4925-1.spirv",
-		"unity/runtime-src-19884-dst-5598-1.spirv",
-		"unity/runtime-src-29736-dst-8472-1.spirv",
-		"unity/runtime-src-31280-dst-8849-1.spirv",
-		"unity/runtime-src-36140-dst-10246-1.spirv",
-		"unity/runtime-src-38388-dst-10935-1.spirv",
-		// hull shaders
-		"unity/s2-0004-76b9ef38.spirv",
-		"unity/s2-0006-655ac983.spirv",
-		"unity/s2-0019-3ddaf08d.spirv",
-		"unity/s2-0031-412ed89d.spirv",
-		// domain shaders
-		"unity/s3-0008-09cef3e4.spirv",
-		"unity/s3-0019-4c006911.spirv",
-		"unity/s3-0022-f40e2e1e.spirv",
-		"unity/s3-0028-e081a509.spirv",
-		"unity/s3-0037-18f71ada.spirv",
-		// geometry shaders
-		"unity/s4-0004-6ec33743.spirv",
-		"unity/s4-0006-a5e06270.spirv",
-		#endif // #if TEST_UNITY
-
-		#if TEST_TALOS
-		// Shaders from The Talos Principle by Croteam:
-		"talos/0078C470.shc",
-		"talos/00DC0D6D.shc",
-		"talos/0141C822.shc",
-		"talos/04CA3D7B.shc",
-		"talos/0A38A8F3.shc",
-		"talos/0C958994.shc",
-		"talos/0D8DD830.shc",
-		"talos/12A491AE.shc",
-		"talos/152916BF.shc",
-		"talos/17A983B3.shc",
-		"talos/17D83DB7.shc",
-		"talos/181EB7F4.shc",
-		"talos/18CD3426.shc",
-		"talos/1AE632D2.shc",
-		"talos/1AFB24CF.shc",
-		"talos/1D86CEC1.shc",
-		"talos/2789ADE0.shc",
-		"talos/2CFAEA42.shc",
-		"talos/2F1269A4.shc",
-		"talos/3025BBCF.shc",
-		"talos/324AA691.shc",
-		"talos/3278D7A2.shc",
-		"talos/35EB2F5D.shc",
-		"talos/36BBB957.shc",
-		"talos/38DA4FDC.shc",
-		"talos/39645236.shc",
-		"talos/397C22DE.shc",
-		"talos/3FC9340A.shc",
-		"talos/42ADB187.shc",
-		"talos/43851D2E.shc",
-		"talos/446D15D1.shc",
-		"talos/48F3A85B.shc",
-		"talos/4CF9349C.shc",
-		"talos/4D3AFE1F.shc",
-		"talos/4DF32AA3.shc",
-		"talos/54A4CD9C.shc",
-		"talos/5584AAD6.shc",
-		"talos/560C8AAE.shc",
-		"talos/58897F63.shc",
-		"talos/5997DC95.shc",
-		"talos/5C3ACFF1.shc",
-		"talos/5F10146A.shc",
-		"talos/62123EF6.shc",
-		"talos/63846EDC.shc",
-		"talos/6616D572.shc",
-		"talos/68ADD87A.shc",
-		"talos/6939EFB6.shc",
-		"talos/6DE20E90.shc",
-		"talos/71090A41.shc",
-		"talos/721FAA4E.shc",
-		"talos/72CF8B9E.shc",
-		"talos/7311A988.shc",
-		"talos/74D7C9BE.shc",
-		"talos/7A632EA9.shc",
-		"talos/7E791068.shc",
-		"talos/7FB437EC.shc",
-		"talos/862ABA13.shc",
-		"talos/8698BECC.shc",
-		"talos/8A8A2AD6.shc",
-		"talos/8B4ABC28.shc",
-		"talos/8E86B6D4.shc",
-		"talos/907A8A15.shc",
-		"talos/90AC21AB.shc",
-		"talos/91D8BCE2.shc",
-		"talos/9420BCB8.shc",
-		"talos/9B8842CA.shc",
-		"talos/9E5A3BEE.shc",
-		"talos/A1B17C65.shc",
-		"talos/A6D5DB71.shc",
-		"talos/AA43457F.shc",
-		"talos/AF45DFA4.shc",
-		"talos/B115E1B7.shc",
-		"talos/B1683E56.shc",
-		"talos/B60DED50.shc",
-		"talos/C3C6FB0C.shc",
-		"talos/C55A421D.shc",
-		"talos/C8A3D253.shc",
-		"talos/CD4F5F10.shc",
-		"talos/CDD726BF.shc",
-		"talos/CE39D960.shc",
-		"talos/D03CB186.shc",
-		"talos/D071359B.shc",
-		"talos/D0D4B04A.shc",
-		"talos/D3A302F3.shc",
-		"talos/D69AF138.shc",
-		"talos/D8175C09.shc",
-		"talos/D95FF51D.shc",
-		"talos/DEDA997A.shc",
-		"talos/E0B57835.shc",
-		"talos/E367B56D.shc",
-		"talos/E87626E9.shc",
-		"talos/EDF61398.shc",
-		"talos/F187344E.shc",
-		"talos/F18905F7.shc",
-		"talos/F4E8AB75.shc",
-		"talos/F54184AD.shc",
-		"talos/F757DA36.shc",
-		"talos/F84FE6FD.shc",
-		"talos/F9D3D588.shc",
-		"talos/FDA341FA.shc",
-		#endif // #if TEST_TALOS
-
-		#if TEST_DOTA2
-		// Shaders from DOTA2 by Valve Corporation:
-		"dota2/1021831.spv",
-		"dota2/1021921.spv",
-		"dota2/1021937.spv",
-		"dota2/1021957.spv",
-		"dota2/1021982.spv",
-		"dota2/1022104.spv",
-		"dota2/1022164.spv",
-		"dota2/1022300.spv",
-		"dota2/1022326.spv",
-		"dota2/1022372.spv",
-		"dota2/11705.spv",
-		"dota2/13490.spv",
-		"dota2/13978.spv",
-		"dota2/14074.spv",
-		"dota2/145092.spv",
-		"dota2/145323.spv",
-		"dota2/14953.spv",
-		"dota2/15212.spv",
-		"dota2/153549.spv",
-		"dota2/153702.spv",
-		"dota2/153831.spv",
-		"dota2/153884.spv",
-		"dota2/156684.spv",
-		"dota2/20451.spv",
-		"dota2/21632.spv",
-		"dota2/348634.spv",
-		"dota2/366254.spv",
-		"dota2/366294.spv",
-		"dota2/366335.spv",
-		"dota2/366455.spv",
-		"dota2/366476.spv",
-		"dota2/366477.spv",
-		"dota2/366495.spv",
-		"dota2/366515.spv",
-		"dota2/366595.spv",
-		"dota2/366734.spv",
-		"dota2/366792.spv",
-		"dota2/366871.spv",
-		"dota2/367003.spv",
-		"dota2/367029.spv",
-		"dota2/367073.spv",
-		"dota2/367079.spv",
-		"dota2/367808.spv",
-		"dota2/368065.spv",
-		"dota2/368221.spv",
-		"dota2/368894.spv",
-		"dota2/368909.spv",
-		"dota2/368930.spv",
-		"dota2/368961.spv",
-		"dota2/369162.spv",
-		"dota2/369219.spv",
-		"dota2/369220.spv",
-		"dota2/369500.spv",
-		"dota2/384867.spv",
-		"dota2/459866.spv",
-		"dota2/467711.spv",
-		"dota2/496189.spv",
-		"dota2/496971.spv",
-		"dota2/497247.spv",
-		"dota2/497531.spv",
-		"dota2/497581.spv",
-		"dota2/497587.spv",
-		"dota2/497729.spv",
-		"dota2/497875.spv",
-		"dota2/498912.spv",
-		"dota2/569461.spv",
-		"dota2/569528.spv",
-		"dota2/575430.spv",
-		"dota2/582516.spv",
-		"dota2/582644.spv",
-		"dota2/582673.spv",
-		"dota2/582715.spv",
-		"dota2/582764.spv",
-		"dota2/602523.spv",
-		"dota2/608325.spv",
-		"dota2/611688.spv",
-		"dota2/61501.spv",
-		"dota2/61536.spv",
-		"dota2/61549.spv",
-		"dota2/61906.spv",
-		"dota2/61965.spv",
-		"dota2/61988.spv",
-		"dota2/61994.spv",
-		"dota2/62032.spv",
-		"dota2/62068.spv",
-		"dota2/62081.spv",
-		"dota2/62122.spv",
-		"dota2/63939.spv",
-		"dota2/659922.spv",
-		"dota2/661085.spv",
-		"dota2/788830.spv",
-		"dota2/788923.spv",
-		"dota2/789454.spv",
-		"dota2/789505.spv",
-		"dota2/789632.spv",
-		"dota2/794725.spv",
-		"dota2/802774.spv",
-		"dota2/824933.spv",
-		"dota2/826137.spv",
-		"dota2/826321.spv",
-		"dota2/826327.spv",
-		"dota2/826339.spv",
-		"dota2/826378.spv",
-		"dota2/826431.spv",
-		"dota2/827576.spv",
-		"dota2/852315.spv",
-		"dota2/878444.spv",
-		"dota2/880389.spv",
-		"dota2/922799.spv",
-		"dota2/952476.spv",
-		#endif // #if TEST_DOTA2
-		
-		#if TEST_SHADERTOY
-		"shadertoy/st-4sfGWX.spv",
-		"shadertoy/st-MdX3Rr.spv",
-		"shadertoy/st-MdX3zr.spv",
-		"shadertoy/st-MdlGW7.spv",
-		"shadertoy/st-Mlt3Wn.spv",
-		"shadertoy/st-Ms2SD1.spv",
-		"shadertoy/st-MsXGWr.spv",
-		"shadertoy/st-Msl3Rr.spv",
-		"shadertoy/st-Mt3GWs.spv",
-		"shadertoy/st-Xds3zN.spv",
-		"shadertoy/st-XdsGDB.spv",
-		"shadertoy/st-XltGDr.spv",
-		"shadertoy/st-XsX3RB.spv",
-		"shadertoy/st-XslGRr.spv",
-		"shadertoy/st-XtlSD7.spv",
-		"shadertoy/st-XtsSWs.spv",
-		"shadertoy/st-ld3Gz2.spv",
-		"shadertoy/st-lsSXzD.spv",
-		#endif // #if TEST_SHADERTOY
-		
-		#if TEST_DXC
-		// Shaders produced by Microsoft's DXC (shader model 6 -> vulkan 1.1)
-		"dxc/imgui-vs.spv",
-		#endif // #if TEST_DXC
-		
-		#if TEST_GLSLANG
-		// Shaders produced by Glslang from Glslang tests, using Vulkan versions 1.1-1.2
-		"glslang/spv.1.3.coopmat.comp.spv",
-		"glslang/spv.1.4.LoopControl.frag.spv",
-		"glslang/spv.1.4.NonWritable.frag.spv",
-		"glslang/spv.1.4.OpCopyLogical.comp.spv",
-		"glslang/spv.1.4.OpCopyLogicalBool.comp.spv",
-		"glslang/spv.1.4.sparseTexture.frag.spv",
-		"glslang/spv.320.meshShaderUserDefined.mesh.spv",
-		"glslang/spv.AnyHitShader.rahit.spv",
-		"glslang/spv.meshShaderPerViewUserDefined.mesh.spv",
-		"glslang/spv.meshShaderRedeclPerViewBuiltins.mesh.spv",
-		"glslang/spv.meshShaderTaskMem.mesh.spv",
-		"glslang/spv.meshShaderTaskMem.mesh.spv",
-		"glslang/spv.perprimitiveNV.frag.spv",
-		"glslang/spv.subgroup.frag.spv",
-		"glslang/spv.subgroupClustered.comp.spv",
-		"glslang/spv.subgroupExtendedTypesShuffleRelative.comp.spv",
-		"glslang/spv.subgroupQuad.comp.spv",
-		"glslang/spv.subgroupVote.comp.spv",
-		"glslang/spv.vulkan110.int16.frag.spv",
-		#endif // #if TEST_GLSLANG
-
-		#if TEST_SYNTHETIC
-		// synthetic SPIR-V files; they are not actually valid -- to check how
-		// well can we handle invalid inputs
-		"synthetic/invalid-op18-too-small-len.spv",
-		"synthetic/invalid-size-not-div4.spv",
-		"synthetic/invalid-optypearray-too-small-len.spv",
-		#endif // #if TEST_SYNTHETIC
-	};
-
 	if (!TestDecodingExistingSmolvFiles())
 	{
 		return 1;
@@ -684,25 +1368,28 @@ int main()
 	ByteArray spirvAll;
 	ByteArray spirvRemapAll[2];
 	ByteArray smolvAll[2];
+	// individual programs, for batch decoding test
+	std::vector<ByteArray> spirvList;
+	std::vector<ByteArray> smolvList;
 
 	uint64_t timeDecodeSmolv = 0;
 
 	// go over all test files
 	int errorCount = 0;
-	for (size_t i = 0; i < sizeof(kFiles)/sizeof(kFiles[0]); ++i)
+	for (size_t i = 0; i < sizeof(kSpirvFiles)/sizeof(kSpirvFiles[0]); ++i)
 	{
 		// Read
-		//printf("Reading %s\n", kFiles[i]);
+		//printf("Reading %s\n", kSpirvFiles[i]);
 		ByteArray spirv;
-		ReadFile((std::string("tests/spirv-dumps/") + kFiles[i]).c_str(), spirv);
+		ReadFile((std::string("tests/spirv-dumps/") + kSpirvFiles[i]).c_str(), spirv);
 		if (spirv.empty())
 		{
-			printf("ERROR: failed to read %s\n", kFiles[i]);
+			printf("ERROR: failed to read %s\n", kSpirvFiles[i]);
 			++errorCount;
 			break;
 		}
 		
-		bool isInvalidInput = strstr(kFiles[i], "invalid-") != NULL;
+		bool isInvalidInput = strstr(kSpirvFiles[i], "invalid-") != NULL;
 
 		// Basic SPIR-V input stats
 		if (!smolv::StatsCalculate(stats, spirv.data(), spirv.size()))
@@ -711,7 +1398,7 @@ int main()
 				continue;
 			else
 			{
-				printf("WARN: failed to calc instruction stats (invalid SPIR-V?) %s\n", kFiles[i]);
+				printf("WARN: failed to calc instruction stats (invalid SPIR-V?) %s\n", kSpirvFiles[i]);
 				//++errorCount;
 				//break;
 			}
@@ -725,16 +1412,28 @@ int main()
 				continue;
 			else
 			{
-				printf("ERROR: failed to encode (invalid invalid SPIR-V?) %s\n", kFiles[i]);
+				printf("ERROR: failed to encode (invalid invalid SPIR-V?) %s\n", kSpirvFiles[i]);
 				++errorCount;
 				break;
 			}
 		}
 		
+		// Encode into a caller-provided buffer; should produce exactly the same result
+		{
+			ByteArray smolvRaw(smolv::GetEncodeBoundSize(spirv.size()));
+			size_t smolvRawSize = 0;
+			if (!smolv::Encode(spirv.data(), spirv.size(), smolvRaw.data(), smolvRaw.size(), &smolvRawSize) || smolvRawSize != smolv.size() || memcmp(smolvRaw.data(), smolv.data(), smolvRawSize) != 0)
+			{
+				printf("ERROR: encoding into a buffer does not match encoding into an array (bug?) %s\n", kSpirvFiles[i]);
+				++errorCount;
+				break;
+			}
+		}
+
 		// Dump SMOL-V output to file
 		/*
 		{
-			std::string outname = kFiles[i];
+			std::string outname = kSpirvFiles[i];
 			for (auto& c : outname)
 				if (c == '/')
 					c = '_';
@@ -755,7 +1454,7 @@ int main()
 		uint64_t timeDecStart = stm_now();
 		if (!smolv::Decode(smolv.data(), smolv.size(), spirvDecoded.data(), spirvDecodedSize))
 		{
-			printf("ERROR: failed to decode back (bug?) %s\n", kFiles[i]);
+			printf("ERROR: failed to decode back (bug?) %s\n", kSpirvFiles[i]);
 			++errorCount;
 			break;
 		}
@@ -764,7 +1463,7 @@ int main()
 		// Check that it decoded 100% the same
 		if (spirv != spirvDecoded)
 		{
-			printf("ERROR: did not encode+decode properly (bug?) %s\n", kFiles[i]);
+			printf("ERROR: did not encode+decode properly (bug?) %s\n", kSpirvFiles[i]);
 			const uint8_t* spirvPtr = spirv.data();
 			const uint8_t* spirvPtrEnd = spirvPtr + spirv.size();
 			const uint8_t* spirvDecodedPtr = spirvDecoded.data();
@@ -789,7 +1488,7 @@ int main()
 		ByteArray smolvStripped;
 		if (!smolv::Encode(spirv.data(), spirv.size(), smolvStripped, smolv::kEncodeFlagStripDebugInfo))
 		{
-			printf("ERROR: failed to encode with stripping (invalid invalid SPIR-V?) %s\n", kFiles[i]);
+			printf("ERROR: failed to encode with stripping (invalid invalid SPIR-V?) %s\n", kSpirvFiles[i]);
 			++errorCount;
 			break;
 		}
@@ -797,7 +1496,7 @@ int main()
 		// SMOL encoding stats
 		if (!smolv::StatsCalculateSmol(stats, smolvStripped.data(), smolvStripped.size()))
 		{
-			printf("ERROR: failed to calc SMOLV instruction stats (bug?) %s\n", kFiles[i]);
+			printf("ERROR: failed to calc SMOLV instruction stats (bug?) %s\n", kSpirvFiles[i]);
 			++errorCount;
 			break;
 		}
@@ -808,8 +1507,56 @@ int main()
 		smolvAll[1].insert(smolvAll[1].end(), smolvStripped.begin(), smolvStripped.end());
 		RemapSPIRV(spirv.data(), spirv.size(), false, spirvRemapAll[0]);
 		RemapSPIRV(spirv.data(), spirv.size(), true, spirvRemapAll[1]);
+		spirvList.push_back(spirv);
+		smolvList.push_back(smolv);
 	}
 	
+	uint64_t timeDecodeSmolvBatch = 0;
+	if (errorCount == 0 && !TestDecodeBatch(spirvList, smolvList, timeDecodeSmolvBatch))
+		++errorCount;
+	if (errorCount == 0 && !TestDecodeStream(spirvList, smolvList))
+		++errorCount;
+	if (errorCount == 0 && !TestDecodeFromInput(spirvList, smolvList))
+		++errorCount;
+	uint64_t timeDecodeSmolvSections = 0;
+	if (errorCount == 0 && !TestDecodeSections(spirvList, timeDecodeSmolvSections))
+		++errorCount;
+	if (errorCount == 0 && !TestReflect(spirvList))
+		++errorCount;
+	if (errorCount == 0 && !TestContentHash(spirvList))
+		++errorCount;
+	if (errorCount == 0 && !TestValidate(spirvList, smolvList))
+		++errorCount;
+	if (errorCount == 0 && !TestStatsBatch(spirvList, smolvList))
+		++errorCount;
+	size_t sizeSmolvCanonical = 0;
+	if (errorCount == 0 && !TestCanonicalizeIds(spirvList, sizeSmolvCanonical))
+		++errorCount;
+	if (errorCount == 0 && !TestArchive(spirvList, smolvList))
+		++errorCount;
+	if (errorCount == 0 && !TestSparseOps())
+		++errorCount;
+	if (errorCount == 0 && !TestConstants())
+		++errorCount;
+	if (errorCount == 0 && !TestStripNonSemanticDebugInfo())
+		++errorCount;
+	size_t sizeSmolvEntropy = 0;
+	uint64_t timeDecodeSmolvEntropy = 0;
+	if (errorCount == 0 && !TestEntropyCoding(spirvList, sizeSmolvEntropy, timeDecodeSmolvEntropy))
+		++errorCount;
+	ByteArray smolvSplitAll[2];
+	uint64_t timeDecodeSmolvSplit = 0;
+	if (errorCount == 0 && !TestSplitStreams(spirvList, smolvSplitAll, timeDecodeSmolvSplit))
+		++errorCount;
+	size_t sizeSmolvNoRestarts = 0, sizeSmolvRestarts = 0;
+	uint64_t timeDecodeSmolvRestarts = 0, timeDecodeSmolvParallel = 0;
+	if (errorCount == 0 && !TestRestartPoints(spirvList, sizeSmolvNoRestarts, sizeSmolvRestarts, timeDecodeSmolvRestarts, timeDecodeSmolvParallel))
+		++errorCount;
+	size_t sizeSmolvNoDict = 0, sizeSmolvDict = 0, sizeDict = 0;
+	uint64_t timeTrainDict = 0;
+	if (errorCount == 0 && !TestDictionary(spirvList, sizeSmolvNoDict, sizeSmolvDict, sizeDict, timeTrainDict))
+		++errorCount;
+
 	if (errorCount != 0)
 	{
 		printf("Got ERRORS: %i\n", errorCount);
@@ -824,10 +1571,16 @@ int main()
 	// Print decoding times
 	printf("\nDecompression performance:\n");
 	printf("Time taken to decode SMOL-V:      %.1fms\n", stm_ms(timeDecodeSmolv));
+	printf("Same, with DecodeBatch:           %.1fms\n", stm_ms(timeDecodeSmolvBatch));
+	printf("Entropy coded, no debug info:     %.1fms\n", stm_ms(timeDecodeSmolvEntropy));
+	printf("Split streams:                    %.1fms\n", stm_ms(timeDecodeSmolvSplit));
+	printf("Restart points every 4KB:         %.1fms\n", stm_ms(timeDecodeSmolvRestarts));
+	printf("Same, with DecodeParallel:        %.1fms\n", stm_ms(timeDecodeSmolvParallel));
+	printf("Up to functions (reflection):     %.1fms\n", stm_ms(timeDecodeSmolvSections));
 
 	// Compress various ways (as a whole blob) and print sizes
 	const char* kCompressorNames[] = { "<none>", "zlib", "LZ4 HC", "Zstandard", "Zstandard 20" };
-	const char* kDataNames[] = { "Raw", "Remapper", "SmolV" };
+	const char* kDataNames[] = { "Raw", "Remapper", "SmolV", "SmolVSplit" };
 	for (int striptype = 0; striptype < 2; ++striptype)
 	{
 		printf("\nEvaluating %s...\n", striptype == 0 ? "Raw SPIR-V" : "SPIR-V with debug info stripped out");
@@ -835,7 +1588,7 @@ int main()
 		for (int ctype = 0; ctype < 5; ++ctype)
 		{
 			printf("Compressed with %s:\n", kCompressorNames[ctype]);
-			for (int dtype = 0; dtype < 3; ++dtype)
+			for (int dtype = 0; dtype < 4; ++dtype)
 			{
 				const ByteArray* inputData = &spirvAll;
 				switch (dtype)
@@ -843,6 +1596,7 @@ int main()
 				case 0: inputData = &spirvAll; break;
 				case 1: inputData = &spirvRemapAll[striptype]; break;
 				case 2: inputData = &smolvAll[striptype]; break;
+				case 3: inputData = &smolvSplitAll[striptype]; break;
 				default: assert(false);
 				}
 
@@ -862,6 +1616,10 @@ int main()
 		}
 	}
 	
+	printf("\nSmolV with debug info stripped out, encoded separately (programs not used for dictionary training): %.1fKB, with a dictionary: %.1fKB (+%.1fKB dictionary, trained in %.1fms)\n", sizeSmolvNoDict / 1024.0f, sizeSmolvDict / 1024.0f, sizeDict / 1024.0f, stm_ms(timeTrainDict));
+	printf("SmolV with debug info stripped out, entropy coded separately: %.1fKB\n", sizeSmolvEntropy / 1024.0f);
+	printf("SmolV with debug info stripped out, canonical IDs, encoded separately: %.1fKB\n", sizeSmolvCanonical / 1024.0f);
+	printf("SmolV encoded separately: %.1fKB, with restart points every 4KB: %.1fKB\n", sizeSmolvNoRestarts / 1024.0f, sizeSmolvRestarts / 1024.0f);
 
 	return 0;
 }